@@ -1,34 +0,0 @@
-/*
- * Copyright (c) [2011-2012] Novell, Inc.
- * Copyright (c) 2016 SUSE LLC
- *
- * All Rights Reserved.
- *
- * This program is free software; you can redistribute it and/or modify it
- * under the terms of version 2 of the GNU General Public License as published
- * by the Free Software Foundation.
- *
- * This program is distributed in the hope that it will be useful, but WITHOUT
- * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
- * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
- * more details.
- *
- * You should have received a copy of the GNU General Public License along
- * with this program; if not, contact Novell, Inc.
- *
- * To contact Novell about this file by physical or electronic mail, you may
- * find current contact information at www.novell.com.
- */
-
-
-#include "proxy.h"
-
-
-void
-do_cleanup_number(ProxySnapper* snapper, bool verbose);
-
-void
-do_cleanup_timeline(ProxySnapper* snapper, bool verbose);
-
-void
-do_cleanup_empty_pre_post(ProxySnapper* snapper, bool verbose);
@@ -294,6 +294,40 @@ command_delete_snapshots(DBus::Connection& conn, const string& config_name,
 }
 
 
+vector<unsigned int>
+command_cleanup(DBus::Connection& conn, const string& config_name, const string& algorithm,
+		bool verbose)
+{
+    DBus::MessageMethodCall call(SERVICE, OBJECT, INTERFACE, "Cleanup");
+
+    DBus::Hoho hoho(call);
+    hoho << config_name << algorithm;
+
+    DBus::Message reply = conn.send_with_reply_and_block(call);
+
+    vector<unsigned int> nums;
+
+    DBus::Hihi hihi(reply);
+    hihi >> nums;
+
+    if (verbose && !nums.empty())
+    {
+	cout << sformat(_("Deleted snapshot from %s:", "Deleted snapshots from %s:", nums.size()),
+			config_name.c_str()) << endl;
+
+	for (vector<unsigned int>::const_iterator it = nums.begin(); it != nums.end(); ++it)
+	{
+	    if (it != nums.begin())
+		cout << ", ";
+	    cout << *it;
+	}
+	cout << endl;
+    }
+
+    return nums;
+}
+
+
 std::pair<bool, unsigned int>
 command_get_default_snapshot(DBus::Connection& conn, const string& config_name)
 {
@@ -90,6 +90,10 @@ void
 command_delete_snapshots(DBus::Connection& conn, const string& config_name,
 			 const vector<unsigned int>& nums, bool verbose);
 
+vector<unsigned int>
+command_cleanup(DBus::Connection& conn, const string& config_name, const string& algorithm,
+		bool verbose);
+
 std::pair<bool, unsigned int>
 command_get_default_snapshot(DBus::Connection& conn, const string& config_name);
 
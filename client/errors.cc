@@ -68,6 +68,9 @@ error_description(const DBus::ErrorException& e)
     if (name == "error.invalid_userdata")
 	return _("Invalid userdata.");
 
+    if (name == "error.invalid_cleanup_algorithm")
+	return _("Invalid cleanup algorithm.");
+
     if (name == "error.invalid_configdata")
 	return _("Invalid configdata.");
 
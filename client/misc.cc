@@ -25,11 +25,13 @@
 #include <iostream>
 #include <sstream>
 #include <boost/algorithm/string.hpp>
+#include <boost/thread.hpp>
 
 #include <snapper/AppUtil.h>
 #include <snapper/SystemCmd.h>
 
 #include "utils/text.h"
+#include "utils/Diff.h"
 
 #include "misc.h"
 
@@ -164,15 +166,18 @@ username(uid_t uid)
 
 
 Differ::Differ()
-    : command(DIFFBIN " --new-file --unified"), extensions()
+    : command(), extensions()
 {
 }
 
 
 void
-Differ::run(const string& f1, const string& f2) const
+Differ::run(const string& f1, const string& f2, string& out, string& err) const
 {
-    string tmp = command;
+    if (command.empty() && extensions.empty() && unified_diff(f1, f2, out))
+	return;
+
+    string tmp = command.empty() ? DIFFBIN " --new-file --unified" : command;
     if (!extensions.empty())
 	tmp += " " + extensions;
     tmp += " " + quote(f1) + " " + quote(f2);
@@ -180,8 +185,92 @@ Differ::run(const string& f1, const string& f2) const
     SystemCmd cmd(tmp);
 
     for (const string& line : cmd.stdout())
-	cout << line << endl;
+	out += line + "\n";
 
     for (const string& line : cmd.stderr())
-	cerr << line << endl;
+	err += line + "\n";
+}
+
+
+void
+Differ::run(const vector<pair<string, string>>& files) const
+{
+    struct Result
+    {
+	bool done = false;
+	string out;
+	string err;
+    };
+
+    vector<Result> results(files.size());
+
+    const size_t num_threads = max(boost::thread::hardware_concurrency(), 1U);
+
+    // Limit the number of results waiting to be printed.
+    const size_t window = 4 * num_threads;
+
+    boost::mutex mutex;
+    boost::condition_variable condition;
+
+    size_t next_file = 0;
+    size_t next_print = 0;
+
+    auto worker = [this, &files, &results, window, &mutex, &condition, &next_file, &next_print]() {
+	boost::unique_lock<boost::mutex> lock(mutex);
+
+	while (true)
+	{
+	    while (next_file < files.size() && next_file >= next_print + window)
+		condition.wait(lock);
+
+	    if (next_file == files.size())
+		return;
+
+	    size_t i = next_file++;
+
+	    lock.unlock();
+
+	    string out;
+	    string err;
+
+	    run(files[i].first, files[i].second, out, err);
+
+	    lock.lock();
+
+	    results[i].out.swap(out);
+	    results[i].err.swap(err);
+	    results[i].done = true;
+
+	    condition.notify_all();
+	}
+    };
+
+    boost::thread_group threads;
+    for (size_t i = 0; i < min(num_threads, files.size()); ++i)
+	threads.create_thread(worker);
+
+    for (Result& result : results)
+    {
+	string out;
+	string err;
+
+	{
+	    boost::unique_lock<boost::mutex> lock(mutex);
+
+	    while (!result.done)
+		condition.wait(lock);
+
+	    out.swap(result.out);
+	    err.swap(result.err);
+
+	    ++next_print;
+
+	    condition.notify_all();
+	}
+
+	cout << out << flush;
+	cerr << err;
+    }
+
+    threads.join_all();
 }
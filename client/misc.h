@@ -45,12 +45,26 @@ string
 username(uid_t uid);
 
 
+/**
+ * Compares files for snapper diff. Unless a command or extensions are set
+ * the builtin diff is used with the diff command only as fallback, e.g. for
+ * directories.
+ */
 struct Differ
 {
     Differ();
 
-    void run(const string& f1, const string& f2) const;
+    /**
+     * Compares several pairs of files in parallel. The output is printed in
+     * the order of the pairs as soon as available.
+     */
+    void run(const vector<pair<string, string>>& files) const;
 
     string command;
     string extensions;
+
+private:
+
+    void run(const string& f1, const string& f2, string& out, string& err) const;
+
 };
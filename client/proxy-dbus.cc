@@ -275,6 +275,21 @@ ProxySnapperDbus::deleteSnapshots(vector<ProxySnapshots::iterator> snapshots, bo
 }
 
 
+void
+ProxySnapperDbus::cleanup(const string& algorithm, bool verbose)
+{
+    vector<unsigned int> nums = command_cleanup(conn(), config_name, algorithm, verbose);
+
+    ProxySnapshots& proxy_snapshots = getSnapshots();
+    for (unsigned int num : nums)
+    {
+	ProxySnapshots::iterator proxy_snapshot = proxy_snapshots.find(num);
+	if (proxy_snapshot != proxy_snapshots.end())
+	    proxy_snapshots.erase(proxy_snapshot);
+    }
+}
+
+
 ProxyComparison
 ProxySnapperDbus::createComparison(const ProxySnapshot& lhs, const ProxySnapshot& rhs, bool mount)
 {
@@ -134,6 +134,8 @@ public:
 
     virtual void deleteSnapshots(vector<ProxySnapshots::iterator> snapshots, bool verbose) override;
 
+    virtual void cleanup(const string& algorithm, bool verbose) override;
+
     virtual ProxyComparison createComparison(const ProxySnapshot& lhs, const ProxySnapshot& rhs,
 					     bool mount) override;
 
@@ -128,8 +128,11 @@ ProxySnapperLib::modifySnapshot(ProxySnapshots::iterator snapshot, const SMD& sm
 void
 ProxySnapperLib::deleteSnapshots(vector<ProxySnapshots::iterator> snapshots, bool verbose)
 {
+    vector<Snapshots::iterator> tmp;
     for (ProxySnapshots::iterator& snapshot : snapshots)
-	snapper->deleteSnapshot(to_lib(*snapshot).it);
+	tmp.push_back(to_lib(*snapshot).it);
+
+    snapper->deleteSnapshots(tmp);
 
     ProxySnapshots& proxy_snapshots = getSnapshots();
     for (ProxySnapshots::iterator& proxy_snapshot : snapshots)
@@ -137,6 +140,32 @@ ProxySnapperLib::deleteSnapshots(vector<ProxySnapshots::iterator> snapshots, boo
 }
 
 
+void
+ProxySnapperLib::cleanup(const string& algorithm, bool verbose)
+{
+    // The library snapshots are already gone when the callback is run so
+    // the proxy snapshots must not be asked for their number anymore.
+
+    ProxySnapshots& proxy_snapshots = getSnapshots();
+
+    map<unsigned int, ProxySnapshots::iterator> tmp;
+    for (ProxySnapshots::iterator it = proxy_snapshots.begin(); it != proxy_snapshots.end(); ++it)
+	tmp.emplace(it->getNum(), it);
+
+    snapper->cleanup(algorithm, nullptr, [&proxy_snapshots, &tmp](const vector<unsigned int>& nums) {
+	for (unsigned int num : nums)
+	{
+	    map<unsigned int, ProxySnapshots::iterator>::iterator it = tmp.find(num);
+	    if (it != tmp.end())
+	    {
+		proxy_snapshots.erase(it->second);
+		tmp.erase(it);
+	    }
+	}
+    });
+}
+
+
 ProxyComparison
 ProxySnapperLib::createComparison(const ProxySnapshot& lhs, const ProxySnapshot& rhs, bool mount)
 {
@@ -109,8 +109,8 @@ public:
 
     uint64_t getUsedSpace() const { return impl->getUsedSpace(); }
 
-    void mountFilesystemSnapshot(bool user_request) const
-	{ impl->mountFilesystemSnapshot(user_request); }
+    string mountFilesystemSnapshot(bool user_request) const
+	{ return impl->mountFilesystemSnapshot(user_request); }
 
     void umountFilesystemSnapshot(bool user_request) const
 	{ impl->umountFilesystemSnapshot(user_request); }
@@ -228,6 +228,8 @@ public:
 
     virtual void deleteSnapshots(vector<ProxySnapshots::iterator> snapshots, bool verbose) = 0;
 
+    virtual void cleanup(const string& algorithm, bool verbose) = 0;
+
     virtual ProxyComparison createComparison(const ProxySnapshot& lhs, const ProxySnapshot& rhs,
 					     bool mount) = 0;
 
@@ -37,8 +37,9 @@
 #include <snapper/AsciiFile.h>
 #include <snapper/SnapperDefines.h>
 #include <snapper/XAttributes.h>
-#ifdef ENABLE_ROLLBACK
 #include <snapper/Filesystem.h>
+#include <snapper/UndoJournal.h>
+#ifdef ENABLE_ROLLBACK
 #include <snapper/Hooks.h>
 #endif
 
@@ -47,7 +48,6 @@
 #include "utils/GetOpts.h"
 #include "utils/HumanString.h"
 
-#include "cleanup.h"
 #include "errors.h"
 #include "proxy.h"
 #include "misc.h"
@@ -1085,9 +1085,39 @@ command_diff(ProxySnappers* snappers, ProxySnapper* snapper)
 
     MyFiles files(comparison.getFiles());
 
-    files.bulk_process(file, [differ](const File& file) {
-	differ.run(file.getAbsolutePath(LOC_PRE), file.getAbsolutePath(LOC_POST));
+    vector<pair<string, string>> tmp;
+
+    files.bulk_process(file, [&tmp](const File& file) {
+	tmp.emplace_back(file.getAbsolutePath(LOC_PRE), file.getAbsolutePath(LOC_POST));
     });
+
+    differ.run(tmp);
+}
+
+
+const Filesystem*
+getFilesystem(const ProxyConfig& config)
+{
+    const map<string, string>& raw = config.getAllValues();
+
+    map<string, string>::const_iterator pos1 = raw.find(KEY_FSTYPE);
+    map<string, string>::const_iterator pos2 = raw.find(KEY_SUBVOLUME);
+    if (pos1 == raw.end() || pos2 == raw.end())
+    {
+	cerr << _("Failed to initialize filesystem handler.") << endl;
+	exit(EXIT_FAILURE);
+    }
+
+    try
+    {
+	return Filesystem::create(pos1->second, pos2->second, target_root);
+    }
+    catch (const InvalidConfigException& e)
+    {
+	SN_CAUGHT(e);
+	cerr << _("Failed to initialize filesystem handler.") << endl;
+	exit(EXIT_FAILURE);
+    }
 }
 
 
@@ -1099,15 +1129,84 @@ help_undo()
 	 << '\n'
 	 << _("    Options for 'undochange' command:") << '\n'
 	 << _("\t--input, -i <file>\t\tRead files for which to undo changes from file.") << '\n'
+	 << _("\t--resume\t\t\tResume an interrupted undo.") << '\n'
 	 << endl;
 }
 
 
+void
+do_undo(Files& files, const vector<UndoStep>& undo_steps, UndoJournal* journal)
+{
+    bool ok = files.doUndoSteps(undo_steps, [&files, journal](const UndoStep& undo_step, bool ok,
+							  size_t done, size_t total) {
+
+	string path = files.find(undo_step.name)->getAbsolutePath(LOC_SYSTEM);
+
+	if (verbose)
+	{
+	    switch (undo_step.action)
+	    {
+		case CREATE:
+		    cout << sformat(_("creating %s"), path.c_str()) << endl;
+		    break;
+		case MODIFY:
+		    cout << sformat(_("modifying %s"), path.c_str()) << endl;
+		    break;
+		case DELETE:
+		    cout << sformat(_("deleting %s"), path.c_str()) << endl;
+		    break;
+	    }
+	}
+
+	if (!ok)
+	{
+	    switch (undo_step.action)
+	    {
+		case CREATE:
+		    cerr << sformat(_("failed to create %s"), path.c_str()) << endl;
+		    break;
+		case MODIFY:
+		    cerr << sformat(_("failed to modify %s"), path.c_str()) << endl;
+		    break;
+		case DELETE:
+		    cerr << sformat(_("failed to delete %s"), path.c_str()) << endl;
+		    break;
+	    }
+	}
+	else if (journal)
+	{
+	    journal->completed(undo_step);
+	}
+
+    });
+
+    // Failed steps are kept in the journal so that they can be retried.
+
+    if (journal)
+    {
+	if (ok)
+	    journal->remove();
+	else
+	    journal->sync();
+    }
+
+    if (verbose)
+    {
+	UndoStatistic undo_statistic = files.getUndoStatistic();
+
+	cout << sformat(_("cloned:%s copied:%s"),
+			byte_to_humanstring(undo_statistic.bytesCloned, 2).c_str(),
+			byte_to_humanstring(undo_statistic.bytesCopied, 2).c_str()) << endl;
+    }
+}
+
+
 void
 command_undo(ProxySnappers* snappers, ProxySnapper* snapper)
 {
     const struct option options[] = {
 	{ "input",		required_argument,	0,	'i' },
+	{ "resume",		no_argument,		0,	0 },
 	{ 0, 0, 0, 0 }
     };
 
@@ -1124,6 +1223,7 @@ command_undo(ProxySnappers* snappers, ProxySnapper* snapper)
 	snapshots.findNums(getopts.popArg());
 
     FILE* file = NULL;
+    bool resume = false;
 
     GetOpts::parsed_opts::const_iterator opt;
 
@@ -1137,12 +1237,58 @@ command_undo(ProxySnappers* snappers, ProxySnapper* snapper)
 	}
     }
 
+    if ((opt = opts.find("resume")) != opts.end())
+	resume = true;
+
     if (range.first->isCurrent())
     {
 	cerr << _("Invalid snapshots.") << endl;
 	exit(EXIT_FAILURE);
     }
 
+    const Filesystem* filesystem = getFilesystem(snapper->getConfig());
+
+    std::unique_ptr<UndoJournal> journal;
+
+    try
+    {
+	journal.reset(new UndoJournal(filesystem->openInfoDir(range.first->getNum()),
+				      filesystem->openSubvolumeDir(), range.second->getNum()));
+    }
+    catch (const IOErrorException& e)
+    {
+	SN_CAUGHT(e);
+    }
+
+    if (resume)
+    {
+	// The undo steps are taken from the journal without comparing the
+	// snapshots again.
+
+	FilePaths file_paths;
+	file_paths.system_path = filesystem->openSubvolumeDir().fullname();
+	file_paths.pre_path = range.first->mountFilesystemSnapshot(false);
+
+	vector<File> entries;
+	vector<UndoStep> undo_steps;
+
+	if (!journal || !journal->load(&file_paths, entries, undo_steps))
+	{
+	    cerr << _("No interrupted undo found.") << endl;
+	    exit(EXIT_FAILURE);
+	}
+
+	Files files(&file_paths, entries);
+
+	cout << sformat(_("remaining:%zu"), undo_steps.size()) << endl;
+
+	do_undo(files, undo_steps, journal.get());
+
+	range.first->umountFilesystemSnapshot(false);
+
+	return;
+    }
+
     ProxyComparison comparison = snapper->createComparison(*range.first, *range.second, true);
 
     MyFiles files(comparison.getFiles());
@@ -1164,84 +1310,36 @@ command_undo(ProxySnappers* snappers, ProxySnapper* snapper)
 
     vector<UndoStep> undo_steps = files.getUndoSteps();
 
-    for (vector<UndoStep>::const_iterator it1 = undo_steps.begin(); it1 != undo_steps.end(); ++it1)
+    for (const UndoStep& undo_step : undo_steps)
     {
-	vector<File>::iterator it2 = files.find(it1->name);
-	if (it2 == files.end())
-	{
-	    cerr << "internal error" << endl;
-	    exit(EXIT_FAILURE);
-	}
-
-	if (it1->action != it2->getAction())
+	vector<File>::const_iterator it = files.find(undo_step.name);
+	if (it == files.end() || undo_step.action != it->getAction())
 	{
 	    cerr << "internal error" << endl;
 	    exit(EXIT_FAILURE);
 	}
-
-	if (verbose)
-	{
-	    switch (it1->action)
-	    {
-		case CREATE:
-		    cout << sformat(_("creating %s"), it2->getAbsolutePath(LOC_SYSTEM).c_str()) << endl;
-		    break;
-		case MODIFY:
-		    cout << sformat(_("modifying %s"), it2->getAbsolutePath(LOC_SYSTEM).c_str()) << endl;
-		    break;
-		case DELETE:
-		    cout << sformat(_("deleting %s"), it2->getAbsolutePath(LOC_SYSTEM).c_str()) << endl;
-		    break;
-	    }
-	}
-
-	if (!it2->doUndo())
-	{
-	    switch (it1->action)
-	    {
-		case CREATE:
-		    cerr << sformat(_("failed to create %s"), it2->getAbsolutePath(LOC_SYSTEM).c_str()) << endl;
-		    break;
-		case MODIFY:
-		    cerr << sformat(_("failed to modify %s"), it2->getAbsolutePath(LOC_SYSTEM).c_str()) << endl;
-		    break;
-		case DELETE:
-		    cerr << sformat(_("failed to delete %s"), it2->getAbsolutePath(LOC_SYSTEM).c_str()) << endl;
-		    break;
-	    }
-	}
-    }
-}
-
-
-#ifdef ENABLE_ROLLBACK
-
-const Filesystem*
-getFilesystem(const ProxyConfig& config)
-{
-    const map<string, string>& raw = config.getAllValues();
-
-    map<string, string>::const_iterator pos1 = raw.find(KEY_FSTYPE);
-    map<string, string>::const_iterator pos2 = raw.find(KEY_SUBVOLUME);
-    if (pos1 == raw.end() || pos2 == raw.end())
-    {
-	cerr << _("Failed to initialize filesystem handler.") << endl;
-	exit(EXIT_FAILURE);
     }
 
     try
     {
-	return Filesystem::create(pos1->second, pos2->second, target_root);
+	if (journal)
+	    journal->create(files, undo_steps);
     }
-    catch (const InvalidConfigException& e)
+    catch (const IOErrorException& e)
     {
 	SN_CAUGHT(e);
-	cerr << _("Failed to initialize filesystem handler.") << endl;
-	exit(EXIT_FAILURE);
+	journal.reset();
     }
+
+    if (!journal)
+	cerr << _("Failed to write undo journal. The undo cannot be resumed if interrupted.") << endl;
+
+    do_undo(files, undo_steps, journal.get());
 }
 
 
+#ifdef ENABLE_ROLLBACK
+
 void
 help_rollback()
 {
@@ -1438,23 +1536,13 @@ command_cleanup(ProxySnappers* snappers, ProxySnapper* snapper)
 
     string cleanup = getopts.popArg();
 
-    if (cleanup == "number")
-    {
-	do_cleanup_number(snapper, verbose);
-    }
-    else if (cleanup == "timeline")
-    {
-	do_cleanup_timeline(snapper, verbose);
-    }
-    else if (cleanup == "empty-pre-post")
-    {
-	do_cleanup_empty_pre_post(snapper, verbose);
-    }
-    else
+    if (cleanup != "number" && cleanup != "timeline" && cleanup != "empty-pre-post")
     {
 	cerr << sformat(_("Unknown cleanup algorithm '%s'."), cleanup.c_str()) << endl;
 	exit(EXIT_FAILURE);
     }
+
+    snapper->cleanup(cleanup, verbose);
 }
 
 
@@ -30,7 +30,6 @@
 #include "utils/GetOpts.h"
 
 #include "proxy.h"
-#include "cleanup.h"
 #include "errors.h"
 #include "misc.h"
 
@@ -115,7 +114,7 @@ cleanup(ProxySnappers* snappers)
 	{
 	    cout << "running number cleanup for '" << value.first << "'." << endl;
 
-	    if (!call_with_error_check([snapper](){ do_cleanup_number(snapper, false); }))
+	    if (!call_with_error_check([snapper](){ snapper->cleanup("number", false); }))
 	    {
 		cerr << "number cleanup for '" << value.first << "' failed." << endl;
 		ok = false;
@@ -127,7 +126,7 @@ cleanup(ProxySnappers* snappers)
 	{
 	    cout << "running timeline cleanup for '" << value.first << "'." << endl;
 
-	    if (!call_with_error_check([snapper](){ do_cleanup_timeline(snapper, false); }))
+	    if (!call_with_error_check([snapper](){ snapper->cleanup("timeline", false); }))
 	    {
 		cerr << "timeline cleanup for '" << value.first << "' failed." << endl;
 		ok = false;
@@ -139,7 +138,7 @@ cleanup(ProxySnappers* snappers)
 	{
 	    cout << "running empty-pre-post cleanup for '" << value.first << "'." << endl;
 
-	    if (!call_with_error_check([snapper](){ do_cleanup_empty_pre_post(snapper, false); }))
+	    if (!call_with_error_check([snapper](){ snapper->cleanup("empty-pre-post", false); }))
 	    {
 		cerr << "empty-pre-post cleanup for " << value.first << " failed." << endl;
 		ok = false;
@@ -0,0 +1,527 @@
+/*
+ * Copyright (c) 2019 SUSE LLC
+ *
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of version 2 of the GNU General Public License as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, contact Novell, Inc.
+ *
+ * To contact Novell about this file by physical or electronic mail, you may
+ * find current contact information at www.novell.com.
+ */
+
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+
+#include "Diff.h"
+
+
+namespace snapper
+{
+    using namespace std;
+
+
+    // Number of context lines.
+    static const size_t context = 3;
+
+    // Limit for the edit distance searched in one step of the Myers
+    // algorithm. If exceeded the remaining ranges are reported as replaced
+    // to avoid quadratic runtime, similar to the heuristic of GNU diff.
+    static const long max_cost = 4096;
+
+
+    struct Line
+    {
+	Line(const char* data, size_t size) : data(data), size(size) {}
+
+	const char* data;
+	size_t size;		// including the newline if present
+
+	bool has_newline() const { return size > 0 && data[size - 1] == '\n'; }
+    };
+
+
+    struct LineHash
+    {
+	size_t operator()(const Line& line) const
+	{
+	    // FNV-1a
+	    size_t hash = 14695981039346656037ULL;
+	    for (size_t i = 0; i < line.size; ++i)
+		hash = (hash ^ (unsigned char)(line.data[i])) * 1099511628211ULL;
+	    return hash;
+	}
+    };
+
+
+    struct LineEqual
+    {
+	bool operator()(const Line& lhs, const Line& rhs) const
+	{
+	    return lhs.size == rhs.size && memcmp(lhs.data, rhs.data, lhs.size) == 0;
+	}
+    };
+
+
+    static vector<Line>
+    split_lines(const char* data, size_t size)
+    {
+	vector<Line> lines;
+
+	const char* end = data + size;
+	while (data != end)
+	{
+	    const char* p = (const char*) memchr(data, '\n', end - data);
+	    const char* next = p ? p + 1 : end;
+	    lines.emplace_back(data, next - data);
+	    data = next;
+	}
+
+	return lines;
+    }
+
+
+    class Myers
+    {
+    public:
+
+	Myers(const vector<int>& a, const vector<int>& b)
+	    : a(a), b(b), deleted(a.size(), false), inserted(b.size(), false)
+	{
+	    compare(0, a.size(), 0, b.size());
+	}
+
+	const vector<int>& a;
+	const vector<int>& b;
+
+	vector<bool> deleted;
+	vector<bool> inserted;
+
+    private:
+
+	void compare(long a0, long a1, long b0, long b1);
+	bool bisect(long a0, long a1, long b0, long b1, long& x, long& y) const;
+
+    };
+
+
+    void
+    Myers::compare(long a0, long a1, long b0, long b1)
+    {
+	while (a0 < a1 && b0 < b1 && a[a0] == b[b0])
+	    ++a0, ++b0;
+
+	while (a0 < a1 && b0 < b1 && a[a1 - 1] == b[b1 - 1])
+	    --a1, --b1;
+
+	long x, y;
+
+	if (a0 == a1 || b0 == b1 || !bisect(a0, a1, b0, b1, x, y))
+	{
+	    fill(deleted.begin() + a0, deleted.begin() + a1, true);
+	    fill(inserted.begin() + b0, inserted.begin() + b1, true);
+	    return;
+	}
+
+	compare(a0, a0 + x, b0, b0 + y);
+	compare(a0 + x, a1, b0 + y, b1);
+    }
+
+
+    // Find the middle snake of the ranges by searching from the front and
+    // from the back simultaneously. Returns the split point relative to the
+    // range starts.
+    bool
+    Myers::bisect(long a0, long a1, long b0, long b1, long& x, long& y) const
+    {
+	const long n = a1 - a0;
+	const long m = b1 - b0;
+
+	const long max_d = min((n + m + 1) / 2, max_cost);
+	const long v_offset = max_d + 1;
+	const long v_length = 2 * max_d + 2;
+
+	vector<long> v1(v_length, -1);
+	vector<long> v2(v_length, -1);
+	v1[v_offset + 1] = 0;
+	v2[v_offset + 1] = 0;
+
+	const long delta = n - m;
+
+	// If the total number of lines is odd the front path collides with
+	// the reverse path.
+	const bool front = delta % 2 != 0;
+
+	long k1start = 0, k1end = 0, k2start = 0, k2end = 0;
+
+	for (long d = 0; d < max_d; ++d)
+	{
+	    for (long k1 = -d + k1start; k1 <= d - k1end; k1 += 2)
+	    {
+		const long k1_offset = v_offset + k1;
+
+		long x1;
+		if (k1 == -d || (k1 != d && v1[k1_offset - 1] < v1[k1_offset + 1]))
+		    x1 = v1[k1_offset + 1];
+		else
+		    x1 = v1[k1_offset - 1] + 1;
+
+		long y1 = x1 - k1;
+
+		while (x1 < n && y1 < m && a[a0 + x1] == b[b0 + y1])
+		    ++x1, ++y1;
+
+		v1[k1_offset] = x1;
+
+		if (x1 > n)
+		{
+		    k1end += 2;
+		}
+		else if (y1 > m)
+		{
+		    k1start += 2;
+		}
+		else if (front)
+		{
+		    const long k2_offset = v_offset + delta - k1;
+		    if (k2_offset >= 0 && k2_offset < v_length && v2[k2_offset] != -1)
+		    {
+			if (x1 >= n - v2[k2_offset])
+			{
+			    x = x1;
+			    y = y1;
+			    return true;
+			}
+		    }
+		}
+	    }
+
+	    for (long k2 = -d + k2start; k2 <= d - k2end; k2 += 2)
+	    {
+		const long k2_offset = v_offset + k2;
+
+		long x2;
+		if (k2 == -d || (k2 != d && v2[k2_offset - 1] < v2[k2_offset + 1]))
+		    x2 = v2[k2_offset + 1];
+		else
+		    x2 = v2[k2_offset - 1] + 1;
+
+		long y2 = x2 - k2;
+
+		while (x2 < n && y2 < m && a[a1 - x2 - 1] == b[b1 - y2 - 1])
+		    ++x2, ++y2;
+
+		v2[k2_offset] = x2;
+
+		if (x2 > n)
+		{
+		    k2end += 2;
+		}
+		else if (y2 > m)
+		{
+		    k2start += 2;
+		}
+		else if (!front)
+		{
+		    const long k1_offset = v_offset + delta - k2;
+		    if (k1_offset >= 0 && k1_offset < v_length && v1[k1_offset] != -1)
+		    {
+			const long x1 = v1[k1_offset];
+			if (x1 >= n - x2)
+			{
+			    x = x1;
+			    y = v_offset + x1 - k1_offset;
+			    return true;
+			}
+		    }
+		}
+	    }
+	}
+
+	return false;
+    }
+
+
+    struct Change
+    {
+	size_t a;		// first deleted line in a
+	size_t deleted;
+	size_t b;		// first inserted line in b
+	size_t inserted;
+    };
+
+
+    static vector<Change>
+    changes(const vector<bool>& deleted, const vector<bool>& inserted)
+    {
+	vector<Change> ret;
+
+	size_t i = 0, j = 0;
+
+	while (i < deleted.size() || j < inserted.size())
+	{
+	    if ((i < deleted.size() && deleted[i]) || (j < inserted.size() && inserted[j]))
+	    {
+		Change change = { i, 0, j, 0 };
+
+		while (i < deleted.size() && deleted[i])
+		    ++i, ++change.deleted;
+
+		while (j < inserted.size() && inserted[j])
+		    ++j, ++change.inserted;
+
+		ret.push_back(change);
+	    }
+	    else
+	    {
+		++i, ++j;
+	    }
+	}
+
+	return ret;
+    }
+
+
+    // Same format as GNU diff: the count is omitted if it is one and an
+    // empty range is given by the line before it.
+    static string
+    range(size_t start, size_t count)
+    {
+	if (count == 0)
+	    return to_string(start) + ",0";
+
+	if (count == 1)
+	    return to_string(start + 1);
+
+	return to_string(start + 1) + "," + to_string(count);
+    }
+
+
+    static void
+    append_line(string& out, char prefix, const Line& line)
+    {
+	out += prefix;
+	out.append(line.data, line.size);
+
+	if (!line.has_newline())
+	    out += "\n\\ No newline at end of file\n";
+    }
+
+
+    void
+    unified_diff(const char* data1, size_t size1, const char* data2, size_t size2,
+		 const string& name1, const string& name2, string& out, const string& time1,
+		 const string& time2)
+    {
+	if (size1 == size2 && (size1 == 0 || memcmp(data1, data2, size1) == 0))
+	    return;
+
+	if (memchr(data1, '\0', size1) || memchr(data2, '\0', size2))
+	{
+	    out += "Binary files " + name1 + " and " + name2 + " differ\n";
+	    return;
+	}
+
+	const vector<Line> lines1 = split_lines(data1, size1);
+	const vector<Line> lines2 = split_lines(data2, size2);
+
+	// Myers works on integers identifying equal lines.
+
+	unordered_map<Line, int, LineHash, LineEqual> ids;
+
+	vector<int> a, b;
+	a.reserve(lines1.size());
+	b.reserve(lines2.size());
+
+	for (const Line& line : lines1)
+	    a.push_back(ids.emplace(line, ids.size()).first->second);
+	for (const Line& line : lines2)
+	    b.push_back(ids.emplace(line, ids.size()).first->second);
+
+	Myers myers(a, b);
+
+	const vector<Change> tmp = changes(myers.deleted, myers.inserted);
+
+	out += "--- " + name1 + (time1.empty() ? "" : "\t" + time1) + "\n";
+	out += "+++ " + name2 + (time2.empty() ? "" : "\t" + time2) + "\n";
+
+	// Changes with at most 2 * context unchanged lines in between are
+	// combined into one hunk.
+
+	for (vector<Change>::const_iterator first = tmp.begin(); first != tmp.end();)
+	{
+	    vector<Change>::const_iterator last = first;
+	    while (next(last) != tmp.end() &&
+		   next(last)->a - (last->a + last->deleted) <= 2 * context)
+		++last;
+
+	    const size_t a_start = first->a - min(first->a, context);
+	    const size_t b_start = first->b - (first->a - a_start);
+
+	    const size_t a_end = min(last->a + last->deleted + context, lines1.size());
+	    const size_t b_end = last->b + last->inserted + (a_end - (last->a + last->deleted));
+
+	    out += "@@ -" + range(a_start, a_end - a_start) + " +" + range(b_start, b_end - b_start) +
+		" @@\n";
+
+	    size_t i = a_start;
+
+	    for (vector<Change>::const_iterator it = first; it != next(last); ++it)
+	    {
+		for (; i < it->a; ++i)
+		    append_line(out, ' ', lines1[i]);
+
+		for (size_t j = it->a; j < it->a + it->deleted; ++j)
+		    append_line(out, '-', lines1[j]);
+
+		for (size_t j = it->b; j < it->b + it->inserted; ++j)
+		    append_line(out, '+', lines2[j]);
+
+		i = it->a + it->deleted;
+	    }
+
+	    for (; i < a_end; ++i)
+		append_line(out, ' ', lines1[i]);
+
+	    first = next(last);
+	}
+    }
+
+
+    // Read-only memory mapping of a file. A missing file is mapped as empty.
+    class MappedFile
+    {
+    public:
+
+	MappedFile(const string& path);
+	~MappedFile();
+
+	bool valid() const { return state != INVALID; }
+	bool missing() const { return state == MISSING; }
+
+	const char* data() const { return (const char*)(addr); }
+	size_t size() const { return length; }
+
+	const string& name() const { return path; }
+
+	// Modification time as printed by GNU diff, e.g. "2019-06-03
+	// 11:35:02.123456789 +0200".
+	string time() const;
+
+    private:
+
+	enum State { INVALID, MISSING, MAPPED };
+
+	const string path;
+
+	State state;
+
+	struct timespec mtime;
+
+	void* addr;
+	size_t length;
+
+    };
+
+
+    MappedFile::MappedFile(const string& path)
+	: path(path), state(INVALID), mtime({ 0, 0 }), addr(nullptr), length(0)
+    {
+	int fd = open(path.c_str(), O_RDONLY | O_NOCTTY | O_CLOEXEC);
+	if (fd < 0)
+	{
+	    if (errno == ENOENT)
+		state = MISSING;
+	    return;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+	{
+	    close(fd);
+	    return;
+	}
+
+	mtime = st.st_mtim;
+	length = st.st_size;
+
+	if (length > 0)
+	{
+	    addr = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+	    if (addr == MAP_FAILED)
+	    {
+		addr = nullptr;
+		close(fd);
+		return;
+	    }
+
+	    madvise(addr, length, MADV_SEQUENTIAL);
+	}
+
+	close(fd);
+
+	state = MAPPED;
+    }
+
+
+    MappedFile::~MappedFile()
+    {
+	if (addr)
+	    munmap(addr, length);
+    }
+
+
+    string
+    MappedFile::time() const
+    {
+	struct tm tmp;
+	localtime_r(&mtime.tv_sec, &tmp);
+
+	char buf1[64];
+	strftime(buf1, sizeof(buf1), "%Y-%m-%d %H:%M:%S", &tmp);
+
+	char buf2[16];
+	strftime(buf2, sizeof(buf2), "%z", &tmp);
+
+	char buf3[128];
+	snprintf(buf3, sizeof(buf3), "%s.%09ld %s", buf1, (long)(mtime.tv_nsec), buf2);
+
+	return buf3;
+    }
+
+
+    bool
+    unified_diff(const string& path1, const string& path2, string& out)
+    {
+	MappedFile file1(path1);
+	MappedFile file2(path2);
+
+	if (!file1.valid() || !file2.valid() || (file1.missing() && file2.missing()))
+	    return false;
+
+	unified_diff(file1.data(), file1.size(), file2.data(), file2.size(), file1.name(),
+		     file2.name(), out, file1.time(), file2.time());
+
+	return true;
+    }
+
+}
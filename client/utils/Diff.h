@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2019 SUSE LLC
+ *
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of version 2 of the GNU General Public License as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, contact Novell, Inc.
+ *
+ * To contact Novell about this file by physical or electronic mail, you may
+ * find current contact information at www.novell.com.
+ */
+
+
+#include <stddef.h>
+#include <string>
+
+
+namespace snapper
+{
+
+    /**
+     * Compare two buffers line by line and append the differences in
+     * unified format (three lines of context) to out. Nothing is appended
+     * if the buffers are equal. Buffers containing a NUL character are
+     * considered binary and only reported to differ.
+     *
+     * @param name1 name of the first buffer
+     * @param name2 name of the second buffer
+     * @param time1 optional time of the first buffer, used in the header
+     * @param time2 optional time of the second buffer, used in the header
+     */
+    void unified_diff(const char* data1, size_t size1, const char* data2, size_t size2,
+		      const std::string& name1, const std::string& name2, std::string& out,
+		      const std::string& time1 = "", const std::string& time2 = "");
+
+
+    /**
+     * Compare two files and append the differences in unified format,
+     * compatible with patch(1), to out. Like "diff --new-file --unified"
+     * but the hunks can differ from the ones of GNU diff. The files are mapped into memory. A missing file is
+     * treated as empty.
+     *
+     * @return false if the files cannot be compared, e.g. if one is a
+     * directory or both are missing, in which case nothing is appended
+     */
+    bool unified_diff(const std::string& path1, const std::string& path2, std::string& out);
+
+}
@@ -105,6 +105,15 @@ namespace DBus
 		}
 	    }
 
+	    for (const std::pair<int, std::function<void()>>& fd : fds)
+	    {
+		struct pollfd tmp;
+		tmp.fd = fd.first;
+		tmp.events = POLLIN;
+		tmp.revents = 0;
+		pollfds.push_back(tmp);
+	    }
+
 	    milliseconds timeout = periodic_timeout();
 
 	    if (idle_timeout.count() >= 0)
@@ -130,6 +139,16 @@ namespace DBus
 			read(wakeup_pipe[0], &arbitrary, 1);
 		    }
 		}
+		else if (find_fd(it1->fd) != fds.end())
+		{
+		    // Copy the callback since it may remove the fd.
+
+		    if (it1->revents & POLLIN)
+		    {
+			std::function<void()> callback = find_fd(it1->fd)->second;
+			callback();
+		    }
+		}
 		else
 		{
 		    unsigned int flags = 0;
@@ -216,6 +235,17 @@ namespace DBus
     }
 
 
+    vector<std::pair<int, std::function<void()>>>::iterator
+    MainLoop::find_fd(int fd)
+    {
+	for (vector<std::pair<int, std::function<void()>>>::iterator it = fds.begin(); it != fds.end(); ++it)
+	    if (it->first == fd)
+		return it;
+
+	return fds.end();
+    }
+
+
     vector<MainLoop::Timeout>::iterator
     MainLoop::find_timeout(DBusTimeout* dbus_timeout)
     {
@@ -314,6 +344,22 @@ namespace DBus
     }
 
 
+    void
+    DBus::MainLoop::add_fd(int fd, std::function<void()> callback)
+    {
+	fds.emplace_back(fd, callback);
+    }
+
+
+    void
+    DBus::MainLoop::remove_fd(int fd)
+    {
+	vector<std::pair<int, std::function<void()>>>::iterator it = find_fd(fd);
+	if (it != fds.end())
+	    fds.erase(it);
+    }
+
+
     void
     DBus::MainLoop::dispatch_incoming(Message& msg)
     {
@@ -26,6 +26,7 @@
 
 #include <dbus/dbus.h>
 #include <chrono>
+#include <functional>
 
 #include "DBusConnection.h"
 
@@ -51,6 +52,13 @@ namespace DBus
 	void add_client_match(const string& name);
 	void remove_client_match(const string& name);
 
+	/*
+	 * Adds a file descriptor that is polled for reading. When it is
+	 * readable the callback is called from the main loop.
+	 */
+	void add_fd(int fd, std::function<void()> callback);
+	void remove_fd(int fd);
+
 	virtual void method_call(Message& message) = 0;
 	virtual void signal(Message& message) = 0;
 	virtual void client_disconnected(const string& name) = 0;
@@ -80,10 +88,12 @@ namespace DBus
 
 	vector<Watch> watches;
 	vector<Timeout> timeouts;
+	vector<std::pair<int, std::function<void()>>> fds;
 	int wakeup_pipe[2];
 
 	vector<Watch>::iterator find_watch(DBusWatch* dbus_watch);
 	vector<Watch>::iterator find_enabled_watch(int fd, short events);
+	vector<std::pair<int, std::function<void()>>>::iterator find_fd(int fd);
 	vector<Timeout>::iterator find_timeout(DBusTimeout* dbus_timeout);
 
 	static dbus_bool_t add_watch(DBusWatch* dbus_watch, void* data);
@@ -16,7 +16,7 @@ delete_all()
 {
     Snapper snapper("testsuite", "/");
 
-    Snapshots snapshots = snapper.getSnapshots();
+    Snapshots& snapshots = snapper.getSnapshots();
 
     vector<Snapshots::iterator> tmp;
     for (Snapshots::iterator it = snapshots.begin(); it != snapshots.end(); ++it)
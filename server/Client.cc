@@ -308,6 +308,12 @@ Client::introspect(DBus::Connection& conn, DBus::Message& msg)
 	"      <arg name='numbers' type='au' direction='in'/>\n"
 	"    </method>\n"
 
+	"    <method name='Cleanup'>\n"
+	"      <arg name='config-name' type='s' direction='in'/>\n"
+	"      <arg name='cleanup' type='s' direction='in'/>\n"
+	"      <arg name='numbers' type='au' direction='out'/>\n"
+	"    </method>\n"
+
 	"    <method name='GetDefaultSnapshot'>\n"
 	"      <arg name='config-name' type='s' direction='in'/>\n"
 	"      <arg name='valid' type='b' direction='out'/>\n"
@@ -478,8 +484,8 @@ Client::check_config_in_use(const MetaSnapper& meta_snapper) const
 }
 
 
-void
-Client::check_snapshot_in_use(const MetaSnapper& meta_snapper, unsigned int number) const
+bool
+Client::is_snapshot_in_use(const MetaSnapper& meta_snapper, unsigned int number) const
 {
     for (Clients::const_iterator it1 = clients.begin(); it1 != clients.end(); ++it1)
     {
@@ -487,8 +493,18 @@ Client::check_snapshot_in_use(const MetaSnapper& meta_snapper, unsigned int numb
 	    it1->mounts.find(make_pair(meta_snapper.configName(), number));
 
 	if (it2 != it1->mounts.end())
-	    throw SnapshotInUse();
+	    return true;
     }
+
+    return false;
+}
+
+
+void
+Client::check_snapshot_in_use(const MetaSnapper& meta_snapper, unsigned int number) const
+{
+    if (is_snapshot_in_use(meta_snapper, number))
+	throw SnapshotInUse();
 }
 
 
@@ -1081,15 +1097,17 @@ Client::delete_snapshots(DBus::Connection& conn, DBus::Message& msg)
     Snapper* snapper = it1->getSnapper();
     Snapshots& snapshots = snapper->getSnapshots();
 
+    vector<Snapshots::iterator> tmp;
+
     for (list<unsigned int>::const_iterator it2 = nums.begin(); it2 != nums.end(); ++it2)
     {
 	check_snapshot_in_use(*it1, *it2);
 
-	Snapshots::iterator snap = snapshots.find(*it2);
-
-	snapper->deleteSnapshot(snap);
+	tmp.push_back(snapshots.find(*it2));
     }
 
+    snapper->deleteSnapshots(tmp);
+
     DBus::MessageMethodReturn reply(msg);
 
     conn.send(reply);
@@ -1098,6 +1116,62 @@ Client::delete_snapshots(DBus::Connection& conn, DBus::Message& msg)
 }
 
 
+void
+Client::cleanup(DBus::Connection& conn, DBus::Message& msg)
+{
+    string config_name;
+    string algorithm;
+
+    DBus::Hihi hihi(msg);
+    hihi >> config_name >> algorithm;
+
+    y2deb("Cleanup config_name:" << config_name << " algorithm:" << algorithm);
+
+    boost::unique_lock<boost::shared_mutex> lock(big_mutex);
+
+    MetaSnappers::iterator it = meta_snappers.find(config_name);
+
+    check_permission(conn, msg, *it);
+    check_lock(conn, msg, config_name);
+    check_config_in_use(*it);
+
+    Snapper* snapper = it->getSnapper();
+
+    list<dbus_uint32_t> deleted;
+
+    // The lock is only held while the snapshots are accessed, e.g. while
+    // deleting a batch, and not during the quota rescans in between. In
+    // the meantime the config is in use so no other snapshots are deleted
+    // and the config is not unloaded.
+
+    RefHolder ref_holder(*it);
+
+    lock.unlock();
+
+    // Every batch deleted by the cleanup algorithm is announced right away
+    // so that clients can follow the progress of a long running cleanup.
+
+    snapper->cleanup(algorithm, [this, it](unsigned int num) {
+	return !is_snapshot_in_use(*it, num);
+    }, [this, &conn, &config_name, &deleted](const vector<unsigned int>& nums) {
+	list<dbus_uint32_t> tmp(nums.begin(), nums.end());
+	signal_snapshots_deleted(conn, config_name, tmp);
+	deleted.insert(deleted.end(), nums.begin(), nums.end());
+    }, [&lock](const std::function<void()>& func) {
+	lock.lock();
+	func();
+	lock.unlock();
+    });
+
+    DBus::MessageMethodReturn reply(msg);
+
+    DBus::Hoho hoho(reply);
+    hoho << deleted;
+
+    conn.send(reply);
+}
+
+
 void
 Client::get_default_snapshot(DBus::Connection& conn, DBus::Message& msg)
 {
@@ -1350,7 +1424,7 @@ Client::create_comparison(DBus::Connection& conn, DBus::Message& msg)
     DBus::Hihi hihi(msg);
     hihi >> config_name >> num1 >> num2;
 
-    y2deb("CreateComparison config_name:" << config_name << " num1:" << num1 << " num2:" << num2);
+    y2deb_kv("CreateComparison", { "config_name", config_name }, { "num1", num1 }, { "num2", num2 });
 
     boost::unique_lock<boost::shared_mutex> lock(big_mutex);
 
@@ -1394,7 +1468,7 @@ Client::delete_comparison(DBus::Connection& conn, DBus::Message& msg)
     DBus::Hihi hihi(msg);
     hihi >> config_name >> num1 >> num2;
 
-    y2deb("DeleteComparison config_name:" << config_name << " num1:" << num1 << " num2:" << num2);
+    y2deb_kv("DeleteComparison", { "config_name", config_name }, { "num1", num1 }, { "num2", num2 });
 
     boost::unique_lock<boost::shared_mutex> lock(big_mutex);
 
@@ -1422,7 +1496,7 @@ Client::get_files(DBus::Connection& conn, DBus::Message& msg)
     DBus::Hihi hihi(msg);
     hihi >> config_name >> num1 >> num2;
 
-    y2deb("GetFiles config_name:" << config_name << " num1:" << num1 << " num2:" << num2);
+    y2deb_kv("GetFiles", { "config_name", config_name }, { "num1", num1 }, { "num2", num2 });
 
     boost::unique_lock<boost::shared_mutex> lock(big_mutex);
 
@@ -1628,7 +1702,30 @@ Client::debug(DBus::Connection& conn, DBus::Message& msg) const
 		s << ", unused for " << duration_cast<milliseconds>(it->unused_for()).count() << "ms";
 	    else
 		s << ", use count " << it->use_count();
+	    s << ", estimated size " << it->memory_usage() << " bytes";
 	}
+	if (meta_snappers.getPolicy().is_pinned(it->configName()))
+	    s << ", pinned";
+	const MetaSnapper::Statistics& statistics = it->getStatistics();
+	s << ", loads " << statistics.loads << ", unloads " << statistics.unloads;
+	if (statistics.loads > 0)
+	    s << ", last load " << statistics.last_load_time.count() << "ms, total load "
+	      << statistics.total_load_time.count() << "ms";
+	hoho << s.str();
+    }
+
+    hoho << "residency:";
+    {
+	const ResidencyPolicy& policy = meta_snappers.getPolicy();
+
+	std::ostringstream s;
+	s << "    memory usage " << meta_snappers.memory_usage() << " bytes, budget ";
+	if (policy.memory_budget != 0)
+	    s << policy.memory_budget << " bytes";
+	else
+	    s << "unlimited";
+	if (policy.unload_timeout != seconds(0))
+	    s << ", unload timeout " << policy.unload_timeout.count() << "s";
 	hoho << s.str();
     }
 
@@ -1681,6 +1778,8 @@ Client::dispatch(DBus::Connection& conn, DBus::Message& msg)
 	    create_post_snapshot(conn, msg);
 	else if (msg.is_method_call(INTERFACE, "DeleteSnapshots"))
 	    delete_snapshots(conn, msg);
+	else if (msg.is_method_call(INTERFACE, "Cleanup"))
+	    cleanup(conn, msg);
 	else if (msg.is_method_call(INTERFACE, "GetDefaultSnapshot"))
 	    get_default_snapshot(conn, msg);
 	else if (msg.is_method_call(INTERFACE, "GetActiveSnapshot"))
@@ -1813,6 +1912,12 @@ Client::dispatch(DBus::Connection& conn, DBus::Message& msg)
 	DBus::MessageError reply(msg, "error.invalid_userdata", DBUS_ERROR_FAILED);
 	conn.send(reply);
     }
+    catch (const InvalidCleanupAlgorithmException& e)
+    {
+	SN_CAUGHT(e);
+	DBus::MessageError reply(msg, "error.invalid_cleanup_algorithm", DBUS_ERROR_FAILED);
+	conn.send(reply);
+    }
     catch (const AclException& e)
     {
 	SN_CAUGHT(e);
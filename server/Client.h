@@ -72,17 +72,18 @@ public:
 			  const MetaSnapper& meta_snapper) const;
     void check_lock(DBus::Connection& conn, DBus::Message& msg, const string& config_name) const;
     void check_config_in_use(const MetaSnapper& meta_snapper) const;
+    bool is_snapshot_in_use(const MetaSnapper& meta_snapper, unsigned int number) const;
     void check_snapshot_in_use(const MetaSnapper& meta_snapper, unsigned int number) const;
 
-    void signal_config_created(DBus::Connection& conn, const string& config_name);
-    void signal_config_modified(DBus::Connection& conn, const string& config_name);
-    void signal_config_deleted(DBus::Connection& conn, const string& config_name);
-    void signal_snapshot_created(DBus::Connection& conn, const string& config_name,
-				 unsigned int num);
-    void signal_snapshot_modified(DBus::Connection& conn, const string& config_name,
-				  unsigned int num);
-    void signal_snapshots_deleted(DBus::Connection& conn, const string& config_name,
-				  const list<dbus_uint32_t>& nums);
+    static void signal_config_created(DBus::Connection& conn, const string& config_name);
+    static void signal_config_modified(DBus::Connection& conn, const string& config_name);
+    static void signal_config_deleted(DBus::Connection& conn, const string& config_name);
+    static void signal_snapshot_created(DBus::Connection& conn, const string& config_name,
+					unsigned int num);
+    static void signal_snapshot_modified(DBus::Connection& conn, const string& config_name,
+					 unsigned int num);
+    static void signal_snapshots_deleted(DBus::Connection& conn, const string& config_name,
+					 const list<dbus_uint32_t>& nums);
 
     void list_configs(DBus::Connection& conn, DBus::Message& msg);
     void get_config(DBus::Connection& conn, DBus::Message& msg);
@@ -101,6 +102,7 @@ public:
     void create_pre_snapshot(DBus::Connection& conn, DBus::Message& msg);
     void create_post_snapshot(DBus::Connection& conn, DBus::Message& msg);
     void delete_snapshots(DBus::Connection& conn, DBus::Message& msg);
+    void cleanup(DBus::Connection& conn, DBus::Message& msg);
     void get_default_snapshot(DBus::Connection& conn, DBus::Message& msg);
     void get_active_snapshot(DBus::Connection& conn, DBus::Message& msg);
     void calculate_used_space(DBus::Connection& conn, DBus::Message& msg);
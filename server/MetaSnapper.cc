@@ -23,10 +23,13 @@
 
 #include <string.h>
 #include <sys/types.h>
+#include <sstream>
+#include <algorithm>
 #include <boost/algorithm/string.hpp>
 
 #include <snapper/Log.h>
 #include <snapper/AppUtil.h>
+#include <snapper/AsciiFile.h>
 #include <snapper/SnapperDefines.h>
 
 #include "MetaSnapper.h"
@@ -94,10 +97,11 @@ RefCounter::unused_for() const
 }
 
 
-MetaSnapper::MetaSnapper(ConfigInfo& config_info)
-    : config_info(config_info), snapper(NULL)
+MetaSnapper::MetaSnapper(const ConfigInfo& config_info)
+    : config_info(config_info), snapper(NULL), statistics(), estimated_size(0)
 {
     set_permissions();
+    update_change_journal();
 }
 
 
@@ -118,6 +122,44 @@ MetaSnapper::setConfigInfo(const map<string, string>& raw)
 
     if (raw.find(KEY_ALLOW_USERS) != raw.end() || raw.find(KEY_ALLOW_GROUPS) != raw.end())
 	set_permissions();
+
+    if (raw.find("TRACK_CHANGES") != raw.end())
+	update_change_journal();
+}
+
+
+void
+MetaSnapper::update_change_journal()
+{
+    bool track_changes = false;
+    config_info.getValue("TRACK_CHANGES", track_changes);
+
+    if (track_changes && !change_journal)
+    {
+	try
+	{
+	    change_journal.reset(new ChangeJournal(config_info.getSubvolume()));
+	}
+	catch (const ChangeJournalException& e)
+	{
+	    SN_CAUGHT(e);
+
+	    // Comparisons simply do not use the journal, so this is no error.
+
+	    y2mil("tracking changes of config " << configName() << " not available, " <<
+		  e.what());
+	}
+    }
+    else if (!track_changes && change_journal)
+    {
+	if (snapper)
+	    snapper->setChangeJournal(nullptr);
+
+	change_journal.reset();
+    }
+
+    if (snapper)
+	snapper->setChangeJournal(change_journal.get());
 }
 
 
@@ -162,7 +204,23 @@ Snapper*
 MetaSnapper::getSnapper()
 {
     if (!snapper)
+    {
+	steady_clock::time_point t0 = steady_clock::now();
+
 	snapper = new Snapper(config_info.getConfigName(), "/");
+	snapper->setChangeJournal(change_journal.get());
+
+	milliseconds load_time = duration_cast<milliseconds>(steady_clock::now() - t0);
+
+	statistics.loads++;
+	statistics.last_load_time = load_time;
+	statistics.total_load_time += load_time;
+
+	update_memory_usage();
+
+	y2mil("loaded config " << configName() << " in " << load_time.count() << "ms, "
+	      "estimated size " << estimated_size << " bytes");
+    }
 
     update_use_time();
 
@@ -173,8 +231,137 @@ MetaSnapper::getSnapper()
 void
 MetaSnapper::unload()
 {
+    if (snapper)
+	statistics.unloads++;
+
     delete snapper;
     snapper = nullptr;
+
+    estimated_size = 0;
+}
+
+
+void
+MetaSnapper::update_memory_usage()
+{
+    if (!snapper)
+    {
+	estimated_size = 0;
+	return;
+    }
+
+    // Rough guess including the nodes of the list, the indices and the maps.
+
+    const size_t node_overhead = 4 * sizeof(void*);
+
+    // Per config the filesystem object, whose size depends on the type,
+    // and the content of the config file.
+
+    const size_t filesystem_overhead = 1024;
+
+    size_t size = sizeof(Snapper) + sizeof(ConfigInfo) + filesystem_overhead;
+
+    for (const map<string, string>::value_type& value : config_info.getAllValues())
+	size += node_overhead + 2 * sizeof(string) + value.first.capacity() +
+	    value.second.capacity();
+
+    for (const Snapshot& snapshot : snapper->getSnapshots())
+    {
+	size += sizeof(Snapshot) + 3 * node_overhead + sizeof(Snapshots::iterator);
+	size += snapshot.getDescription().capacity() + snapshot.getCleanup().capacity();
+
+	for (const map<string, string>::value_type& value : snapshot.getUserdata())
+	    size += node_overhead + 2 * sizeof(string) + value.first.capacity() +
+		value.second.capacity();
+    }
+
+    estimated_size = size;
+}
+
+
+/*
+ * Parses sizes like "64M". The suffixes K, M and G use base 1024.
+ */
+static bool
+parse_size(const string& str, size_t& value)
+{
+    std::istringstream s(str);
+    classic(s);
+
+    unsigned long long tmp;
+    s >> tmp;
+    if (s.fail())
+	return false;
+
+    string suffix;
+    s >> suffix;
+
+    if (suffix == "K")
+	tmp <<= 10;
+    else if (suffix == "M")
+	tmp <<= 20;
+    else if (suffix == "G")
+	tmp <<= 30;
+    else if (!suffix.empty())
+	return false;
+
+    value = tmp;
+    return true;
+}
+
+
+ResidencyPolicy::ResidencyPolicy()
+    : memory_budget(64 << 20), unload_timeout(0), pinned_configs(), preload_configs()
+{
+}
+
+
+void
+ResidencyPolicy::read()
+{
+    *this = ResidencyPolicy();
+
+    try
+    {
+	const SysconfigFile sysconfig(SYSCONFIGFILE);
+
+	string tmp;
+
+	if (sysconfig.getValue("SNAPPERD_MEMORY_BUDGET", tmp) && !parse_size(tmp, memory_budget))
+	    y2war("invalid SNAPPERD_MEMORY_BUDGET '" << tmp << "'");
+
+	if (sysconfig.getValue("SNAPPERD_UNLOAD_TIMEOUT", tmp))
+	{
+	    std::istringstream s(tmp);
+	    classic(s);
+
+	    unsigned int timeout;
+	    s >> timeout;
+	    if (!s.fail())
+		unload_timeout = seconds(timeout);
+	    else
+		y2war("invalid SNAPPERD_UNLOAD_TIMEOUT '" << tmp << "'");
+	}
+
+	sysconfig.getValue("SNAPPERD_PINNED_CONFIGS", pinned_configs);
+	sysconfig.getValue("SNAPPERD_PRELOAD_CONFIGS", preload_configs);
+    }
+    catch (const FileNotFoundException& e)
+    {
+	SN_CAUGHT(e);
+    }
+
+    y2mil("memory budget:" << memory_budget << " unload timeout:" << unload_timeout.count() <<
+	  "s pinned configs:" << pinned_configs.size() << " preload configs:" <<
+	  preload_configs.size());
+}
+
+
+bool
+ResidencyPolicy::is_pinned(const string& config_name) const
+{
+    return std::find(pinned_configs.begin(), pinned_configs.end(), config_name) !=
+	pinned_configs.end();
 }
 
 
@@ -197,6 +384,8 @@ MetaSnappers::init()
     {
 	entries.emplace_back(*it);
     }
+
+    policy.read();
 }
 
 
@@ -208,6 +397,134 @@ MetaSnappers::unload()
 }
 
 
+void
+MetaSnappers::read_policy()
+{
+    policy.read();
+}
+
+
+void
+MetaSnappers::preload()
+{
+    for (const string& config_name : policy.preload_configs)
+    {
+	try
+	{
+	    find(config_name)->getSnapper();
+	}
+	catch (const Exception& e)
+	{
+	    SN_CAUGHT(e);
+
+	    y2err("preloading config " << config_name << " failed");
+	}
+    }
+}
+
+
+void
+MetaSnappers::apply_policy()
+{
+    for (MetaSnapper& meta_snapper : entries)
+    {
+	if (!meta_snapper.is_loaded())
+	    continue;
+
+	if (policy.unload_timeout != seconds(0) && meta_snapper.use_count() == 0 &&
+	    meta_snapper.unused_for() > policy.unload_timeout &&
+	    !policy.is_pinned(meta_snapper.configName()))
+	{
+	    y2mil("unloading config " << meta_snapper.configName() << ", unused");
+	    meta_snapper.unload();
+	    continue;
+	}
+
+	meta_snapper.update_memory_usage();
+    }
+
+    if (policy.memory_budget == 0)
+	return;
+
+    size_t total = memory_usage();
+
+    while (total > policy.memory_budget)
+    {
+	// Find the least recently used snapper that can be unloaded.
+
+	iterator victim = entries.end();
+
+	for (iterator it = entries.begin(); it != entries.end(); ++it)
+	{
+	    if (!it->is_loaded() || it->use_count() != 0 || policy.is_pinned(it->configName()))
+		continue;
+
+	    if (victim == entries.end() || it->unused_for() > victim->unused_for())
+		victim = it;
+	}
+
+	if (victim == entries.end())
+	    break;
+
+	y2mil("unloading config " << victim->configName() << ", memory usage " << total <<
+	      " exceeds budget " << policy.memory_budget);
+
+	total -= victim->memory_usage();
+	victim->unload();
+    }
+}
+
+
+bool
+MetaSnappers::policy_pending() const
+{
+    if (policy.memory_budget != 0 && memory_usage() > policy.memory_budget)
+	return true;
+
+    if (policy.unload_timeout != seconds(0))
+    {
+	for (const MetaSnapper& meta_snapper : entries)
+	    if (meta_snapper.is_loaded() && meta_snapper.use_count() == 0 &&
+		!policy.is_pinned(meta_snapper.configName()))
+		return true;
+    }
+
+    return false;
+}
+
+
+bool
+MetaSnappers::keep_resident() const
+{
+    for (const MetaSnapper& meta_snapper : entries)
+    {
+	if (!meta_snapper.is_loaded())
+	    continue;
+
+	const string& config_name = meta_snapper.configName();
+
+	if (policy.is_pinned(config_name) ||
+	    std::find(policy.preload_configs.begin(), policy.preload_configs.end(),
+		      config_name) != policy.preload_configs.end())
+	    return true;
+    }
+
+    return false;
+}
+
+
+size_t
+MetaSnappers::memory_usage() const
+{
+    size_t total = 0;
+
+    for (const MetaSnapper& meta_snapper : entries)
+	total += meta_snapper.memory_usage();
+
+    return total;
+}
+
+
 MetaSnappers::iterator
 MetaSnappers::find(const string& config_name)
 {
@@ -238,3 +555,25 @@ MetaSnappers::deleteConfig(iterator it)
 
     entries.erase(it);
 }
+
+
+void
+MetaSnappers::add(const ConfigInfo& config_info)
+{
+    entries.emplace_back(config_info);
+}
+
+
+void
+MetaSnappers::replace(iterator it, const ConfigInfo& config_info)
+{
+    entries.emplace(it, config_info);
+    entries.erase(it);
+}
+
+
+void
+MetaSnappers::remove(iterator it)
+{
+    entries.erase(it);
+}
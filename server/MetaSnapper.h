@@ -29,6 +29,7 @@
 #include <boost/thread.hpp>
 
 #include <snapper/Snapper.h>
+#include <snapper/ChangeJournal.h>
 
 
 using namespace std;
@@ -86,7 +87,7 @@ class MetaSnapper : public RefCounter
 {
 public:
 
-    MetaSnapper(ConfigInfo& config_info);
+    MetaSnapper(const ConfigInfo& config_info);
     ~MetaSnapper();
 
     const string& configName() const { return config_info.getConfigName(); }
@@ -99,18 +100,76 @@ public:
 
     Snapper* getSnapper();
 
+    // Returns the loaded snapper without loading it and without counting
+    // as a use for the idle unload.
+    const Snapper* getLoadedSnapper() const { return snapper; }
+
     bool is_equal(const Snapper* s) { return snapper && snapper == s; }
     bool is_loaded() const { return snapper; }
     void unload();
 
+    struct Statistics
+    {
+	Statistics() : loads(0), unloads(0), last_load_time(0), total_load_time(0) {}
+
+	unsigned int loads;
+	unsigned int unloads;
+	milliseconds last_load_time;
+	milliseconds total_load_time;
+    };
+
+    const Statistics& getStatistics() const { return statistics; }
+
+    /*
+     * Estimated memory usage of the loaded snapper. Only updated by
+     * update_memory_usage() since walking all snapshots is not free.
+     */
+    size_t memory_usage() const { return estimated_size; }
+    void update_memory_usage();
+
 private:
 
     void set_permissions();
 
+    // Starts or stops the change journal according to TRACK_CHANGES.
+    void update_change_journal();
+
     ConfigInfo config_info;
 
     Snapper* snapper;
 
+    std::unique_ptr<ChangeJournal> change_journal;
+
+    Statistics statistics;
+
+    size_t estimated_size;
+
+};
+
+
+/*
+ * Decides which snappers stay loaded. Loading a snapper is expensive
+ * (reading all snapshots, syncing ACLs and SELinux contexts) so snappers
+ * stay loaded as long as the estimated memory usage of all loaded snappers
+ * is within the budget. Otherwise the least recently used ones are
+ * unloaded. Pinned configs are never unloaded. Configs to preload are
+ * loaded at daemon start. While pinned or preloaded configs are loaded
+ * snapperd does not exit when idle.
+ *
+ * The values are read from the sysconfig file.
+ */
+struct ResidencyPolicy
+{
+    ResidencyPolicy();
+
+    void read();
+
+    bool is_pinned(const string& config_name) const;
+
+    size_t memory_budget;		// 0 for no limit
+    seconds unload_timeout;		// 0 for no timeout
+    vector<string> pinned_configs;
+    vector<string> preload_configs;
 };
 
 
@@ -126,6 +185,23 @@ public:
 
     void unload();
 
+    void read_policy();
+    const ResidencyPolicy& getPolicy() const { return policy; }
+
+    void preload();
+
+    // Unloads snappers according to the policy.
+    void apply_policy();
+
+    // Whether apply_policy() has to be called again later.
+    bool policy_pending() const;
+
+    // Whether pinned or preloaded snappers are loaded. snapperd does not
+    // exit when idle in that case since that would unload them.
+    bool keep_resident() const;
+
+    size_t memory_usage() const;
+
     typedef list<MetaSnapper>::iterator iterator;
     typedef list<MetaSnapper>::const_iterator const_iterator;
 
@@ -143,10 +219,18 @@ public:
 		      const string& template_name);
     void deleteConfig(iterator);
 
+    // Only update the list, e.g. after another program changed the configs.
+
+    void add(const ConfigInfo& config_info);
+    void replace(iterator, const ConfigInfo& config_info);
+    void remove(iterator);
+
 private:
 
     list<MetaSnapper> entries;
 
+    ResidencyPolicy policy;
+
 };
 
 
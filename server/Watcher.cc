@@ -0,0 +1,430 @@
+/*
+ * Copyright (c) 2019 SUSE LLC
+ *
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of version 2 of the GNU General Public License as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, contact Novell, Inc.
+ *
+ * To contact Novell about this file by physical or electronic mail, you may
+ * find current contact information at www.novell.com.
+ */
+
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+
+#include <snapper/Log.h>
+#include <snapper/AppUtil.h>
+#include <snapper/FileUtils.h>
+#include <snapper/SnapperTmpl.h>
+#include <snapper/SnapperDefines.h>
+
+#include "Watcher.h"
+
+
+static const uint32_t infos_mask = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+    IN_CLOSE_WRITE;
+
+static const uint32_t configs_mask = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+    IN_CLOSE_WRITE;
+
+
+static bool
+is_number(const string& name)
+{
+    return !name.empty() && name.find_first_not_of("0123456789") == string::npos;
+}
+
+
+Watcher::Watcher(DBus::Connection& conn, const Clients& clients)
+    : conn(conn), clients(clients), inotify_fd(-1), sysconfig_wd(-1), configs_wd(-1),
+      configs_changed(false)
+{
+    inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_fd < 0)
+    {
+	y2err("inotify_init1 failed errno:" << errno << " (" << stringerror(errno) << ")");
+	return;
+    }
+
+    sysconfig_wd = inotify_add_watch(inotify_fd, snapper::dirname(SYSCONFIGFILE).c_str(), configs_mask);
+    if (sysconfig_wd < 0)
+	y2err("inotify_add_watch failed path:" << snapper::dirname(SYSCONFIGFILE) << " errno:" << errno);
+
+    configs_wd = inotify_add_watch(inotify_fd, CONFIGSDIR, configs_mask);
+    if (configs_wd < 0)
+	y2err("inotify_add_watch failed path:" CONFIGSDIR " errno:" << errno);
+}
+
+
+Watcher::~Watcher()
+{
+    if (inotify_fd >= 0)
+	close(inotify_fd);
+}
+
+
+void
+Watcher::read_events()
+{
+    if (inotify_fd < 0)
+	return;
+
+    char buffer[16384] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+
+    while (true)
+    {
+	ssize_t r = read(inotify_fd, buffer, sizeof(buffer));
+	if (r <= 0)
+	    break;
+
+	for (char* p = buffer; p < buffer + r; )
+	{
+	    const struct inotify_event* event = (const struct inotify_event*) p;
+	    p += sizeof(struct inotify_event) + event->len;
+
+	    if (event->mask & IN_Q_OVERFLOW)
+	    {
+		y2war("inotify queue overflow");
+
+		configs_changed = true;
+		for (const map<int, string>::value_type& value : infos_wds)
+		    changed_catalogs.insert(value.second);
+
+		continue;
+	    }
+
+	    string name = event->len > 0 ? event->name : "";
+
+	    if (event->wd == sysconfig_wd)
+	    {
+		if (name == snapper::basename(SYSCONFIGFILE))
+		    configs_changed = true;
+
+		continue;
+	    }
+
+	    if (event->wd == configs_wd)
+	    {
+		configs_changed = true;
+		continue;
+	    }
+
+	    map<int, string>::iterator it = infos_wds.find(event->wd);
+	    if (it == infos_wds.end())
+		continue;
+
+	    if (event->mask & IN_IGNORED)
+	    {
+		infos_wds.erase(it);
+		continue;
+	    }
+
+	    // Snapper writes the catalog after every change, so a change of
+	    // the catalog may also indicate a modified snapshot.
+
+	    if (is_number(name))
+	    {
+		unsigned int num = 0;
+		name >> num;
+		changed_snapshots[it->second].insert(num);
+	    }
+	    else if (name == "catalog")
+	    {
+		changed_catalogs.insert(it->second);
+	    }
+	}
+    }
+}
+
+
+void
+Watcher::add_watch(const MetaSnapper& meta_snapper)
+{
+    const Snapper* snapper = meta_snapper.getLoadedSnapper();
+    if (!snapper)
+	return;
+
+    string path = snapper->openInfosDir().fullname();
+
+    int wd = inotify_add_watch(inotify_fd, path.c_str(), infos_mask | IN_ONLYDIR);
+    if (wd < 0)
+    {
+	y2err("inotify_add_watch failed path:" << path << " errno:" << errno);
+	return;
+    }
+
+    infos_wds[wd] = meta_snapper.configName();
+
+    // Changes done after the config was loaded and before the watch was
+    // added are found by checking the catalog.
+
+    changed_catalogs.insert(meta_snapper.configName());
+}
+
+
+void
+Watcher::update()
+{
+    if (inotify_fd < 0)
+	return;
+
+    set<string> loaded;
+
+    for (MetaSnappers::iterator it = meta_snappers.begin(); it != meta_snappers.end(); ++it)
+    {
+	if (it->is_loaded())
+	    loaded.insert(it->configName());
+    }
+
+    set<string> watched;
+
+    for (map<int, string>::iterator it = infos_wds.begin(); it != infos_wds.end(); )
+    {
+	if (loaded.find(it->second) == loaded.end())
+	{
+	    inotify_rm_watch(inotify_fd, it->first);
+	    changed_snapshots.erase(it->second);
+	    changed_catalogs.erase(it->second);
+	    it = infos_wds.erase(it);
+	}
+	else
+	{
+	    watched.insert(it->second);
+	    ++it;
+	}
+    }
+
+    for (MetaSnappers::iterator it = meta_snappers.begin(); it != meta_snappers.end(); ++it)
+    {
+	if (it->is_loaded() && watched.find(it->configName()) == watched.end())
+	{
+	    try
+	    {
+		add_watch(*it);
+	    }
+	    catch (const Exception& e)
+	    {
+		SN_CAUGHT(e);
+	    }
+	}
+    }
+}
+
+
+bool
+Watcher::has_pending() const
+{
+    return configs_changed || !changed_snapshots.empty() || !changed_catalogs.empty();
+}
+
+
+void
+Watcher::process()
+{
+    if (configs_changed)
+    {
+	configs_changed = false;
+	process_configs();
+    }
+
+    set<string> config_names = changed_catalogs;
+    for (const map<string, set<unsigned int>>::value_type& value : changed_snapshots)
+	config_names.insert(value.first);
+
+    for (const string& config_name : config_names)
+    {
+	MetaSnappers::iterator it = meta_snappers.begin();
+	while (it != meta_snappers.end() && it->configName() != config_name)
+	    ++it;
+
+	set<unsigned int> nums;
+
+	if (it != meta_snappers.end() && it->is_loaded())
+	{
+	    map<string, set<unsigned int>>::const_iterator it2 = changed_snapshots.find(config_name);
+	    if (it2 != changed_snapshots.end())
+		nums = it2->second;
+
+	    bool check_catalog = changed_catalogs.find(config_name) != changed_catalogs.end();
+
+	    if (!process_snapshots(*it, nums, check_catalog))
+		continue;
+	}
+
+	changed_catalogs.erase(config_name);
+
+	if (nums.empty())
+	    changed_snapshots.erase(config_name);
+	else
+	    changed_snapshots[config_name] = nums;
+    }
+}
+
+
+void
+Watcher::process_configs()
+{
+    list<ConfigInfo> config_infos;
+
+    try
+    {
+	config_infos = Snapper::getConfigs("/");
+    }
+    catch (const Exception& e)
+    {
+	SN_CAUGHT(e);
+	return;
+    }
+
+    meta_snappers.read_policy();
+
+    set<string> config_names;
+
+    for (const ConfigInfo& config_info : config_infos)
+    {
+	const string& config_name = config_info.getConfigName();
+
+	config_names.insert(config_name);
+
+	MetaSnappers::iterator it = meta_snappers.begin();
+	while (it != meta_snappers.end() && it->configName() != config_name)
+	    ++it;
+
+	if (it == meta_snappers.end())
+	{
+	    y2mil("config " << config_name << " created");
+
+	    meta_snappers.add(config_info);
+	    Client::signal_config_created(conn, config_name);
+	}
+	else if (it->getConfigInfo().getAllValues() != config_info.getAllValues())
+	{
+	    if (it->use_count() != 0)
+	    {
+		configs_changed = true;
+		continue;
+	    }
+
+	    y2mil("config " << config_name << " modified");
+
+	    meta_snappers.replace(it, config_info);
+	    Client::signal_config_modified(conn, config_name);
+	}
+    }
+
+    for (MetaSnappers::iterator it = meta_snappers.begin(); it != meta_snappers.end(); )
+    {
+	if (config_names.find(it->configName()) != config_names.end())
+	{
+	    ++it;
+	    continue;
+	}
+
+	if (it->use_count() != 0)
+	{
+	    configs_changed = true;
+	    ++it;
+	    continue;
+	}
+
+	string config_name = it->configName();
+
+	y2mil("config " << config_name << " deleted");
+
+	MetaSnappers::iterator tmp = it++;
+	meta_snappers.remove(tmp);
+	Client::signal_config_deleted(conn, config_name);
+    }
+
+    update();
+}
+
+
+bool
+Watcher::process_snapshots(MetaSnapper& meta_snapper, set<unsigned int>& nums, bool check_catalog)
+{
+    // Comparisons and background tasks hold iterators to snapshots.
+
+    if (meta_snapper.use_count() != 0)
+	return false;
+
+    const string& config_name = meta_snapper.configName();
+
+    Snapper* snapper = meta_snapper.getSnapper();
+
+    set<unsigned int> tmp;
+    tmp.swap(nums);
+
+    if (check_catalog)
+    {
+	try
+	{
+	    vector<unsigned int> outdated = snapper->getOutdatedSnapshots();
+	    tmp.insert(outdated.begin(), outdated.end());
+	}
+	catch (const Exception& e)
+	{
+	    SN_CAUGHT(e);
+	}
+    }
+
+    list<dbus_uint32_t> deleted;
+
+    for (unsigned int num : tmp)
+    {
+	if (is_snapshot_mounted(config_name, num))
+	{
+	    nums.insert(num);
+	    continue;
+	}
+
+	switch (snapper->reloadSnapshot(num))
+	{
+	    case SNAPSHOT_UNCHANGED:
+		break;
+
+	    case SNAPSHOT_CREATED:
+		Client::signal_snapshot_created(conn, config_name, num);
+		break;
+
+	    case SNAPSHOT_MODIFIED:
+		Client::signal_snapshot_modified(conn, config_name, num);
+		break;
+
+	    case SNAPSHOT_DELETED:
+		deleted.push_back(num);
+		break;
+	}
+    }
+
+    if (!deleted.empty())
+	Client::signal_snapshots_deleted(conn, config_name, deleted);
+
+    return true;
+}
+
+
+bool
+Watcher::is_snapshot_mounted(const string& config_name, unsigned int num) const
+{
+    for (Clients::const_iterator it = clients.begin(); it != clients.end(); ++it)
+    {
+	if (it->mounts.find(make_pair(config_name, num)) != it->mounts.end())
+	    return true;
+    }
+
+    return false;
+}
@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2019 SUSE LLC
+ *
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of version 2 of the GNU General Public License as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, contact Novell, Inc.
+ *
+ * To contact Novell about this file by physical or electronic mail, you may
+ * find current contact information at www.novell.com.
+ */
+
+
+#ifndef SNAPPER_WATCHER_H
+#define SNAPPER_WATCHER_H
+
+
+#include <string>
+#include <map>
+#include <set>
+#include <boost/noncopyable.hpp>
+
+#include <dbus/DBusConnection.h>
+
+#include "MetaSnapper.h"
+#include "Client.h"
+
+
+using namespace std;
+
+
+/*
+ * Watches the configs and the infos dirs of the loaded configs with
+ * inotify to notice changes done by other programs, e.g. snapper without
+ * DBus or the installation-helper. Changed snapshots are reloaded one by
+ * one and the usual signals are sent.
+ *
+ * Configs in use and mounted snapshots are not changed, instead the
+ * changes are kept pending. Changes that do not touch the infos dir or the catalog,
+ * e.g. deleting only the btrfs subvolume of a snapshot, are not noticed.
+ *
+ * All functions except fd() must be called with big_mutex locked.
+ */
+class Watcher : private boost::noncopyable
+{
+public:
+
+    Watcher(DBus::Connection& conn, const Clients& clients);
+    ~Watcher();
+
+    int fd() const { return inotify_fd; }
+
+    /*
+     * Reads the available events.
+     */
+    void read_events();
+
+    /*
+     * Adds or removes watches for configs loaded or unloaded since the
+     * last call.
+     */
+    void update();
+
+    bool has_pending() const;
+
+    /*
+     * Applies the pending changes.
+     */
+    void process();
+
+private:
+
+    void add_watch(const MetaSnapper& meta_snapper);
+
+    void process_configs();
+    bool process_snapshots(MetaSnapper& meta_snapper, set<unsigned int>& nums, bool check_catalog);
+
+    bool is_snapshot_mounted(const string& config_name, unsigned int num) const;
+
+    DBus::Connection& conn;
+    const Clients& clients;
+
+    int inotify_fd;
+
+    int sysconfig_wd;
+    int configs_wd;
+
+    map<int, string> infos_wds;
+
+    bool configs_changed;
+
+    map<string, set<unsigned int>> changed_snapshots;
+    set<string> changed_catalogs;
+
+};
+
+
+#endif
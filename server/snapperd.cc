@@ -32,6 +32,7 @@
 #include "MetaSnapper.h"
 #include "Client.h"
 #include "Background.h"
+#include "Watcher.h"
 #include "Types.h"
 
 
@@ -39,7 +40,6 @@ using namespace std;
 
 
 const seconds idle_time(60);
-const seconds snapper_cleanup_time(30);
 
 bool log_stdout = false;
 bool log_debug = false;
@@ -60,15 +60,20 @@ public:
 
 private:
 
+    void watcher_event();
+
     Backgrounds backgrounds;
     Clients clients;
+    Watcher watcher;
 
 };
 
 
 MyMainLoop::MyMainLoop(DBusBusType type)
-    : MainLoop(type), backgrounds(), clients(backgrounds)
+    : MainLoop(type), backgrounds(), clients(backgrounds), watcher(*this, clients)
 {
+    if (watcher.fd() >= 0)
+	add_fd(watcher.fd(), [this]() { watcher_event(); });
 }
 
 
@@ -80,8 +85,8 @@ MyMainLoop::~MyMainLoop()
 void
 MyMainLoop::method_call(DBus::Message& msg)
 {
-    y2deb("method call sender:'" << msg.get_sender() << "' path:'" << msg.get_path() <<
-	  "' interface:'" << msg.get_interface() << "' member:'" << msg.get_member() << "'");
+    y2deb_kv("method call", { "sender", msg.get_sender() }, { "path", msg.get_path() },
+	     { "interface", msg.get_interface() }, { "member", msg.get_member() });
 
     reset_idle_count();
 
@@ -110,8 +115,8 @@ MyMainLoop::method_call(DBus::Message& msg)
 void
 MyMainLoop::signal(DBus::Message& msg)
 {
-    y2deb("signal sender:'" << msg.get_sender() << "' path:'" << msg.get_path() <<
-	  "' interface:'" << msg.get_interface() << "' member:'" << msg.get_member() << "'");
+    y2deb_kv("signal", { "sender", msg.get_sender() }, { "path", msg.get_path() },
+	     { "interface", msg.get_interface() }, { "member", msg.get_member() });
 }
 
 
@@ -142,13 +147,25 @@ MyMainLoop::periodic()
     clients.remove_zombies();
 
     if (clients.empty() && backgrounds.empty())
-	set_idle_timeout(idle_time);
+	set_idle_timeout(meta_snappers.keep_resident() ? seconds(-1) : idle_time);
 
-    for (MetaSnappers::iterator it = meta_snappers.begin(); it != meta_snappers.end(); ++it)
-    {
-	if (it->is_loaded() && it->unused_for() > snapper_cleanup_time)
-	    it->unload();
-    }
+    meta_snappers.apply_policy();
+
+    watcher.update();
+
+    if (watcher.has_pending())
+	watcher.process();
+}
+
+
+void
+MyMainLoop::watcher_event()
+{
+    boost::unique_lock<boost::shared_mutex> lock(big_mutex);
+
+    watcher.read_events();
+    watcher.update();
+    watcher.process();
 }
 
 
@@ -163,9 +180,11 @@ MyMainLoop::periodic_timeout()
     if (!backgrounds.empty())
 	return seconds(1);
 
-    for (MetaSnappers::const_iterator it = meta_snappers.begin(); it != meta_snappers.end(); ++it)
-	if (it->is_loaded() && it->use_count() == 0)
-	    return seconds(1);
+    if (watcher.has_pending())
+	return seconds(1);
+
+    if (meta_snappers.policy_pending())
+	return seconds(1);
 
     return seconds(-1);
 }
@@ -259,6 +278,7 @@ main(int argc, char** argv)
     if (!log_stdout)
     {
 	initDefaultLogger();
+	startAsyncLogger();
 	setLogQuery(&log_query);
     }
     else
@@ -281,6 +301,10 @@ main(int argc, char** argv)
 
     meta_snappers.init();
 
+    y2mil("Preloading snapper configs");
+
+    meta_snappers.preload();
+
     y2mil("Listening for method calls and signals");
 
     mainloop.run();
@@ -289,5 +313,7 @@ main(int argc, char** argv)
 
     meta_snappers.unload();
 
+    stopAsyncLogger();
+
     return 0;
 }
@@ -33,11 +33,15 @@
 #include <sys/ioctl.h>
 #include <sys/types.h>
 #include <sys/sendfile.h>
+#include <sys/syscall.h>
+#include <linux/fs.h>
 #include <dirent.h>
 #include <mntent.h>
 #include <boost/algorithm/string.hpp>
 #include <boost/io/ios_state.hpp>
 #include <boost/scoped_array.hpp>
+#include <boost/thread.hpp>
+#include <atomic>
 
 #include "snapper/Log.h"
 #include "snapper/AppUtil.h"
@@ -76,22 +80,77 @@ namespace snapper
     bool
     clonefile(int src_fd, int dest_fd)
     {
-#define BTRFS_IOCTL_MAGIC 0x94
-#define BTRFS_IOC_CLONE _IOW(BTRFS_IOCTL_MAGIC, 9, int)
+	// FICLONE is supported by e.g. btrfs and xfs. Formerly known as
+	// BTRFS_IOC_CLONE.
 
-	int r1 = ioctl(dest_fd, BTRFS_IOC_CLONE, src_fd);
-	if (r1 != 0)
+#ifndef FICLONE
+#define FICLONE _IOW(0x94, 9, int)
+#endif
+
+	return ioctl(dest_fd, FICLONE, src_fd) == 0;
+    }
+
+
+    bool
+    copyfilerange(int src_fd, int dest_fd, unsigned long long& copied)
+    {
+#ifdef SYS_copy_file_range
+	while (true)
 	{
-	    // TODO: too much logging with LVM
-	    // y2err("ioctl failed errno:" << errno << " (" << stringerror(errno) << ")");
+	    // use small value for count to make function better interruptible
+	    ssize_t r1 = syscall(SYS_copy_file_range, src_fd, NULL, dest_fd, NULL, 0x1000000, 0);
+	    if (r1 == 0)
+		return true;
+
+	    if (r1 < 0)
+		return false;
+
+	    copied += r1;
 	}
+#else
+	errno = ENOSYS;
+	return false;
+#endif
+    }
+
 
-	return r1 == 0;
+    bool
+    is_unsupported(int errnum)
+    {
+	return errnum == ENOSYS || errnum == ENOTTY || errnum == EOPNOTSUPP;
+    }
+
+
+    void
+    run_workers(const std::function<void()>& worker, size_t max_threads)
+    {
+	size_t num_threads = std::min<size_t>(std::max(boost::thread::hardware_concurrency(), 1U),
+					      std::max<size_t>(max_threads, 1));
+
+	boost::thread_group threads;
+	for (size_t i = 1; i < num_threads; ++i)
+	    threads.create_thread(worker);
+
+	worker();
+
+	threads.join_all();
+    }
+
+
+    void
+    parallel_for(size_t size, size_t min_per_thread, const std::function<void(size_t i)>& func)
+    {
+	std::atomic<size_t> next(0);
+
+	run_workers([&]() {
+	    for (size_t i = next++; i < size; i = next++)
+		func(i);
+	}, size / std::max<size_t>(min_per_thread, 1) + 1);
     }
 
 
     bool
-    copyfile(int src_fd, int dest_fd)
+    copyfile(int src_fd, int dest_fd, unsigned long long& copied)
     {
 	posix_fadvise(src_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
 
@@ -110,6 +169,8 @@ namespace snapper
 		y2err("sendfile failed errno:" << errno << " (" << stringerror(errno) << ")");
 		return false;
 	    }
+
+	    copied += r1;
 	}
     }
 
@@ -35,6 +35,8 @@
 #include <vector>
 #include <stdexcept>
 #include <chrono>
+#include <functional>
+#include <cstdint>
 
 
 namespace snapper
@@ -49,8 +51,36 @@ namespace snapper
 
     list<string> glob(const string& path, int flags);
 
+    /*
+     * Functions to copy the content of a file. On failure errno is set. The
+     * number of copied bytes is added to copied.
+     */
     bool clonefile(int src_fd, int dest_fd);
-    bool copyfile(int src_fd, int dest_fd);
+    bool copyfilerange(int src_fd, int dest_fd, unsigned long long& copied);
+    bool copyfile(int src_fd, int dest_fd, unsigned long long& copied);
+
+    /*
+     * Whether the errno of clonefile() or copyfilerange() means that the
+     * filesystem or kernel does not support the operation at all. Other
+     * errors, e.g. EINVAL for a single unsuitable file, are not cached
+     * by the callers.
+     */
+    bool is_unsupported(int errnum);
+
+    /*
+     * Runs worker in up to max_threads threads, at most one per CPU, and
+     * waits for all of them. The calling thread is one of the threads.
+     * The worker must not let exceptions escape.
+     */
+    void run_workers(const std::function<void()>& worker, size_t max_threads = SIZE_MAX);
+
+    /*
+     * Calls func for every index below size using run_workers. Every
+     * thread handles at least about min_per_thread indices so small jobs
+     * do not start threads needlessly. func must not let exceptions
+     * escape.
+     */
+    void parallel_for(size_t size, size_t min_per_thread, const std::function<void(size_t i)>& func);
 
     ssize_t readlink(const string& path, string& buf);
     int symlink(const string& oldpath, const string& newpath);
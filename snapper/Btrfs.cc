@@ -490,6 +490,42 @@ namespace snapper
     }
 
 
+    std::set<unsigned int>
+    Btrfs::checkSnapshots(const vector<unsigned int>& nums) const
+    {
+#ifdef HAVE_LIBBTRFS
+
+	// Finding the snapshot subvolumes with tree searches needs
+	// CAP_SYS_ADMIN, without use the checks for single snapshots.
+
+	try
+	{
+	    SDir infos_dir = openInfosDir();
+
+	    map<unsigned int, SnapshotSubvolume> snapshot_subvolumes =
+		get_snapshot_subvolumes(infos_dir.fd(), "snapshot");
+
+	    std::set<unsigned int> ret;
+
+	    for (unsigned int num : nums)
+	    {
+		if (snapshot_subvolumes.find(num) != snapshot_subvolumes.end())
+		    ret.insert(num);
+	    }
+
+	    return ret;
+	}
+	catch (const runtime_error& e)
+	{
+	    y2mil("finding snapshot subvolumes failed, " << e.what());
+	}
+
+#endif
+
+	return Filesystem::checkSnapshots(nums);
+    }
+
+
 #ifdef HAVE_LIBBTRFS
 
 
@@ -1238,38 +1274,6 @@ namespace snapper
     };
 
 
-    struct FdCloser
-    {
-	FdCloser(int fd)
-	    : fd(fd)
-	{
-	}
-
-	~FdCloser()
-	{
-	    if (fd > -1 )
-		::close(fd);
-	}
-
-	void reset()
-	{
-	    fd = -1;
-	}
-
-	int close()
-	{
-	    int r = ::close(fd);
-	    fd = -1;
-	    return r;
-	}
-
-    private:
-
-	int fd;
-
-    };
-
-
     bool
     StreamProcessor::dumper(int fd)
     {
@@ -79,6 +79,7 @@ namespace snapper
 	virtual bool isSnapshotReadOnly(unsigned int num) const;
 
 	virtual bool checkSnapshot(unsigned int num) const;
+	virtual std::set<unsigned int> checkSnapshots(const vector<unsigned int>& nums) const;
 
 	virtual void cmpDirs(const SDir& dir1, const SDir& dir2, cmpdirs_cb_t cb) const;
 
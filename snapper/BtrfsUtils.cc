@@ -47,6 +47,7 @@
 #include "snapper/Log.h"
 #include "snapper/AppUtil.h"
 #include "snapper/BtrfsUtils.h"
+#include "snapper/SnapperTmpl.h"
 
 
 #ifndef HAVE_LIBBTRFS
@@ -292,6 +293,194 @@ namespace snapper
 	    return sk->nr_items == 0;
 	}
 
+	struct TreeSearchOpts
+	{
+	    TreeSearchOpts(__u32 type)
+		: tree_id(BTRFS_QUOTA_TREE_OBJECTID), min_objectid(0),
+		  max_objectid(BTRFS_LAST_FREE_OBJECTID), min_offset(0), max_offset(-1),
+		  min_type(type), max_type(type) {}
+
+	    __u64 tree_id;
+
+	    __u64 min_objectid;
+	    __u64 max_objectid;
+
+	    __u64 min_offset;
+	    __u64 max_offset;
+
+	    __u32 min_type;
+	    __u32 max_type;
+
+	    std::function<void(const struct btrfs_ioctl_search_args& args,
+			       const struct btrfs_ioctl_search_header& sh)> callback;
+	};
+
+
+	/*
+	 * Wrapper for ioctl(BTRFS_IOC_TREE_SEARCH). Calls callback of
+	 * tree_search_opts for every found item.  In contrast to the bare
+	 * ioctl the wrapper ensures that the min and max values in
+	 * tree_search_opts are satisfied.  Returns the number of times the
+	 * callback was called.
+	 */
+	size_t
+	tree_search(int fd, const TreeSearchOpts& tree_search_opts)
+	{
+	    struct btrfs_ioctl_search_args args;
+	    memset(&args, 0, sizeof(args));
+
+	    struct btrfs_ioctl_search_key* sk = &args.key;
+	    sk->tree_id = tree_search_opts.tree_id;
+	    sk->min_objectid = tree_search_opts.min_objectid;
+	    sk->max_objectid = tree_search_opts.max_objectid;
+	    sk->min_offset = tree_search_opts.min_offset;
+	    sk->max_offset = tree_search_opts.max_offset;
+	    sk->min_transid = 0;
+	    sk->max_transid = (u64)(-1);
+	    sk->min_type = tree_search_opts.min_type;
+	    sk->max_type = tree_search_opts.max_type;
+	    sk->nr_items = 4096;
+
+	    size_t n = 0;
+
+	    while (true)
+	    {
+		if (ioctl(fd, BTRFS_IOC_TREE_SEARCH, &args) < 0)
+		    throw runtime_error_with_errno("ioctl(BTRFS_IOC_TREE_SEARCH) failed", errno);
+
+		if (sk->nr_items == 0)
+		    break;
+
+		u64 off = 0;
+
+		for (unsigned int i = 0; i < sk->nr_items; ++i)
+		{
+		    struct btrfs_ioctl_search_header* sh = (struct btrfs_ioctl_search_header*)(args.buf + off);
+
+		    if (sh->objectid >= tree_search_opts.min_objectid &&
+			sh->objectid <= tree_search_opts.max_objectid &&
+			sh->offset >= tree_search_opts.min_offset && sh->offset <= tree_search_opts.max_offset &&
+			sh->type >= tree_search_opts.min_type && sh->type <= tree_search_opts.max_type)
+		    {
+			tree_search_opts.callback(args, *sh);
+			++n;
+		    }
+
+		    off += sizeof(*sh) + sh->len;
+
+		    sk->min_type = sh->type;
+		    sk->min_objectid = sh->objectid;
+		    sk->min_offset = sh->offset;
+		}
+
+		sk->nr_items = 4096;
+
+		if (sk->min_offset < (u64)(-1))
+		    sk->min_offset++;
+		else
+		    break;
+	    }
+
+	    return n;
+	}
+
+
+	map<unsigned int, SnapshotSubvolume>
+	get_snapshot_subvolumes(int fd, const string& name)
+	{
+	    struct stat stat;
+	    if (fstat(fd, &stat) != 0)
+		throw runtime_error_with_errno("fstat failed", errno);
+
+	    subvolid_t parent_id = get_id(fd);
+
+	    // The numbered directories in the directory are found in the
+	    // directory index of the directory.
+
+	    map<uint64_t, unsigned int> nums;
+
+	    TreeSearchOpts tree_search_opts1(BTRFS_DIR_INDEX_KEY);
+	    tree_search_opts1.tree_id = parent_id;
+	    tree_search_opts1.min_objectid = tree_search_opts1.max_objectid = stat.st_ino;
+	    tree_search_opts1.callback = [&nums](const struct btrfs_ioctl_search_args& args,
+						 const struct btrfs_ioctl_search_header& sh)
+	    {
+		const struct btrfs_dir_item* di = (const struct btrfs_dir_item*)((const char*)(&sh) + sizeof(sh));
+		if (di->type != BTRFS_FT_DIR)
+		    return;
+
+		string tmp((const char*)(di + 1), btrfs_stack_dir_name_len(di));
+		if (tmp.empty() || tmp.find_first_not_of("0123456789") != string::npos)
+		    return;
+
+		unsigned int num = 0;
+		tmp >> num;
+		nums[btrfs_disk_key_objectid(&di->location)] = num;
+	    };
+
+	    tree_search(fd, tree_search_opts1);
+
+	    // Subvolumes with the given name in one of the numbered
+	    // directories are found in the references of the subvolumes
+	    // below the parent subvolume.
+
+	    map<unsigned int, SnapshotSubvolume> ret;
+	    map<subvolid_t, unsigned int> ids;
+
+	    TreeSearchOpts tree_search_opts2(BTRFS_ROOT_REF_KEY);
+	    tree_search_opts2.tree_id = BTRFS_ROOT_TREE_OBJECTID;
+	    tree_search_opts2.min_objectid = tree_search_opts2.max_objectid = parent_id;
+	    tree_search_opts2.callback = [&nums, &ids, &name](const struct btrfs_ioctl_search_args& args,
+							      const struct btrfs_ioctl_search_header& sh)
+	    {
+		struct btrfs_root_ref ref;
+		memcpy(&ref, (const char*)(&sh) + sizeof(sh), sizeof(ref));
+
+		string tmp((const char*)(&sh) + sizeof(sh) + sizeof(ref), le16_to_cpu(ref.name_len));
+		if (tmp != name)
+		    return;
+
+		map<uint64_t, unsigned int>::const_iterator it = nums.find(le64_to_cpu(ref.dirid));
+		if (it != nums.end())
+		    ids[sh.offset] = it->second;
+	    };
+
+	    tree_search(fd, tree_search_opts2);
+
+	    if (ids.empty())
+		return ret;
+
+	    // The read-only flag and generation are in the root items of the
+	    // subvolumes.
+
+	    TreeSearchOpts tree_search_opts3(BTRFS_ROOT_ITEM_KEY);
+	    tree_search_opts3.tree_id = BTRFS_ROOT_TREE_OBJECTID;
+	    tree_search_opts3.min_objectid = ids.begin()->first;
+	    tree_search_opts3.max_objectid = ids.rbegin()->first;
+	    tree_search_opts3.callback = [&ids, &ret](const struct btrfs_ioctl_search_args& args,
+						      const struct btrfs_ioctl_search_header& sh)
+	    {
+		map<subvolid_t, unsigned int>::const_iterator it = ids.find(sh.objectid);
+		if (it == ids.end())
+		    return;
+
+		// Old root items are smaller, the used fields are included.
+
+		struct btrfs_root_item item;
+		memset(&item, 0, sizeof(item));
+		memcpy(&item, (const char*)(&sh) + sizeof(sh), std::min<size_t>(sh.len, sizeof(item)));
+
+		SnapshotSubvolume& snapshot_subvolume = ret[it->second];
+		snapshot_subvolume.id = sh.objectid;
+		snapshot_subvolume.read_only = le64_to_cpu(item.flags) & BTRFS_ROOT_SUBVOL_RDONLY;
+		snapshot_subvolume.generation = le64_to_cpu(item.generation);
+	    };
+
+	    tree_search(fd, tree_search_opts3);
+
+	    return ret;
+	}
+
 #endif
 
 
@@ -453,88 +642,6 @@ namespace snapper
 	}
 
 
-	struct TreeSearchOpts
-	{
-	    TreeSearchOpts(__u32 type) : min_offset(0), max_offset(-1), min_type(type), max_type(type) {}
-
-	    __u64 min_offset;
-	    __u64 max_offset;
-
-	    __u32 min_type;
-	    __u32 max_type;
-
-	    std::function<void(const struct btrfs_ioctl_search_args& args,
-			       const struct btrfs_ioctl_search_header& sh)> callback;
-	};
-
-
-	/*
-	 * Wrapper for ioctl(BTRFS_IOC_TREE_SEARCH). Calls callback of
-	 * tree_search_opts for every found item.  In contrast to the bare
-	 * ioctl the wrapper ensures that the min and max values in
-	 * tree_search_opts are satisfied.  Returns the number of times the
-	 * callback was called.
-	 */
-	size_t
-	qgroups_tree_search(int fd, const TreeSearchOpts& tree_search_opts)
-	{
-	    struct btrfs_ioctl_search_args args;
-	    memset(&args, 0, sizeof(args));
-
-	    struct btrfs_ioctl_search_key* sk = &args.key;
-	    sk->tree_id = BTRFS_QUOTA_TREE_OBJECTID;
-	    sk->min_objectid = 0;
-	    sk->max_objectid = BTRFS_LAST_FREE_OBJECTID;
-	    sk->min_offset = tree_search_opts.min_offset;
-	    sk->max_offset = tree_search_opts.max_offset;
-	    sk->min_transid = 0;
-	    sk->max_transid = (u64)(-1);
-	    sk->min_type = tree_search_opts.min_type;
-	    sk->max_type = tree_search_opts.max_type;
-	    sk->nr_items = 4096;
-
-	    size_t n = 0;
-
-	    while (true)
-	    {
-		if (ioctl(fd, BTRFS_IOC_TREE_SEARCH, &args) < 0)
-		    throw runtime_error_with_errno("ioctl(BTRFS_IOC_TREE_SEARCH) failed", errno);
-
-		if (sk->nr_items == 0)
-		    break;
-
-		u64 off = 0;
-
-		for (unsigned int i = 0; i < sk->nr_items; ++i)
-		{
-		    struct btrfs_ioctl_search_header* sh = (struct btrfs_ioctl_search_header*)(args.buf + off);
-
-		    if (sh->offset >= tree_search_opts.min_offset && sh->offset <= tree_search_opts.max_offset &&
-			sh->type >= tree_search_opts.min_type && sh->type <= tree_search_opts.max_type)
-		    {
-			tree_search_opts.callback(args, *sh);
-			++n;
-		    }
-
-		    off += sizeof(*sh) + sh->len;
-
-		    sk->min_type = sh->type;
-		    sk->min_objectid = sh->objectid;
-		    sk->min_offset = sh->offset;
-		}
-
-		sk->nr_items = 4096;
-
-		if (sk->min_offset < (u64)(-1))
-		    sk->min_offset++;
-		else
-		    break;
-	    }
-
-	    return n;
-	}
-
-
 	qgroup_t
 	qgroup_find_free(int fd, uint64_t level)
 	{
@@ -549,7 +656,7 @@ namespace snapper
 		qgroups.push_back(sh.offset);
 	    };
 
-	    qgroups_tree_search(fd, tree_search_opts);
+	    tree_search(fd, tree_search_opts);
 
 	    if (qgroups.empty() || get_id(qgroups.front()) != 0)
 		return calc_qgroup(level, 0);
@@ -579,7 +686,7 @@ namespace snapper
 		ret.push_back(sh.objectid);
 	    };
 
-	    qgroups_tree_search(fd, tree_search_opts);
+	    tree_search(fd, tree_search_opts);
 
 	    return ret;
 	}
@@ -604,7 +711,7 @@ namespace snapper
 		qgroup_usage.exclusive_compressed = le64_to_cpu(info.exclusive_compressed);
 	    };
 
-	    int n = qgroups_tree_search(fd, tree_search_opts);
+	    int n = tree_search(fd, tree_search_opts);
 
 	    if (n == 0)
 		throw std::runtime_error("qgroup info not found");
@@ -28,12 +28,14 @@
 #include <stdint.h>
 #include <string>
 #include <vector>
+#include <map>
 
 
 namespace snapper
 {
     using std::string;
     using std::vector;
+    using std::map;
 
 
     namespace BtrfsUtils
@@ -50,6 +52,23 @@ namespace snapper
 
 	bool does_subvolume_exist(int fd, subvolid_t id);
 
+	struct SnapshotSubvolume
+	{
+	    SnapshotSubvolume() : id(0), read_only(false), generation(0) {}
+
+	    subvolid_t id;
+	    bool read_only;
+	    uint64_t generation;
+	};
+
+	/*
+	 * Finds all subvolumes called name in the numbered subdirectories
+	 * of the directory fd, e.g. .snapshots/<num>/snapshot, using a few
+	 * tree searches instead of stat'ing every subdirectory. Returns the
+	 * subvolumes indexed by number. Requires CAP_SYS_ADMIN.
+	 */
+	map<unsigned int, SnapshotSubvolume> get_snapshot_subvolumes(int fd, const string& name);
+
 	void create_subvolume(int fddst, const string& name);
 	void create_snapshot(int fd, int fddst, const string& name, bool read_only,
 			     qgroup_t qgroup);
@@ -0,0 +1,444 @@
+/*
+ * Copyright (c) 2019 SUSE LLC
+ *
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of version 2 of the GNU General Public License as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, contact Novell, Inc.
+ *
+ * To contact Novell about this file by physical or electronic mail, you may
+ * find current contact information at www.novell.com.
+ */
+
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/fanotify.h>
+#include <sys/stat.h>
+#include <boost/algorithm/string.hpp>
+
+#include "snapper/Log.h"
+#include "snapper/AppUtil.h"
+#include "snapper/SnapperTmpl.h"
+#include "snapper/ChangeJournal.h"
+
+
+namespace snapper
+{
+    using namespace std;
+
+
+    // Events of an entry in a directory, reported with the fid of the
+    // directory and the name of the entry.
+    static const uint64_t event_mask = FAN_CREATE | FAN_DELETE | FAN_MOVED_FROM | FAN_MOVED_TO |
+	FAN_MODIFY | FAN_ATTRIB | FAN_CLOSE_WRITE | FAN_ONDIR;
+
+
+    ChangeJournal::ChangeJournal(const string& subvolume)
+	: subvolume(subvolume), dev(0), fanotify_fd(-1), mount_fd(-1), stop_fd(-1), state(INVALID),
+	  base_num(0), base_date(0)
+    {
+	mount_fd = open(subvolume.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (mount_fd < 0)
+	    SN_THROW(ChangeJournalException(sformat("open failed path:%s errno:%d (%s)",
+						    subvolume.c_str(), errno,
+						    stringerror(errno).c_str())));
+
+	struct stat buf;
+	if (fstat(mount_fd, &buf) != 0)
+	{
+	    close(mount_fd);
+	    SN_THROW(ChangeJournalException(sformat("fstat failed path:%s errno:%d (%s)",
+						    subvolume.c_str(), errno,
+						    stringerror(errno).c_str())));
+	}
+
+	dev = buf.st_dev;
+
+	fanotify_fd = fanotify_init(FAN_CLASS_NOTIF | FAN_REPORT_DFID_NAME | FAN_NONBLOCK |
+				    FAN_CLOEXEC, O_RDONLY | O_LARGEFILE);
+	if (fanotify_fd < 0)
+	{
+	    close(mount_fd);
+	    SN_THROW(ChangeJournalException(sformat("fanotify_init failed errno:%d (%s)", errno,
+						    stringerror(errno).c_str())));
+	}
+
+	if (fanotify_mark(fanotify_fd, FAN_MARK_ADD | FAN_MARK_FILESYSTEM, event_mask, mount_fd,
+			  NULL) != 0)
+	{
+	    // Marks reporting fids are refused for btrfs subvolumes other
+	    // than the top level one, the usual layout for snapper.
+
+	    if (errno == EXDEV)
+	    {
+		close(fanotify_fd);
+		close(mount_fd);
+		SN_THROW(ChangeJournalException(sformat("fanotify_mark not supported for subvolume "
+							"path:%s", subvolume.c_str())));
+	    }
+
+	    close(fanotify_fd);
+	    close(mount_fd);
+	    SN_THROW(ChangeJournalException(sformat("fanotify_mark failed path:%s errno:%d (%s)",
+						    subvolume.c_str(), errno,
+						    stringerror(errno).c_str())));
+	}
+
+	stop_fd = eventfd(0, EFD_CLOEXEC);
+	if (stop_fd < 0)
+	{
+	    close(fanotify_fd);
+	    close(mount_fd);
+	    SN_THROW(ChangeJournalException(sformat("eventfd failed errno:%d (%s)", errno,
+						    stringerror(errno).c_str())));
+	}
+
+	thread = boost::thread(boost::bind(&ChangeJournal::run, this));
+
+	y2mil("change journal: tracking " << subvolume);
+    }
+
+
+    ChangeJournal::~ChangeJournal()
+    {
+	uint64_t one = 1;
+	if (write(stop_fd, &one, sizeof(one)) != sizeof(one))
+	    y2err("change journal: write failed errno:" << errno);
+
+	thread.join();
+
+	close(stop_fd);
+	close(fanotify_fd);
+	close(mount_fd);
+
+	y2mil("change journal: stopped tracking " << subvolume);
+    }
+
+
+    void
+    ChangeJournal::run()
+    {
+	// Reads events as they arrive to keep the queue of the kernel
+	// short.
+
+	while (true)
+	{
+	    struct pollfd pfds[2] = { { fanotify_fd, POLLIN, 0 }, { stop_fd, POLLIN, 0 } };
+
+	    int r = poll(pfds, 2, -1);
+	    if (r < 0)
+	    {
+		if (errno == EINTR)
+		    continue;
+
+		y2err("change journal: poll failed errno:" << errno << " (" << stringerror(errno) << ")");
+		return;
+	    }
+
+	    if (pfds[1].revents != 0)
+		return;
+
+	    if (pfds[0].revents != 0)
+	    {
+		boost::lock_guard<boost::mutex> lock(mutex);
+		readEvents();
+	    }
+	}
+    }
+
+
+    void
+    ChangeJournal::readEvents()
+    {
+	alignas(struct fanotify_event_metadata) char buffer[64 * 1024];
+
+	while (true)
+	{
+	    ssize_t len = read(fanotify_fd, buffer, sizeof(buffer));
+	    if (len < 0)
+	    {
+		if (errno == EINTR)
+		    continue;
+
+		if (errno != EAGAIN)
+		    invalidate("read failed");
+
+		return;
+	    }
+
+	    const struct fanotify_event_metadata* metadata =
+		reinterpret_cast<const struct fanotify_event_metadata*>(buffer);
+
+	    for (; FAN_EVENT_OK(metadata, len); metadata = FAN_EVENT_NEXT(metadata, len))
+	    {
+		if (metadata->vers != FANOTIFY_METADATA_VERSION)
+		{
+		    invalidate("unknown metadata version");
+		    continue;
+		}
+
+		if (metadata->mask & FAN_Q_OVERFLOW)
+		{
+		    invalidate("event queue overflow");
+		    continue;
+		}
+
+		handleEvent(reinterpret_cast<const char*>(metadata), metadata->event_len);
+	    }
+	}
+    }
+
+
+    void
+    ChangeJournal::handleEvent(const char* event, size_t len)
+    {
+	if (state == INVALID)
+	    return;
+
+	const struct fanotify_event_metadata* metadata =
+	    reinterpret_cast<const struct fanotify_event_metadata*>(event);
+
+	// Directories renamed or deleted make the cached path invalid.
+
+	if ((metadata->mask & FAN_ONDIR) && (metadata->mask & (FAN_MOVED_FROM | FAN_DELETE)))
+	    last_handle.clear();
+
+	// New directories, also ones moved here, must be compared completely.
+
+	bool subtree = (metadata->mask & FAN_ONDIR) && (metadata->mask & (FAN_CREATE | FAN_MOVED_TO));
+
+	for (size_t pos = metadata->metadata_len; pos + sizeof(struct fanotify_event_info_header) <= len; )
+	{
+	    const struct fanotify_event_info_fid* info =
+		reinterpret_cast<const struct fanotify_event_info_fid*>(event + pos);
+
+	    if (info->hdr.len == 0 || pos + info->hdr.len > len)
+	    {
+		invalidate("malformed event");
+		return;
+	    }
+
+	    pos += info->hdr.len;
+
+	    if (info->hdr.info_type != FAN_EVENT_INFO_TYPE_DFID_NAME &&
+		info->hdr.info_type != FAN_EVENT_INFO_TYPE_DFID)
+		continue;
+
+	    string path;
+	    if (!resolve(info->handle, path))
+		continue;
+
+	    if (info->hdr.info_type == FAN_EVENT_INFO_TYPE_DFID_NAME)
+	    {
+		const struct file_handle* handle =
+		    reinterpret_cast<const struct file_handle*>(info->handle);
+		const char* name = reinterpret_cast<const char*>(handle->f_handle + handle->handle_bytes);
+
+		if (strcmp(name, ".") != 0)
+		    path = (path == "/" ? "" : path) + "/" + name;
+	    }
+
+	    // Like cmpDirs ignore .snapshots. Otherwise e.g. creating a
+	    // reflink snapshot would overflow the journal.
+
+	    if (path == "/.snapshots" || boost::starts_with(path, "/.snapshots/"))
+		continue;
+
+	    // Modifying a file through one hard link also changes the other
+	    // links but only one is reported. The link count is only checked
+	    // when a path is added the first time. Adding a link later
+	    // reports the new link as path itself.
+
+	    if (!(metadata->mask & FAN_ONDIR) && paths.find(path) == paths.end())
+	    {
+		struct stat buf;
+		if (lstat((subvolume == "/" ? path : subvolume + path).c_str(), &buf) == 0 &&
+		    !S_ISDIR(buf.st_mode) && buf.st_nlink > 1)
+		{
+		    invalidate("changed file with several hard links");
+		    return;
+		}
+	    }
+
+	    add(path, subtree);
+	}
+    }
+
+
+    bool
+    ChangeJournal::resolve(const void* handle, string& path)
+    {
+	const struct file_handle* file_handle = static_cast<const struct file_handle*>(handle);
+
+	string key(static_cast<const char*>(handle), sizeof(struct file_handle) +
+		   file_handle->handle_bytes);
+
+	if (key == last_handle)
+	{
+	    path = last_path;
+	    return !path.empty();
+	}
+
+	int fd = open_by_handle_at(mount_fd, const_cast<struct file_handle*>(file_handle),
+				   O_PATH | O_CLOEXEC);
+	if (fd < 0)
+	{
+	    // The directory is already deleted. Its deletion is recorded for
+	    // its parent directory, so the directory is compared anyway.
+
+	    if (errno == ESTALE || errno == ENOENT)
+		return false;
+
+	    invalidate("open_by_handle_at failed");
+	    return false;
+	}
+
+	struct stat buf;
+	if (fstat(fd, &buf) != 0)
+	{
+	    close(fd);
+	    invalidate("fstat failed");
+	    return false;
+	}
+
+	string tmp;
+
+	// Other subvolumes and deleted directories are of no interest.
+
+	if (buf.st_dev == dev && buf.st_nlink > 0)
+	{
+	    char link[PATH_MAX];
+	    ssize_t r = ::readlink(("/proc/self/fd/" + decString(fd)).c_str(), link, sizeof(link));
+	    if (r < 0 || r == sizeof(link))
+	    {
+		close(fd);
+		invalidate("readlink failed");
+		return false;
+	    }
+
+	    tmp.assign(link, r);
+
+	    if (subvolume != "/")
+	    {
+		if (tmp == subvolume)
+		    tmp = "/";
+		else if (boost::starts_with(tmp, subvolume + "/"))
+		    tmp.erase(0, subvolume.size());
+		else
+		    tmp.clear();
+	    }
+	}
+
+	close(fd);
+
+	last_handle = key;
+	last_path = tmp;
+
+	path = tmp;
+	return !path.empty();
+    }
+
+
+    void
+    ChangeJournal::add(const string& path, bool subtree)
+    {
+	if (path == "/")
+	    return;
+
+	pair<map<string, bool>::iterator, bool> ret = paths.insert(make_pair(path, subtree));
+	if (!ret.second)
+	    ret.first->second = ret.first->second || subtree;
+
+	if (paths.size() > max_paths)
+	    invalidate("too many paths");
+    }
+
+
+    void
+    ChangeJournal::invalidate(const char* reason)
+    {
+	if (state != INVALID)
+	    y2mil("change journal: invalidated for " << subvolume << ", " << reason);
+
+	state = INVALID;
+	paths.clear();
+	last_handle.clear();
+    }
+
+
+    void
+    ChangeJournal::beginSnapshot()
+    {
+	boost::lock_guard<boost::mutex> lock(mutex);
+
+	// Events queued so far happened before the snapshot.
+
+	readEvents();
+
+	paths.clear();
+	last_handle.clear();
+
+	state = PENDING;
+    }
+
+
+    void
+    ChangeJournal::endSnapshot(unsigned int num, time_t date)
+    {
+	boost::lock_guard<boost::mutex> lock(mutex);
+
+	if (state != PENDING)
+	    return;
+
+	state = VALID;
+	base_num = num;
+	base_date = date;
+
+	y2mil("change journal: tracking changes since snapshot " << num << " with " <<
+	      paths.size() << " paths");
+    }
+
+
+    void
+    ChangeJournal::abortSnapshot()
+    {
+	boost::lock_guard<boost::mutex> lock(mutex);
+
+	invalidate("snapshot creation failed");
+    }
+
+
+    bool
+    ChangeJournal::getPaths(unsigned int num, time_t date, map<string, bool>& paths)
+    {
+	boost::lock_guard<boost::mutex> lock(mutex);
+
+	// The events of changes done so far are already queued.
+
+	readEvents();
+
+	if (state != VALID || base_num != num || base_date != date)
+	    return false;
+
+	paths = ChangeJournal::paths;
+
+	return true;
+    }
+
+}
@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2019 SUSE LLC
+ *
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of version 2 of the GNU General Public License as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, contact Novell, Inc.
+ *
+ * To contact Novell about this file by physical or electronic mail, you may
+ * find current contact information at www.novell.com.
+ */
+
+
+#ifndef SNAPPER_CHANGE_JOURNAL_H
+#define SNAPPER_CHANGE_JOURNAL_H
+
+
+#include <time.h>
+#include <map>
+#include <string>
+#include <boost/noncopyable.hpp>
+#include <boost/thread.hpp>
+
+#include "snapper/Exception.h"
+
+
+namespace snapper
+{
+    using std::map;
+    using std::string;
+
+
+    struct ChangeJournalException : public Exception
+    {
+	explicit ChangeJournalException(const string& msg) : Exception(msg) {}
+    };
+
+
+    /*
+     * Records the paths of a subvolume changed since the most recent
+     * read-only snapshot of it using fanotify. Comparisons of that
+     * snapshot with the current system then only have to look at the
+     * recorded paths instead of the whole subvolume.
+     *
+     * The journal is invalid until the first snapshot is created while
+     * tracking and after an overflow of the event queue or the journal.
+     * It is also invalidated when a file with several hard links is
+     * modified since the other links are not reported. The journal only
+     * lives in memory, so it is lost when snapperd exits.
+     *
+     * Writes through a shared writable mapping are only seen when the
+     * file is closed.
+     */
+    class ChangeJournal : private boost::noncopyable
+    {
+    public:
+
+	/*
+	 * Starts tracking the filesystem of the subvolume. Throws
+	 * ChangeJournalException if that is not possible, e.g. for btrfs
+	 * subvolumes other than the top-level one.
+	 */
+	explicit ChangeJournal(const string& subvolume);
+	~ChangeJournal();
+
+	/*
+	 * To be called around creating a snapshot of the current system:
+	 * beginSnapshot() before the snapshot is created and either
+	 * endSnapshot() or abortSnapshot() afterwards.
+	 */
+	void beginSnapshot();
+	void endSnapshot(unsigned int num, time_t date);
+	void abortSnapshot();
+
+	/*
+	 * Gets the paths changed since creating the snapshot with num and
+	 * date. The value of an entry tells whether the whole subtree of
+	 * the path must be compared. Returns false if the journal does not
+	 * cover the snapshot.
+	 */
+	bool getPaths(unsigned int num, time_t date, map<string, bool>& paths);
+
+	// Maximal number of paths before the journal is invalidated.
+	static const size_t max_paths = 100000;
+
+    private:
+
+	enum State { INVALID, PENDING, VALID };
+
+	void run();
+
+	void readEvents();
+	void handleEvent(const char* event, size_t len);
+
+	bool resolve(const void* handle, string& path);
+
+	void add(const string& path, bool subtree);
+
+	void invalidate(const char* reason);
+
+	const string subvolume;
+
+	dev_t dev;
+
+	int fanotify_fd;
+	int mount_fd;
+	int stop_fd;
+
+	boost::mutex mutex;
+
+	State state;
+
+	unsigned int base_num;
+	time_t base_date;
+
+	map<string, bool> paths;
+
+	// handle and path of the directory resolved last
+	string last_handle;
+	string last_path;
+
+	boost::thread thread;
+
+    };
+
+}
+
+
+#endif
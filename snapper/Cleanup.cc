@@ -0,0 +1,947 @@
+/*
+ * Copyright (c) [2011-2014] Novell, Inc.
+ * Copyright (c) [2016-2019] SUSE LLC
+ *
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of version 2 of the GNU General Public License as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, contact Novell, Inc.
+ *
+ * To contact Novell about this file by physical or electronic mail, you may
+ * find current contact information at www.novell.com.
+ */
+
+
+#include "config.h"
+
+#include <time.h>
+#include <algorithm>
+#include <set>
+#include <exception>
+
+#include "snapper/Cleanup.h"
+#include "snapper/Snapper.h"
+#include "snapper/Comparison.h"
+#include "snapper/Log.h"
+#include "snapper/AppUtil.h"
+#include "snapper/SnapperTmpl.h"
+#include "snapper/Range.h"
+#include "snapper/EqualDate.h"
+
+
+namespace snapper
+{
+    using namespace std;
+
+
+    struct Parameters
+    {
+	Parameters(const ConfigInfo& config_info);
+	virtual ~Parameters() {}
+
+	virtual bool is_degenerated() const { return true; }
+
+	time_t min_age;
+	double space_limit;
+	double free_limit;
+	bool incremental_quota;
+
+	template<typename Type>
+	void read(const ConfigInfo& config_info, const char* name, Type& value)
+	{
+	    string tmp;
+	    if (config_info.getValue(name, tmp))
+		tmp >> value;
+	}
+
+	void read(const ConfigInfo& config_info, const char* name, bool& value)
+	{
+	    config_info.getValue(name, value);
+	}
+    };
+
+
+    Parameters::Parameters(const ConfigInfo& config_info)
+	: min_age(1800), space_limit(0.5), free_limit(0.2), incremental_quota(false)
+    {
+	read(config_info, "SPACE_LIMIT", space_limit);
+	read(config_info, "FREE_LIMIT", free_limit);
+	read(config_info, "INCREMENTAL_QUOTA", incremental_quota);
+    }
+
+
+    class Cleaner
+    {
+    public:
+
+	Cleaner(Snapper* snapper, const Parameters& parameters, cleanup_pred_t pred,
+		cleanup_cb_t cb, cleanup_guard_t guard)
+	    : snapper(snapper), parameters(parameters), pred(pred), cb(cb), guard(guard) {}
+
+	virtual ~Cleaner() {}
+
+	void cleanup();
+
+    protected:
+
+	virtual list<Snapshots::iterator> calculate_candidates(Snapshots& snapshots,
+							       Range::Value value) = 0;
+
+	struct younger_than
+	{
+	    younger_than(time_t t)
+		: t(t) {}
+	    bool operator()(Snapshots::const_iterator it)
+		{ return it->getDate() > t; }
+	    const time_t t;
+	};
+
+	void filter(Snapshots& snapshots, list<Snapshots::iterator>& tmp) const;
+
+	// Removes snapshots that cannot be removed (e.g. btrfs active and
+	// default and those rejected by the predicate)
+	void filter_undeletables(Snapshots& snapshots, list<Snapshots::iterator>& tmp) const;
+
+	// Removes snapshots younger than parameters.min_age from tmp
+	void filter_min_age(Snapshots& snapshots, list<Snapshots::iterator>& tmp) const;
+
+	// Removes pre and post snapshots from tmp that do have a corresponding
+	// snapshot but which is not included in tmp.
+	void filter_pre_post(Snapshots& snapshots, list<Snapshots::iterator>& tmp) const;
+
+	// Splits the candidates into batches so that the first n batches are
+	// the result of filter() applied to the first m candidates. Thus the
+	// batches can be deleted one after the other without filtering every
+	// prefix of the candidates again.
+	list<list<Snapshots::iterator>> batches(Snapshots& snapshots,
+						const list<Snapshots::iterator>& candidates) const;
+
+	// Deletes all snapshots in tmp as one batch.
+	void remove(const list<Snapshots::iterator>& tmp);
+
+	// Runs func, which accesses the snapshots, within the guard.
+	void guarded(const std::function<void()>& func) const;
+
+	// Should the cleanup with quota space be run?
+	bool is_quota_aware() const;
+
+	// Is the quota space condition satisfied?
+	bool is_quota_satisfied() const;
+	bool is_quota_satisfied(const QuotaData& quota_data) const;
+
+	// Exclusive space of the snapshots, zero for snapshots without quota
+	// data.
+	uint64_t used_space(const list<Snapshots::iterator>& tmp) const;
+
+	// Should the cleanup with free space be run?
+	bool is_free_aware() const;
+
+	// Is the free space condition satisfied?
+	bool is_free_satisfied() const;
+
+	void cleanup(Snapshots& snapshots);
+	void cleanup(Snapshots& snapshots, std::function<bool()> condition);
+
+	// Cleanup with quota condition that only rescans the quota once before
+	// and once after each batch of deletions.
+	void cleanup_incremental_quota(Snapshots& snapshots);
+
+	Snapper* snapper;
+
+	const Parameters& parameters;
+
+	const cleanup_pred_t pred;
+	const cleanup_cb_t cb;
+	const cleanup_guard_t guard;
+
+    };
+
+
+    void
+    Cleaner::filter(Snapshots& snapshots, list<Snapshots::iterator>& tmp) const
+    {
+	filter_undeletables(snapshots, tmp);
+	filter_min_age(snapshots, tmp);
+	filter_pre_post(snapshots, tmp);
+    }
+
+
+    void
+    Cleaner::filter_undeletables(Snapshots& snapshots, list<Snapshots::iterator>& tmp) const
+    {
+	vector<Snapshots::const_iterator> undeletables;
+
+	Snapshots::const_iterator default_snapshot = snapshots.getDefault();
+	if (default_snapshot != snapshots.end())
+	    undeletables.push_back(default_snapshot);
+
+	Snapshots::const_iterator active_snapshot = snapshots.getActive();
+	if (active_snapshot != snapshots.end())
+	    undeletables.push_back(active_snapshot);
+
+	for (Snapshots::const_iterator undeletable : undeletables)
+	{
+	    list<Snapshots::iterator>::iterator keep = find_if(tmp.begin(), tmp.end(),
+		[undeletable](Snapshots::iterator it){ return undeletable->getNum() == it->getNum(); });
+
+	    if (keep != tmp.end())
+		tmp.erase(keep);
+	}
+
+	if (pred)
+	    tmp.remove_if([this](Snapshots::iterator it){ return !pred(it->getNum()); });
+    }
+
+
+    void
+    Cleaner::filter_min_age(Snapshots& snapshots, list<Snapshots::iterator>& tmp) const
+    {
+	time_t now = time(NULL);
+	tmp.remove_if(younger_than(now - parameters.min_age));
+    }
+
+
+    void
+    Cleaner::filter_pre_post(Snapshots& snapshots, list<Snapshots::iterator>& tmp) const
+    {
+	set<unsigned int> nums;
+	for (Snapshots::const_iterator it : tmp)
+	    nums.insert(it->getNum());
+
+	list<Snapshots::iterator> ret;
+
+	for (list<Snapshots::iterator>::iterator it1 = tmp.begin(); it1 != tmp.end(); ++it1)
+	{
+	    if ((*it1)->getType() == PRE)
+	    {
+		Snapshots::iterator it2 = snapshots.findPost(*it1);
+		if (it2 != snapshots.end())
+		{
+		    if (nums.find(it2->getNum()) == nums.end())
+			continue;
+		}
+	    }
+
+	    if ((*it1)->getType() == POST)
+	    {
+		Snapshots::iterator it2 = snapshots.findPre(*it1);
+		if (it2 != snapshots.end())
+		{
+		    if (nums.find(it2->getNum()) == nums.end())
+			continue;
+		}
+	    }
+
+	    ret.push_back(*it1);
+	}
+
+	swap(ret, tmp);
+    }
+
+
+    list<list<Snapshots::iterator>>
+    Cleaner::batches(Snapshots& snapshots, const list<Snapshots::iterator>& candidates) const
+    {
+	list<Snapshots::iterator> tmp = candidates;
+
+	filter_undeletables(snapshots, tmp);
+	filter_min_age(snapshots, tmp);
+
+	// A pre or post snapshot only passes filter_pre_post together with
+	// its corresponding snapshot. So it is delayed until that one is seen.
+
+	set<unsigned int> seen;
+
+	list<list<Snapshots::iterator>> ret;
+
+	for (Snapshots::iterator it1 : tmp)
+	{
+	    seen.insert(it1->getNum());
+
+	    Snapshots::iterator it2 = snapshots.end();
+	    if (it1->getType() == PRE)
+		it2 = snapshots.findPost(it1);
+	    else if (it1->getType() == POST)
+		it2 = snapshots.findPre(it1);
+
+	    if (it2 == snapshots.end())
+		ret.push_back({ it1 });
+	    else if (seen.find(it2->getNum()) != seen.end())
+		ret.push_back({ it2, it1 });
+	}
+
+	return ret;
+    }
+
+
+    void
+    Cleaner::remove(const list<Snapshots::iterator>& tmp)
+    {
+	vector<Snapshots::iterator> snapshots(tmp.begin(), tmp.end());
+
+	vector<unsigned int> nums;
+	for (Snapshots::const_iterator snapshot : snapshots)
+	{
+	    y2mil("deleting snapshot " << snapshot->getNum());
+	    nums.push_back(snapshot->getNum());
+	}
+
+	guarded([this, &snapshots, &nums]() {
+	    snapper->deleteSnapshots(snapshots);
+
+	    if (cb)
+		cb(nums);
+	});
+    }
+
+
+    void
+    Cleaner::guarded(const std::function<void()>& func) const
+    {
+	if (guard)
+	    guard(func);
+	else
+	    func();
+    }
+
+
+    bool
+    Cleaner::is_quota_aware() const
+    {
+	if (parameters.is_degenerated())
+	    return false;
+
+	try
+	{
+	    snapper->prepareQuota();
+	}
+	catch (const QuotaException& e)
+	{
+	    SN_CAUGHT(e);
+
+	    y2war("quota not working (" << e.what() << ")");
+	    return false;
+	}
+
+	return parameters.space_limit < 1.0;
+    }
+
+
+    bool
+    Cleaner::is_quota_satisfied() const
+    {
+	return is_quota_satisfied(snapper->queryQuotaData());
+    }
+
+
+    bool
+    Cleaner::is_quota_satisfied(const QuotaData& quota_data) const
+    {
+	if (quota_data.size == 0)
+	    return true;
+
+	double fraction = (double)(quota_data.used) / (double)(quota_data.size);
+
+	bool satisfied = fraction < parameters.space_limit;
+
+	y2deb("size:" << quota_data.size << " used:" << quota_data.used << " fraction:" <<
+	      fraction << " satisfied:" << satisfied);
+
+	return satisfied;
+    }
+
+
+    uint64_t
+    Cleaner::used_space(const list<Snapshots::iterator>& tmp) const
+    {
+	uint64_t sum = 0;
+
+	for (Snapshots::const_iterator it : tmp)
+	{
+	    try
+	    {
+		sum += it->getUsedSpace();
+	    }
+	    catch (const QuotaException& e)
+	    {
+		SN_CAUGHT(e);
+	    }
+	    catch (const runtime_error& e)
+	    {
+		y2war("failed to query used space, " << e.what());
+	    }
+	}
+
+	return sum;
+    }
+
+
+    bool
+    Cleaner::is_free_aware() const
+    {
+	if (parameters.is_degenerated())
+	    return false;
+
+	try
+	{
+	    snapper->queryFreeSpaceData();
+	}
+	catch (const FreeSpaceException& e)
+	{
+	    SN_CAUGHT(e);
+
+	    y2war("free space not working (" << e.what() << ")");
+	    return false;
+	}
+
+	return parameters.free_limit > 0.0;
+    }
+
+
+    bool
+    Cleaner::is_free_satisfied() const
+    {
+	FreeSpaceData free_space_data = snapper->queryFreeSpaceData();
+
+	if (free_space_data.size == 0)
+	    return true;
+
+	double fraction = (double)(free_space_data.free) / (double)(free_space_data.size);
+
+	bool satisfied = fraction > parameters.free_limit;
+
+	y2deb("size:" << free_space_data.size << " free:" << free_space_data.free <<
+	      " fraction:" << fraction << " satisfied:" << satisfied);
+
+	return satisfied;
+    }
+
+
+    void
+    Cleaner::cleanup(Snapshots& snapshots)
+    {
+	list<Snapshots::iterator> candidates;
+
+	guarded([this, &snapshots, &candidates]() {
+	    candidates = calculate_candidates(snapshots, Range::MAX);
+	    filter(snapshots, candidates);
+	});
+
+	if (!candidates.empty())
+	    remove(candidates);
+    }
+
+
+    void
+    Cleaner::cleanup(Snapshots& snapshots, std::function<bool()> condition)
+    {
+	// Deleting candidates does not change which of the remaining snapshots
+	// are candidates. So the candidates are calculated only once and the
+	// batches are removed one after the other until the condition is
+	// satisfied.
+
+	list<list<Snapshots::iterator>> tmp;
+
+	guarded([this, &snapshots, &tmp]() {
+	    tmp = batches(snapshots, calculate_candidates(snapshots, Range::MIN));
+	});
+
+	while (!condition())
+	{
+	    if (tmp.empty())
+	    {
+		// not enough candidates to satisfy the condition
+		y2mil("condition not satisfied");
+		return;
+	    }
+
+	    remove(tmp.front());
+	    tmp.pop_front();
+	}
+
+	y2mil("condition satisfied");
+    }
+
+
+    void
+    Cleaner::cleanup_incremental_quota(Snapshots& snapshots)
+    {
+	// The quota data (including the exclusive space of every snapshot) is
+	// only valid directly after a rescan. Instead of rescanning after every
+	// deletion the space freed by deleting a snapshot is predicted by its
+	// exclusive space. Since deleting several snapshots can free more than
+	// the sum of their exclusive spaces (data shared only between the
+	// deleted snapshots) the prediction is a lower bound. Thus after
+	// deleting a batch the condition is satisfied if predicted, possibly
+	// with a few more snapshots deleted than strictly necessary.
+
+	QuotaData quota_data = snapper->queryQuotaData();
+
+	list<list<Snapshots::iterator>> tmp;
+
+	guarded([this, &snapshots, &tmp]() {
+	    tmp = batches(snapshots, calculate_candidates(snapshots, Range::MIN));
+	});
+
+	while (!is_quota_satisfied(quota_data))
+	{
+	    list<Snapshots::iterator> batch;
+
+	    QuotaData predicted = quota_data;
+
+	    while (!tmp.empty())
+	    {
+		predicted.used -= min(predicted.used, used_space(tmp.front()));
+		batch.splice(batch.end(), tmp.front());
+		tmp.pop_front();
+
+		if (is_quota_satisfied(predicted))
+		    break;
+	    }
+
+	    if (batch.empty())
+	    {
+		// not enough candidates to satisfy the condition
+		y2mil("condition not satisfied");
+		return;
+	    }
+
+	    remove(batch);
+
+	    // confirm the prediction
+	    quota_data = snapper->queryQuotaData();
+	}
+
+	y2mil("condition satisfied");
+    }
+
+
+    void
+    Cleaner::cleanup()
+    {
+	Snapshots& snapshots = snapper->getSnapshots();
+
+	y2mil("cleanup without condition");
+
+	cleanup(snapshots);
+
+	if (is_quota_aware())
+	{
+	    y2mil("cleanup with quota condition");
+
+	    if (parameters.incremental_quota)
+		cleanup_incremental_quota(snapshots);
+	    else
+		cleanup(snapshots, [this]() { return is_quota_satisfied(); });
+	}
+	else
+	{
+	    y2mil("no cleanup with quota condition");
+	}
+
+	if (is_free_aware())
+	{
+	    y2mil("cleanup with free condition");
+
+	    cleanup(snapshots, [this]() { return is_free_satisfied(); });
+	}
+	else
+	{
+	    y2mil("no cleanup with free condition");
+	}
+    }
+
+
+    struct NumberParameters : public Parameters
+    {
+	NumberParameters(const ConfigInfo& config_info);
+
+	bool is_degenerated() const;
+
+	Range limit;
+	Range limit_important;
+    };
+
+
+    NumberParameters::NumberParameters(const ConfigInfo& config_info)
+	: Parameters(config_info), limit(50), limit_important(10)
+    {
+	read(config_info, "NUMBER_MIN_AGE", min_age);
+
+	read(config_info, "NUMBER_LIMIT", limit);
+	read(config_info, "NUMBER_LIMIT_IMPORTANT", limit_important);
+    }
+
+
+    bool
+    NumberParameters::is_degenerated() const
+    {
+	return limit.is_degenerated() && limit_important.is_degenerated();
+    }
+
+
+    class NumberCleaner : public Cleaner
+    {
+
+    public:
+
+	NumberCleaner(Snapper* snapper, const NumberParameters& parameters, cleanup_pred_t pred,
+		      cleanup_cb_t cb, cleanup_guard_t guard)
+	    : Cleaner(snapper, parameters, pred, cb, guard) {}
+
+    private:
+
+	bool
+	is_important(Snapshots::const_iterator it1)
+	{
+	    map<string, string>::const_iterator it2 = it1->getUserdata().find("important");
+	    return it2 != it1->getUserdata().end() && it2->second == "yes";
+	}
+
+
+	list<Snapshots::iterator>
+	calculate_candidates(Snapshots& snapshots, Range::Value value) override
+	{
+	    const NumberParameters& parameters = dynamic_cast<const NumberParameters&>(Cleaner::parameters);
+
+	    list<Snapshots::iterator> ret;
+
+	    for (Snapshots::iterator it = snapshots.begin(); it != snapshots.end(); ++it)
+	    {
+		if (it->getCleanup() == "number")
+		    ret.push_front(it);
+	    }
+
+	    size_t num = 0;
+	    size_t num_important = 0;
+
+	    list<Snapshots::iterator>::iterator it = ret.begin();
+	    while (it != ret.end())
+	    {
+		bool keep = false;
+
+		if (num_important < parameters.limit_important.value(value) && is_important(*it))
+		{
+		    ++num_important;
+		    keep = true;
+		}
+		if (num < parameters.limit.value(value))
+		{
+		    ++num;
+		    keep = true;
+		}
+
+		if (keep)
+		    it = ret.erase(it);
+		else
+		    ++it;
+	    }
+
+	    ret.reverse();
+
+	    return ret;
+	}
+    };
+
+
+    struct TimelineParameters : public Parameters
+    {
+	TimelineParameters(const ConfigInfo& config_info);
+
+	bool is_degenerated() const;
+
+	Range limit_hourly;
+	Range limit_daily;
+	Range limit_monthly;
+	Range limit_weekly;
+	Range limit_yearly;
+    };
+
+
+    TimelineParameters::TimelineParameters(const ConfigInfo& config_info)
+	: Parameters(config_info), limit_hourly(10), limit_daily(10), limit_monthly(10),
+	  limit_weekly(0), limit_yearly(10)
+    {
+	read(config_info, "TIMELINE_MIN_AGE", min_age);
+
+	read(config_info, "TIMELINE_LIMIT_HOURLY", limit_hourly);
+	read(config_info, "TIMELINE_LIMIT_DAILY", limit_daily);
+	read(config_info, "TIMELINE_LIMIT_WEEKLY", limit_weekly);
+	read(config_info, "TIMELINE_LIMIT_MONTHLY", limit_monthly);
+	read(config_info, "TIMELINE_LIMIT_YEARLY", limit_yearly);
+    }
+
+
+    bool
+    TimelineParameters::is_degenerated() const
+    {
+	return limit_hourly.is_degenerated() && limit_daily.is_degenerated() &&
+	    limit_monthly.is_degenerated() && limit_weekly.is_degenerated() &&
+	    limit_yearly.is_degenerated();
+    }
+
+
+    TimelineDate::TimelineDate(time_t date)
+	: date(date)
+    {
+	localtime_r(&date, &tm);
+    }
+
+
+    // For every date finds out whether it is the first (oldest) of its
+    // period, e.g. the first of its day. Only the directly preceding dates
+    // within the same period are relevant.
+    static vector<bool>
+    firsts(const vector<TimelineDate>& dates,
+	   std::function<bool(const struct tm& tmp1, const struct tm& tmp2)> pred)
+    {
+	vector<bool> ret(dates.size(), true);
+
+	time_t run_min = 0;
+
+	for (size_t i = 0; i < dates.size(); ++i)
+	{
+	    if (i > 0 && pred(dates[i - 1].tm, dates[i].tm))
+	    {
+		ret[i] = run_min >= dates[i].date;
+		run_min = min(run_min, dates[i].date);
+	    }
+	    else
+	    {
+		run_min = dates[i].date;
+	    }
+	}
+
+	return ret;
+    }
+
+
+    vector<bool>
+    timeline_keeps(const vector<TimelineDate>& dates, size_t limit_hourly, size_t limit_daily,
+		   size_t limit_weekly, size_t limit_monthly, size_t limit_yearly)
+    {
+	const vector<bool> firsts_hourly = firsts(dates, equal_hour);
+	const vector<bool> firsts_daily = firsts(dates, equal_day);
+	const vector<bool> firsts_weekly = firsts(dates, equal_week);
+	const vector<bool> firsts_monthly = firsts(dates, equal_month);
+	const vector<bool> firsts_yearly = firsts(dates, equal_year);
+
+	size_t num_hourly = 0;
+	size_t num_daily = 0;
+	size_t num_weekly = 0;
+	size_t num_monthly = 0;
+	size_t num_yearly = 0;
+
+	vector<bool> ret(dates.size(), false);
+
+	// the limits count from the youngest snapshot
+
+	for (size_t i = dates.size(); i-- > 0;)
+	{
+	    if (num_hourly < limit_hourly && firsts_hourly[i])
+	    {
+		++num_hourly;
+		ret[i] = true;
+	    }
+	    if (num_daily < limit_daily && firsts_daily[i])
+	    {
+		++num_daily;
+		ret[i] = true;
+	    }
+	    if (num_weekly < limit_weekly && firsts_weekly[i])
+	    {
+		++num_weekly;
+		ret[i] = true;
+	    }
+	    if (num_monthly < limit_monthly && firsts_monthly[i])
+	    {
+		++num_monthly;
+		ret[i] = true;
+	    }
+	    if (num_yearly < limit_yearly && firsts_yearly[i])
+	    {
+		++num_yearly;
+		ret[i] = true;
+	    }
+	}
+
+	return ret;
+    }
+
+
+    class TimelineCleaner : public Cleaner
+    {
+    public:
+
+	TimelineCleaner(Snapper* snapper, const TimelineParameters& parameters,
+			cleanup_pred_t pred, cleanup_cb_t cb, cleanup_guard_t guard)
+	    : Cleaner(snapper, parameters, pred, cb, guard) {}
+
+    private:
+
+	const TimelineDate&
+	date(Snapshots::const_iterator it)
+	{
+	    map<unsigned int, TimelineDate>::const_iterator pos = dates.find(it->getNum());
+	    if (pos == dates.end())
+		pos = dates.emplace(it->getNum(), TimelineDate(it->getDate())).first;
+
+	    return pos->second;
+	}
+
+
+	list<Snapshots::iterator>
+	calculate_candidates(Snapshots& snapshots, Range::Value value) override
+	{
+	    const TimelineParameters& parameters = dynamic_cast<const TimelineParameters&>(Cleaner::parameters);
+
+	    vector<Snapshots::iterator> tmp;
+	    vector<TimelineDate> tmp_dates;
+
+	    for (Snapshots::iterator it = snapshots.begin(); it != snapshots.end(); ++it)
+	    {
+		if (it->getCleanup() == "timeline")
+		{
+		    tmp.push_back(it);
+		    tmp_dates.push_back(date(it));
+		}
+	    }
+
+	    vector<bool> keeps = timeline_keeps(tmp_dates, parameters.limit_hourly.value(value),
+						parameters.limit_daily.value(value),
+						parameters.limit_weekly.value(value),
+						parameters.limit_monthly.value(value),
+						parameters.limit_yearly.value(value));
+
+	    list<Snapshots::iterator> ret;
+
+	    for (size_t i = 0; i < tmp.size(); ++i)
+	    {
+		if (!keeps[i])
+		    ret.push_back(tmp[i]);
+	    }
+
+	    return ret;
+	}
+
+	// Cache of the broken-down dates by snapshot number.
+	map<unsigned int, TimelineDate> dates;
+
+    };
+
+
+    struct EmptyPrePostParameters : public Parameters
+    {
+	EmptyPrePostParameters(const ConfigInfo& config_info);
+    };
+
+
+    EmptyPrePostParameters::EmptyPrePostParameters(const ConfigInfo& config_info)
+	: Parameters(config_info)
+    {
+	read(config_info, "EMPTY_PRE_POST_MIN_AGE", min_age);
+    }
+
+
+    class EmptyPrePostCleaner : public Cleaner
+    {
+    public:
+
+	EmptyPrePostCleaner(Snapper* snapper, const EmptyPrePostParameters& parameters,
+			    cleanup_pred_t pred, cleanup_cb_t cb, cleanup_guard_t guard)
+	    : Cleaner(snapper, parameters, pred, cb, guard) {}
+
+    private:
+
+	list<Snapshots::iterator>
+	calculate_candidates(Snapshots& snapshots, Range::Value value) override
+	{
+	    vector<pair<Snapshots::iterator, Snapshots::iterator>> pairs;
+
+	    for (Snapshots::iterator it1 = snapshots.begin(); it1 != snapshots.end(); ++it1)
+	    {
+		if (it1->getType() == PRE)
+		{
+		    Snapshots::iterator it2 = snapshots.findPost(it1);
+		    if (it2 != snapshots.end())
+			pairs.emplace_back(it1, it2);
+		}
+	    }
+
+	    // Checking a pair may need to mount and compare the snapshots so
+	    // the pairs are checked in parallel. Every snapshot belongs to at
+	    // most one pair.
+
+	    vector<char> empties(pairs.size(), false);
+	    vector<exception_ptr> errors(pairs.size());
+
+	    parallel_for(pairs.size(), 1, [this, &pairs, &empties, &errors](size_t i) {
+		try
+		{
+		    empties[i] = Comparison::isEmpty(snapper, pairs[i].first, pairs[i].second);
+		}
+		catch (...)
+		{
+		    errors[i] = current_exception();
+		}
+	    });
+
+	    list<Snapshots::iterator> ret;
+
+	    for (size_t i = 0; i < pairs.size(); ++i)
+	    {
+		if (errors[i])
+		    rethrow_exception(errors[i]);
+
+		if (empties[i])
+		{
+		    ret.push_back(pairs[i].first);
+		    ret.push_back(pairs[i].second);
+		}
+	    }
+
+	    return ret;
+	}
+    };
+
+
+    void
+    Snapper::cleanup(const string& algorithm, cleanup_pred_t pred, cleanup_cb_t cb,
+		     cleanup_guard_t guard)
+    {
+	y2mil("cleanup algorithm:" << algorithm);
+
+	if (algorithm == "number")
+	{
+	    NumberParameters parameters(*config_info);
+	    NumberCleaner cleaner(this, parameters, pred, cb, guard);
+	    cleaner.cleanup();
+	}
+	else if (algorithm == "timeline")
+	{
+	    TimelineParameters parameters(*config_info);
+	    TimelineCleaner cleaner(this, parameters, pred, cb, guard);
+	    cleaner.cleanup();
+	}
+	else if (algorithm == "empty-pre-post")
+	{
+	    EmptyPrePostParameters parameters(*config_info);
+	    EmptyPrePostCleaner cleaner(this, parameters, pred, cb, guard);
+	    cleaner.cleanup();
+	}
+	else
+	{
+	    SN_THROW(InvalidCleanupAlgorithmException());
+	}
+    }
+
+}
@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2019 SUSE LLC
+ *
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of version 2 of the GNU General Public License as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, contact Novell, Inc.
+ *
+ * To contact Novell about this file by physical or electronic mail, you may
+ * find current contact information at www.novell.com.
+ */
+
+
+#ifndef SNAPPER_CLEANUP_H
+#define SNAPPER_CLEANUP_H
+
+
+#include <time.h>
+#include <stddef.h>
+#include <vector>
+
+
+namespace snapper
+{
+    using std::vector;
+
+
+    /*
+     * Date of a timeline snapshot together with the broken-down local
+     * time. Calculated only once per snapshot since localtime_r is
+     * expensive.
+     */
+    struct TimelineDate
+    {
+	TimelineDate(time_t date);
+
+	time_t date;
+	struct tm tm;
+    };
+
+
+    /*
+     * Calculates which timeline snapshots are kept with the given limits. The
+     * dates must be ordered like the snapshots, oldest first. The result
+     * holds one entry per date. Runs in linear time.
+     */
+    vector<bool>
+    timeline_keeps(const vector<TimelineDate>& dates, size_t limit_hourly, size_t limit_daily,
+		   size_t limit_weekly, size_t limit_monthly, size_t limit_yearly);
+
+}
+
+
+#endif
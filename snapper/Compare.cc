@@ -29,8 +29,13 @@
 #include <dirent.h>
 #include <unistd.h>
 #include <errno.h>
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#include <linux/fiemap.h>
 #include <algorithm>
+#include <set>
 #include <boost/thread.hpp>
+#include <boost/algorithm/string.hpp>
 
 #include "snapper/Log.h"
 #include "snapper/AppUtil.h"
@@ -46,9 +51,81 @@ namespace snapper
     using namespace std;
 
 
+    /*
+     * Checks whether both files consist of the same physical extents, e.g.
+     * since one is a reflink copy of the other, so that the content is
+     * equal without reading it. Only a shortcut, so false is returned if
+     * FIEMAP is not supported or the layout is in any way uncertain.
+     */
+    bool
+    cmpFilesExtents(int fd1, int fd2)
+    {
+	const unsigned int count = 64;
+
+	vector<uint64_t> buffer1((sizeof(struct fiemap) + count * sizeof(struct fiemap_extent)) /
+				 sizeof(uint64_t) + 1);
+	vector<uint64_t> buffer2(buffer1.size());
+
+	struct fiemap* fiemap1 = reinterpret_cast<struct fiemap*>(buffer1.data());
+	struct fiemap* fiemap2 = reinterpret_cast<struct fiemap*>(buffer2.data());
+
+	// Extents with these flags do not have a reliable physical address.
+
+	const uint32_t unreliable = FIEMAP_EXTENT_UNKNOWN | FIEMAP_EXTENT_DELALLOC |
+	    FIEMAP_EXTENT_ENCODED | FIEMAP_EXTENT_DATA_ENCRYPTED | FIEMAP_EXTENT_NOT_ALIGNED |
+	    FIEMAP_EXTENT_DATA_INLINE | FIEMAP_EXTENT_DATA_TAIL;
+
+	uint64_t start = 0;
+
+	while (true)
+	{
+	    for (struct fiemap* fiemap : { fiemap1, fiemap2 })
+	    {
+		memset(fiemap, 0, sizeof(struct fiemap));
+		fiemap->fm_start = start;
+		fiemap->fm_length = FIEMAP_MAX_OFFSET - start;
+		fiemap->fm_flags = FIEMAP_FLAG_SYNC;
+		fiemap->fm_extent_count = count;
+	    }
+
+	    if (ioctl(fd1, FS_IOC_FIEMAP, fiemap1) != 0 || ioctl(fd2, FS_IOC_FIEMAP, fiemap2) != 0)
+		return false;
+
+	    if (fiemap1->fm_mapped_extents != fiemap2->fm_mapped_extents)
+		return false;
+
+	    // No further extents, so the rest of both files is sparse. If no
+	    // extent at all is mapped do not trust the result.
+
+	    if (fiemap1->fm_mapped_extents == 0)
+		return start != 0;
+
+	    for (unsigned int i = 0; i < fiemap1->fm_mapped_extents; ++i)
+	    {
+		const struct fiemap_extent& extent1 = fiemap1->fm_extents[i];
+		const struct fiemap_extent& extent2 = fiemap2->fm_extents[i];
+
+		if (extent1.fe_logical != extent2.fe_logical ||
+		    extent1.fe_physical != extent2.fe_physical ||
+		    extent1.fe_length != extent2.fe_length || extent1.fe_flags != extent2.fe_flags)
+		    return false;
+
+		if (extent1.fe_flags & unreliable)
+		    return false;
+	    }
+
+	    const struct fiemap_extent& last = fiemap1->fm_extents[fiemap1->fm_mapped_extents - 1];
+	    if (last.fe_flags & FIEMAP_EXTENT_LAST)
+		return true;
+
+	    start = last.fe_logical + last.fe_length;
+	}
+    }
+
+
     bool
     cmpFilesContentReg(const SFile& file1, const struct stat& stat1, const SFile& file2,
-		       const struct stat& stat2)
+		       const struct stat& stat2, bool cmp_extents)
     {
 	if (stat1.st_mtim.tv_sec == stat2.st_mtim.tv_sec && stat1.st_mtim.tv_nsec == stat2.st_mtim.tv_nsec)
 	    return true;
@@ -77,6 +154,15 @@ namespace snapper
 	    return false;
 	}
 
+	// Files sharing all extents, e.g. reflink copies, need not be read.
+
+	if (cmp_extents && stat1.st_dev == stat2.st_dev && cmpFilesExtents(fd1, fd2))
+	{
+	    close(fd1);
+	    close(fd2);
+	    return true;
+	}
+
 	posix_fadvise(fd1, 0, 0, POSIX_FADV_SEQUENTIAL);
 	posix_fadvise(fd2, 0, 0, POSIX_FADV_SEQUENTIAL);
 
@@ -155,7 +241,7 @@ namespace snapper
 
     bool
     cmpFilesContent(const SFile& file1, const struct stat& stat1, const SFile& file2,
-		    const struct stat& stat2)
+		    const struct stat& stat2, bool cmp_extents)
     {
 	if ((stat1.st_mode & S_IFMT) != (stat2.st_mode & S_IFMT))
 	    SN_THROW(LogicErrorException());
@@ -163,7 +249,7 @@ namespace snapper
 	switch (stat1.st_mode & S_IFMT)
 	{
 	    case S_IFREG:
-		return cmpFilesContentReg(file1, stat1, file2, stat2);
+		return cmpFilesContentReg(file1, stat1, file2, stat2, cmp_extents);
 
 	    case S_IFLNK:
 		return cmpFilesContentLnk(file1, stat1, file2, stat2);
@@ -176,7 +262,7 @@ namespace snapper
 
     unsigned int
     cmpFiles(const SFile& file1, const struct stat& stat1, const SFile& file2,
-	     const struct stat& stat2)
+	     const struct stat& stat2, bool cmp_extents)
     {
 	unsigned int status = 0;
 
@@ -200,7 +286,7 @@ namespace snapper
 	}
 	else
 	{
-	    if (!cmpFilesContent(file1, stat1, file2, stat2))
+	    if (!cmpFilesContent(file1, stat1, file2, stat2, cmp_extents))
 		status |= CONTENT;
 	}
 
@@ -252,7 +338,7 @@ namespace snapper
 	if (r2 != 0)
 	    SN_THROW(IOErrorException("lstat failed path:" + file2.fullname()));
 
-	return cmpFiles(file1, stat1, file2, stat2);
+	return cmpFiles(file1, stat1, file2, stat2, false);
     }
 
 
@@ -290,6 +376,8 @@ namespace snapper
 	dev_t dev1;
 	dev_t dev2;
 
+	bool cmp_extents;
+
 	cmpdirs_cb_t cb;
     };
 
@@ -311,11 +399,12 @@ namespace snapper
 
     void
     twosome(const CmpData& cmp_data, const SDir& dir1, const SDir& dir2, const string& path,
-	    const string& name, const struct stat& stat1, const struct stat& stat2)
+	    const string& name, const struct stat& stat1, const struct stat& stat2, bool recurse)
     {
 	unsigned int status = 0;
 	if (stat1.st_dev == cmp_data.dev1 && stat2.st_dev == cmp_data.dev2)
-	    status = cmpFiles(SFile(dir1, name), stat1, SFile(dir2, name), stat2);
+	    status = cmpFiles(SFile(dir1, name), stat1, SFile(dir2, name), stat2,
+			      cmp_data.cmp_extents);
 
 	if (status != 0)
 	{
@@ -324,7 +413,7 @@ namespace snapper
 
 	if (!(status & TYPE))
 	{
-	    if (S_ISDIR(stat1.st_mode))
+	    if (recurse && S_ISDIR(stat1.st_mode))
 		if (stat1.st_dev == cmp_data.dev1 && stat2.st_dev == cmp_data.dev2)
 		    cmpDirsWorker(cmp_data, SDir(dir1, name), SDir(dir2, name), path + "/" + name);
 	}
@@ -417,7 +506,7 @@ namespace snapper
 		struct stat stat2;
 		dir2.stat(*first2, &stat2, AT_SYMLINK_NOFOLLOW); // TODO error check
 
-		twosome(cmp_data, dir1, dir2, path, *first1, stat1, stat2);
+		twosome(cmp_data, dir1, dir2, path, *first1, stat1, stat2, true);
 		++first1;
 		++first2;
 	    }
@@ -426,7 +515,7 @@ namespace snapper
 
 
     void
-    cmpDirs(const SDir& dir1, const SDir& dir2, cmpdirs_cb_t cb)
+    cmpDirs(const SDir& dir1, const SDir& dir2, cmpdirs_cb_t cb, bool cmp_extents)
     {
 	y2mil("path1:" << dir1.fullname() << " path2:" << dir2.fullname());
 
@@ -446,8 +535,9 @@ namespace snapper
 	cmp_data.cb = cb;
 	cmp_data.dev1 = stat1.st_dev;
 	cmp_data.dev2 = stat2.st_dev;
+	cmp_data.cmp_extents = cmp_extents;
 
-	y2mil("dev1:" << cmp_data.dev1 << " dev2:" << cmp_data.dev2);
+	y2mil_kv("devices", { "dev1", cmp_data.dev1 }, { "dev2", cmp_data.dev2 });
 
 	StopWatch stopwatch;
 	cmpDirsWorker(cmp_data, dir1, dir2, "");
@@ -455,15 +545,128 @@ namespace snapper
     }
 
 
+    /*
+     * Opens the directory path below base. Fails if a component is missing,
+     * no directory or on another device, just like cmpDirsWorker does not
+     * descend into it.
+     */
+    bool
+    openParent(const SDir& base, dev_t dev, const vector<string>& components, SDir& dir)
+    {
+	dir = base;
+
+	for (vector<string>::const_iterator it = components.begin(); it != components.end() - 1; ++it)
+	{
+	    struct stat stat;
+	    if (dir.stat(*it, &stat, AT_SYMLINK_NOFOLLOW) != 0 || !S_ISDIR(stat.st_mode) ||
+		stat.st_dev != dev)
+		return false;
+
+	    dir = SDir(dir, *it);
+	}
+
+	return true;
+    }
+
+
+    void
+    cmpDirsPaths(const SDir& dir1, const SDir& dir2, const map<string, bool>& paths,
+		 cmpdirs_cb_t cb)
+    {
+	y2mil("path1:" << dir1.fullname() << " path2:" << dir2.fullname() << " paths:" <<
+	      paths.size());
+
+	struct stat stat1;
+	int r1 = dir1.stat(&stat1);
+	if (r1 != 0)
+	    SN_THROW(IOErrorException(sformat("stat failed path:%s errno:%d",
+					      dir1.fullname().c_str(), errno)));
+
+	struct stat stat2;
+	int r2 = dir2.stat(&stat2);
+	if (r2 != 0)
+	    SN_THROW(IOErrorException(sformat("stat failed path:%s errno:%d",
+					      dir2.fullname().c_str(), errno)));
+
+	// A path can be reported for itself and for a parent directory,
+	// e.g. when both were created.
+
+	set<string> reported;
+
+	CmpData cmp_data;
+	cmp_data.cb = [&reported, &cb](const string& name, unsigned int status) {
+	    if (reported.insert(name).second)
+		cb(name, status);
+	};
+	cmp_data.dev1 = stat1.st_dev;
+	cmp_data.dev2 = stat2.st_dev;
+	cmp_data.cmp_extents = false;
+
+	StopWatch stopwatch;
+
+	for (map<string, bool>::const_iterator it = paths.begin(); it != paths.end(); ++it)
+	{
+	    boost::this_thread::interruption_point();
+
+	    vector<string> components;
+	    boost::split(components, it->first, boost::is_any_of("/"), boost::token_compress_on);
+	    components.erase(remove(components.begin(), components.end(), ""), components.end());
+
+	    if (components.empty() || filter("/" + components.front()))
+		continue;
+
+	    // If a parent directory differs, it is in the paths itself since
+	    // that is a change of its parent directory.
+
+	    SDir parent1 = dir1;
+	    SDir parent2 = dir2;
+	    if (!openParent(dir1, cmp_data.dev1, components, parent1) ||
+		!openParent(dir2, cmp_data.dev2, components, parent2))
+		continue;
+
+	    const string& name = components.back();
+	    const string path = it->first.substr(0, it->first.size() - name.size() - 1);
+
+	    struct stat stat1;
+	    bool exists1 = parent1.stat(name, &stat1, AT_SYMLINK_NOFOLLOW) == 0;
+
+	    struct stat stat2;
+	    bool exists2 = parent2.stat(name, &stat2, AT_SYMLINK_NOFOLLOW) == 0;
+
+	    if (exists1 && exists2)
+	    {
+		twosome(cmp_data, parent1, parent2, path, name, stat1, stat2, it->second);
+	    }
+	    else if (exists1)
+	    {
+		if (stat1.st_dev == cmp_data.dev1)
+		    lonesome(parent1, path, name, stat1, DELETED, cmp_data.cb);
+	    }
+	    else if (exists2)
+	    {
+		if (stat2.st_dev == cmp_data.dev2)
+		    lonesome(parent2, path, name, stat2, CREATED, cmp_data.cb);
+	    }
+	}
+
+	y2mil("stopwatch " << stopwatch << " for comparing " << paths.size() << " paths");
+    }
+
+
     unsigned int
     cmpFilesXattrs(const SFile& file1, const SFile& file2)
     {
         try
         {
-	    XAttributes xa(file1);
-	    XAttributes xb(file2);
+	    // The buffers are reused by all comparisons of a thread.
+
+	    static thread_local FlatXAttributes xa;
+	    static thread_local FlatXAttributes xb;
 
-	    if (xa == xb)
+	    xa.read(file1);
+	    xb.read(file2);
+
+	    if (xa.equal(xb))
 	    {
 		return 0;
 	    }
@@ -471,10 +674,7 @@ namespace snapper
 	    {
 		unsigned int status = XATTRS;
 
-		CompareAcls acl_a(xa);
-		CompareAcls acl_b(xb);
-
-		status |= (acl_a == acl_b) ? 0 : ACL;
+		status |= xa.equalAcls(xb) ? 0 : ACL;
 
 		return status;
 	    }
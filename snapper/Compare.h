@@ -26,6 +26,7 @@
 
 #include <string>
 #include <vector>
+#include <map>
 #include <functional>
 
 #include "snapper/FileUtils.h"
@@ -44,9 +45,17 @@ namespace snapper
     cmpFiles(const SFile& file1, const SFile& file2);
 
     /* Compares the two directories. All file-operations use the openat
-       et.al. functions. */
+       et.al. functions. With cmp_extents files sharing all physical
+       extents, e.g. reflink copies, are equal without reading them. */
     void
-    cmpDirs(const SDir& dir1, const SDir& dir2, cmpdirs_cb_t cb);
+    cmpDirs(const SDir& dir1, const SDir& dir2, cmpdirs_cb_t cb, bool cmp_extents = false);
+
+    /* Compares only the given paths of the two directories, e.g. the
+       paths from a ChangeJournal. For paths mapped to true the subtree is
+       compared completely. */
+    void
+    cmpDirsPaths(const SDir& dir1, const SDir& dir2, const std::map<string, bool>& paths,
+		 cmpdirs_cb_t cb);
 
     /* Compares the two files extended attributes and ACLs.
        Returns 0 or XATTRS or (XATTRS | ACL) */
@@ -27,6 +27,7 @@
 #include <fcntl.h>
 #include <string.h>
 #include <errno.h>
+#include <fnmatch.h>
 
 #include "snapper/Comparison.h"
 #include "snapper/Snapper.h"
@@ -37,6 +38,7 @@
 #include "snapper/SnapperTmpl.h"
 #include "snapper/AsciiFile.h"
 #include "snapper/Filesystem.h"
+#include "snapper/ChangeJournal.h"
 
 
 namespace snapper
@@ -132,6 +134,36 @@ namespace snapper
     }
 
 
+    /*
+     * Compares the snapshots. If one of them is the current system and the
+     * change journal covers the other one only the paths changed since are
+     * compared. The other one must still be read-only, changes in it are
+     * not recorded.
+     */
+    static void
+    cmp_snapshots(const Snapper* snapper, Snapshots::const_iterator snapshot1,
+		  Snapshots::const_iterator snapshot2, const SDir& dir1, const SDir& dir2,
+		  cmpdirs_cb_t cb)
+    {
+	ChangeJournal* change_journal = snapper->getChangeJournal();
+
+	if (change_journal && snapshot1->isCurrent() != snapshot2->isCurrent())
+	{
+	    Snapshots::const_iterator snapshot = snapshot1->isCurrent() ? snapshot2 : snapshot1;
+
+	    map<string, bool> paths;
+	    if (snapshot->isReadOnly() &&
+		change_journal->getPaths(snapshot->getNum(), snapshot->getDate(), paths))
+	    {
+		cmpDirsPaths(dir1, dir2, paths, cb);
+		return;
+	    }
+	}
+
+	snapper->getFilesystem()->cmpDirs(dir1, dir2, cb);
+    }
+
+
     void
     Comparison::create()
     {
@@ -146,7 +178,7 @@ namespace snapper
 	{
 	    SDir dir1 = getSnapshot1()->openSnapshotDir();
 	    SDir dir2 = getSnapshot2()->openSnapshotDir();
-	    snapper->getFilesystem()->cmpDirs(dir1, dir2, cb);
+	    cmp_snapshots(snapper, getSnapshot1(), getSnapshot2(), dir1, dir2, cb);
 	}
 
 	do_umount();
@@ -265,6 +297,132 @@ namespace snapper
     }
 
 
+    static bool
+    is_ignored(const vector<string>& ignore_patterns, const string& name)
+    {
+	for (const string& ignore_pattern : ignore_patterns)
+	    if (fnmatch(ignore_pattern.c_str(), name.c_str(), FNM_LEADING_DIR) == 0)
+		return true;
+	return false;
+    }
+
+
+    // Thrown by the callback to stop comparing directories. Intentionally not
+    // derived from Exception so that the fallbacks in the cmpDirs
+    // implementations are not triggered.
+    struct DifferenceFound
+    {
+    };
+
+
+    bool
+    Comparison::isEmpty(const Snapper* snapper, Snapshots::const_iterator snapshot1,
+			Snapshots::const_iterator snapshot2)
+    {
+	if (snapshot1 == snapper->getSnapshots().end() ||
+	    snapshot2 == snapper->getSnapshots().end() ||
+	    snapshot1 == snapshot2)
+	    SN_THROW(IllegalSnapshotException());
+
+	y2mil("num1:" << snapshot1->getNum() << " num2:" << snapshot2->getNum());
+
+	const vector<string>& ignore_patterns = snapper->getIgnorePatterns();
+
+	// Same condition as in initialize() for using the filelist.
+
+	bool fixed = !snapshot1->isCurrent() && !snapshot2->isCurrent();
+
+	if (fixed)
+	{
+	    try
+	    {
+		fixed = snapshot1->isReadOnly() && snapshot2->isReadOnly();
+	    }
+	    catch (const runtime_error& e)
+	    {
+		y2err("failed to query read-only status, " << e.what());
+		fixed = false;
+	    }
+	}
+
+	if (fixed)
+	{
+	    unsigned int num1 = min(snapshot1->getNum(), snapshot2->getNum());
+	    unsigned int num2 = max(snapshot1->getNum(), snapshot2->getNum());
+
+	    try
+	    {
+		SDir infos_dir = snapper->openInfosDir();
+		SDir info_dir = SDir(infos_dir, decString(num2));
+
+		int fd = info_dir.open("filelist-" + decString(num1) + ".txt", O_RDONLY | O_NOATIME |
+				       O_NOFOLLOW | O_CLOEXEC);
+		if (fd != -1)
+		{
+		    AsciiFileReader asciifile(fd);
+
+		    string line;
+		    while (asciifile.getline(line))
+		    {
+			string::size_type pos = line.find(" ");
+			if (pos == string::npos)
+			    continue;
+
+			if (!is_ignored(ignore_patterns, string(line, pos + 1)))
+			    return false;
+		    }
+
+		    return true;
+		}
+	    }
+	    catch (const FileNotFoundException& e)
+	    {
+	    }
+	}
+
+	cmpdirs_cb_t cb = [&ignore_patterns](const string& name, unsigned int status) {
+	    if (!is_ignored(ignore_patterns, name))
+		throw DifferenceFound();
+	};
+
+	if (!snapshot1->isCurrent())
+	    snapshot1->mountFilesystemSnapshot(false);
+	if (!snapshot2->isCurrent())
+	    snapshot2->mountFilesystemSnapshot(false);
+
+	bool empty = true;
+
+	try
+	{
+	    SDir dir1 = snapshot1->openSnapshotDir();
+	    SDir dir2 = snapshot2->openSnapshotDir();
+	    cmp_snapshots(snapper, snapshot1, snapshot2, dir1, dir2, cb);
+	}
+	catch (const DifferenceFound&)
+	{
+	    empty = false;
+	}
+	catch (...)
+	{
+	    if (!snapshot1->isCurrent())
+		snapshot1->umountFilesystemSnapshot(false);
+	    if (!snapshot2->isCurrent())
+		snapshot2->umountFilesystemSnapshot(false);
+
+	    throw;
+	}
+
+	if (!snapshot1->isCurrent())
+	    snapshot1->umountFilesystemSnapshot(false);
+	if (!snapshot2->isCurrent())
+	    snapshot2->umountFilesystemSnapshot(false);
+
+	y2mil("empty:" << empty);
+
+	return empty;
+    }
+
+
     UndoStatistic
     Comparison::getUndoStatistic() const
     {
@@ -304,4 +462,14 @@ namespace snapper
 	return files.doUndoStep(undo_step);
     }
 
+
+    bool
+    Comparison::doUndoSteps(const vector<UndoStep>& undo_steps, Files::undo_cb_t cb)
+    {
+	if (getSnapshot1()->isCurrent())
+	    SN_THROW(IllegalSnapshotException());
+
+	return files.doUndoSteps(undo_steps, cb);
+    }
+
 }
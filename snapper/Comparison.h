@@ -60,6 +60,16 @@ namespace snapper
 	vector<UndoStep> getUndoSteps() const;
 
 	bool doUndoStep(const UndoStep& undo_step);
+	bool doUndoSteps(const vector<UndoStep>& undo_steps, Files::undo_cb_t cb);
+
+	/**
+	 * Check whether two snapshots have no differences except for ignored
+	 * files. Much cheaper than creating a comparison since a saved
+	 * filelist is used if available and otherwise the comparison stops
+	 * at the first difference. Nothing is saved.
+	 */
+	static bool isEmpty(const Snapper* snapper, Snapshots::const_iterator snapshot1,
+			    Snapshots::const_iterator snapshot2);
 
     private:
 
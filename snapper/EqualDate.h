@@ -20,18 +20,32 @@
  */
 
 
-bool
-equal_year(const struct tm& tmp1, const struct tm& tmp2);
+#ifndef SNAPPER_EQUAL_DATE_H
+#define SNAPPER_EQUAL_DATE_H
 
-bool
-equal_month(const struct tm& tmp1, const struct tm& tmp2);
 
-bool
-equal_week(const struct tm& tmp1, const struct tm& tmp2);
+#include <time.h>
 
-bool
-equal_day(const struct tm& tmp1, const struct tm& tmp2);
 
-bool
-equal_hour(const struct tm& tmp1, const struct tm& tmp2);
+namespace snapper
+{
 
+    bool
+    equal_year(const struct tm& tmp1, const struct tm& tmp2);
+
+    bool
+    equal_month(const struct tm& tmp1, const struct tm& tmp2);
+
+    bool
+    equal_week(const struct tm& tmp1, const struct tm& tmp2);
+
+    bool
+    equal_day(const struct tm& tmp1, const struct tm& tmp2);
+
+    bool
+    equal_hour(const struct tm& tmp1, const struct tm& tmp2);
+
+}
+
+
+#endif
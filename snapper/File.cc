@@ -30,9 +30,13 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <locale>
+#include <deque>
+#include <unordered_map>
 #include <boost/algorithm/string.hpp>
+#include <boost/thread.hpp>
 
 #include "snapper/File.h"
+#include "snapper/FileUtils.h"
 #include "snapper/Snapper.h"
 #include "snapper/AppUtil.h"
 #include "snapper/Enum.h"
@@ -51,7 +55,9 @@ namespace snapper
     {
 	s << "numCreate:" << rs.numCreate
 	  << " numModify:" << rs.numModify
-	  << " numDelete:" << rs.numDelete;
+	  << " numDelete:" << rs.numDelete
+	  << " bytesCloned:" << rs.bytesCloned
+	  << " bytesCopied:" << rs.bytesCopied;
 
 	return s;
     }
@@ -164,21 +170,111 @@ namespace snapper
     }
 
 
+    /*
+     * Stack of open directories within one tree. Files in the same or
+     * nearby directories share the already opened directories.
+     */
+    class DirStack
+    {
+    public:
+
+	explicit DirStack(const string& base_path)
+	{
+	    dirs.emplace_back(base_path);
+	}
+
+	/*
+	 * Returns the directory with the given path components or nullptr if
+	 * it does not exist.
+	 */
+	const SDir*
+	open(const vector<string>& components)
+	{
+	    size_t common = 0;
+	    while (common < names.size() && common < components.size() &&
+		   names[common] == components[common])
+		++common;
+
+	    names.resize(common);
+	    while (dirs.size() > common + 1)
+		dirs.pop_back();
+
+	    for (size_t i = common; i < components.size(); ++i)
+	    {
+		struct stat fs;
+		if (dirs.back().stat(components[i], &fs, AT_SYMLINK_NOFOLLOW) != 0 ||
+		    !S_ISDIR(fs.st_mode))
+		    return nullptr;
+
+		dirs.emplace_back(dirs.back(), components[i]);
+		names.push_back(components[i]);
+	    }
+
+	    return &dirs.back();
+	}
+
+    private:
+
+	// dirs[i + 1] is the directory names[i] within dirs[i]
+	std::deque<SDir> dirs;
+	vector<string> names;
+
+    };
+
+
+    static vector<string>
+    dirname_components(const string& name)
+    {
+	vector<string> components;
+
+	string dirname = snapper::dirname(name);
+	if (dirname == "/" || dirname == ".")
+	    return components;
+
+	boost::split(components, dirname, boost::is_any_of("/"), boost::token_compress_on);
+	if (!components.empty() && components.front().empty())
+	    components.erase(components.begin());
+
+	return components;
+    }
+
+
+    static unsigned int
+    cmp_file(DirStack& stack1, DirStack& stack2, const string& name)
+    {
+	vector<string> components = dirname_components(name);
+	string basename = snapper::basename(name);
+
+	const SDir* dir1 = stack1.open(components);
+	const SDir* dir2 = stack2.open(components);
+
+	if (dir1 && dir2)
+	    return cmpFiles(SFile(*dir1, basename), SFile(*dir2, basename));
+
+	// the directory is missing in at least one tree
+
+	struct stat fs;
+
+	if (dir2 && dir2->stat(basename, &fs, AT_SYMLINK_NOFOLLOW) == 0)
+	    return CREATED;
+
+	if (dir1 && dir1->stat(basename, &fs, AT_SYMLINK_NOFOLLOW) == 0)
+	    return DELETED;
+
+	SN_THROW(IOErrorException("stat failed name:" + name));
+	__builtin_unreachable();
+    }
+
+
     unsigned int
     File::getPreToSystemStatus()
     {
 	if (pre_to_system_status == (unsigned int)(-1))
 	{
-	    SDir dir1(file_paths->pre_path);
-	    SDir dir2(file_paths->system_path);
+	    DirStack stack1(file_paths->pre_path);
+	    DirStack stack2(file_paths->system_path);
 
-	    string dirname = snapper::dirname(name);
-	    string basename = snapper::basename(name);
-
-	    SDir subdir1 = SDir::deepopen(dir1, dirname);
-	    SDir subdir2 = SDir::deepopen(dir2, dirname);
-
-	    pre_to_system_status = cmpFiles(SFile(subdir1, basename), SFile(subdir2, basename));
+	    pre_to_system_status = cmp_file(stack1, stack2, name);
 	}
 
 	return pre_to_system_status;
@@ -190,16 +286,10 @@ namespace snapper
     {
 	if (post_to_system_status == (unsigned int)(-1))
 	{
-	    SDir dir1(file_paths->post_path);
-	    SDir dir2(file_paths->system_path);
-
-	    string dirname = snapper::dirname(name);
-	    string basename = snapper::basename(name);
+	    DirStack stack1(file_paths->post_path);
+	    DirStack stack2(file_paths->system_path);
 
-	    SDir subdir1 = SDir::deepopen(dir1, dirname);
-	    SDir subdir2 = SDir::deepopen(dir2, dirname);
-
-	    post_to_system_status = cmpFiles(SFile(subdir1, basename), SFile(subdir2, basename));
+	    post_to_system_status = cmp_file(stack1, stack2, name);
 	}
 
 	return post_to_system_status;
@@ -249,103 +339,112 @@ namespace snapper
     }
 
 
-    bool
-    File::createParentDirectories(const string& path) const
+    SDir
+    File::openParentDirectory(const string& base_path, bool create) const
     {
-	string::size_type pos = path.rfind('/');
-	if (pos == string::npos)
-	    return true;
+	SDir dir(base_path);
 
-	const string& leading_path = path.substr(0, pos);
+	vector<string> components;
+	boost::split(components, snapper::dirname(name), boost::is_any_of("/"),
+		     boost::token_compress_on);
 
-	struct stat fs;
-	if (stat(leading_path.c_str(), &fs) == 0)
+	for (const string& component : components)
 	{
-	    if (!S_ISDIR(fs.st_mode))
-	    {
-		y2err("not a directory path:" << leading_path);
-		return false;
-	    }
+	    if (component.empty() || component == ".")
+		continue;
 
-	    return true;
-	}
+	    struct stat fs;
+	    if (create && dir.stat(component, &fs, AT_SYMLINK_NOFOLLOW) != 0 && errno == ENOENT)
+	    {
+		// EEXIST is fine since another undo step may have created the
+		// directory meanwhile.
 
-	if (!createParentDirectories(leading_path))
-	    return false;
+		if (dir.mkdir(component, 0777) != 0 && errno != EEXIST)
+		    SN_THROW(IOErrorException(sformat("mkdir failed path:%s errno:%d (%s)",
+						      dir.fullname(component).c_str(), errno,
+						      stringerror(errno).c_str())));
+	    }
 
-	if (mkdir(leading_path.c_str(), 0777) != 0)
-	{
-	    y2err("mkdir failed path:" << leading_path << " errno:" << errno << " (" <<
-		  stringerror(errno) << ")");
-	    return false;
+	    dir = SDir(dir, component);
 	}
 
-	return true;
+	return dir;
     }
 
 
     bool
-    File::createAllTypes() const
+    File::createAllTypes()
     {
-	struct stat fs;
-	if (lstat(getAbsolutePath(LOC_PRE).c_str(), &fs) != 0)
-	{
-	    y2err("lstat failed path:" << getAbsolutePath(LOC_SYSTEM) << " errno:" << errno <<
-		  " (" << stringerror(errno) << ")");
-	    return false;
-	}
-	else if (!createParentDirectories(getAbsolutePath(LOC_SYSTEM)))
-	{
-	    return false;
-	}
-	else
+	try
 	{
+	    SDir pre_dir = openParentDirectory(file_paths->pre_path, false);
+	    SDir system_dir = openParentDirectory(file_paths->system_path, true);
+
+	    string basename = snapper::basename(name);
+
+	    struct stat fs;
+	    if (pre_dir.stat(basename, &fs, AT_SYMLINK_NOFOLLOW) != 0)
+	    {
+		y2err("lstat failed path:" << pre_dir.fullname(basename) << " errno:" << errno <<
+		      " (" << stringerror(errno) << ")");
+		return false;
+	    }
+
 	    switch (fs.st_mode & S_IFMT)
 	    {
 		case S_IFDIR: {
-		    if (!createDirectory(fs.st_mode, fs.st_uid, fs.st_gid))
+		    if (!createDirectory(system_dir, fs.st_mode, fs.st_uid, fs.st_gid))
 			return false;
 		} break;
 
 		case S_IFREG: {
-		    if (!createFile(fs.st_mode, fs.st_uid, fs.st_gid))
+		    if (!createFile(pre_dir, system_dir, fs.st_mode, fs.st_uid, fs.st_gid))
 			return false;
 		} break;
 
 		case S_IFLNK: {
-		    if (!createLink(fs.st_uid, fs.st_gid))
+		    if (!createLink(pre_dir, system_dir, fs.st_uid, fs.st_gid))
 			return false;
 		} break;
 	    }
 	}
+	catch (const IOErrorException& e)
+	{
+	    SN_CAUGHT(e);
+	    return false;
+	}
 
 	return true;
     }
 
 
     bool
-    File::createDirectory(mode_t mode, uid_t owner, gid_t group) const
+    File::createDirectory(const SDir& system_dir, mode_t mode, uid_t owner, gid_t group) const
     {
-	if (mkdir(getAbsolutePath(LOC_SYSTEM).c_str(), 0) != 0)
+	string basename = snapper::basename(name);
+
+	if (system_dir.mkdir(basename, 0) != 0)
 	{
-	    if (errno == EEXIST && !checkDir(getAbsolutePath(LOC_SYSTEM)))
+	    struct stat fs;
+	    if (errno != EEXIST || system_dir.stat(basename, &fs, AT_SYMLINK_NOFOLLOW) != 0 ||
+		!S_ISDIR(fs.st_mode))
 	    {
-		y2err("mkdir failed path:" << getAbsolutePath(LOC_SYSTEM) << " errno:" << errno <<
+		y2err("mkdir failed path:" << system_dir.fullname(basename) << " errno:" << errno <<
 		      " (" << stringerror(errno) << ")");
 		return false;
 	    }
 	}
 
-	if (chown(getAbsolutePath(LOC_SYSTEM).c_str(), owner, group) != 0)
+	if (system_dir.chown(basename, owner, group, AT_SYMLINK_NOFOLLOW) != 0)
 	{
-	    y2err("chown failed path:" << getAbsolutePath(LOC_SYSTEM) << " errno:" << errno <<
+	    y2err("chown failed path:" << system_dir.fullname(basename) << " errno:" << errno <<
 		  " (" << stringerror(errno) << ")");
 	    return false;
 	}
 
-	if (chmod(getAbsolutePath(LOC_SYSTEM).c_str(), mode) != 0)
+	if (system_dir.chmod(basename, mode, 0) != 0)
 	{
-	    y2err("chmod failed path:" << getAbsolutePath(LOC_SYSTEM) << " errno:" << errno <<
+	    y2err("chmod failed path:" << system_dir.fullname(basename) << " errno:" << errno <<
 		  " (" << stringerror(errno) << ")");
 	    return false;
 	}
@@ -355,20 +454,25 @@ namespace snapper
 
 
     bool
-    File::createFile(mode_t mode, uid_t owner, gid_t group) const
+    File::createFile(const SDir& pre_dir, const SDir& system_dir, mode_t mode, uid_t owner,
+		     gid_t group)
     {
-	int src_fd = open(getAbsolutePath(LOC_PRE).c_str(), O_RDONLY | O_LARGEFILE | O_CLOEXEC);
+	string basename = snapper::basename(name);
+
+	int src_fd = pre_dir.open(basename, O_RDONLY | O_NOFOLLOW | O_LARGEFILE | O_CLOEXEC);
 	if (src_fd < 0)
 	{
-	    y2err("open failed errno:" << errno << " (" << stringerror(errno) << ")");
+	    y2err("open failed path:" << pre_dir.fullname(basename) << " errno:" << errno <<
+		  " (" << stringerror(errno) << ")");
 	    return false;
 	}
 
-	int dest_fd = open(getAbsolutePath(LOC_SYSTEM).c_str(), O_WRONLY | O_LARGEFILE |
-			   O_CREAT | O_TRUNC | O_CLOEXEC, mode);
+	int dest_fd = system_dir.open(basename, O_WRONLY | O_NOFOLLOW | O_LARGEFILE | O_CREAT |
+				      O_TRUNC | O_CLOEXEC, mode);
 	if (dest_fd < 0)
 	{
-	    y2err("open failed errno:" << errno << " (" << stringerror(errno) << ")");
+	    y2err("open failed path:" << system_dir.fullname(basename) << " errno:" << errno <<
+		  " (" << stringerror(errno) << ")");
 	    close(src_fd);
 	    return false;
 	}
@@ -391,10 +495,10 @@ namespace snapper
 	    return false;
 	}
 
-	bool ret = clonefile(src_fd, dest_fd) || copyfile(src_fd, dest_fd);
+	bool ret = restoreContent(src_fd, dest_fd);
 	if (!ret)
 	{
-	    y2err("clone and copy failed " << getAbsolutePath(LOC_SYSTEM));
+	    y2err("restoring content failed " << system_dir.fullname(basename));
 	}
 
 	close(dest_fd);
@@ -404,22 +508,128 @@ namespace snapper
     }
 
 
+    // The method used to restore file content is determined by the first
+    // file restored for a config and then reused, see File::restoreContent().
+
+    enum RestoreMethod
+    {
+	RESTORE_CLONE, RESTORE_COPY_FILE_RANGE, RESTORE_SENDFILE
+    };
+
+    static boost::mutex restore_methods_mutex;
+
+    static map<string, RestoreMethod> restore_methods;
+
+
+    static RestoreMethod
+    get_restore_method(const string& system_path)
+    {
+	boost::lock_guard<boost::mutex> lock(restore_methods_mutex);
+
+	map<string, RestoreMethod>::const_iterator it = restore_methods.find(system_path);
+	return it != restore_methods.end() ? it->second : RESTORE_CLONE;
+    }
+
+
+    static void
+    set_restore_method(const string& system_path, RestoreMethod restore_method)
+    {
+	boost::lock_guard<boost::mutex> lock(restore_methods_mutex);
+
+	RestoreMethod& tmp = restore_methods.emplace(system_path, RESTORE_CLONE).first->second;
+	if (tmp < restore_method)
+	{
+	    y2mil("system_path:" << system_path << " restore_method:" << restore_method);
+	    tmp = restore_method;
+	}
+    }
+
+
+    // The snapshot and the system can be on different filesystems, so
+    // EXDEV is also cached for the config.
+
+    static bool
+    is_unsupported_for_config(int errnum)
+    {
+	return is_unsupported(errnum) || errnum == EXDEV;
+    }
+
+
+    bool
+    File::restoreContent(int src_fd, int dest_fd)
+    {
+	// Cloning (reflink) only needs to copy metadata and is thus much
+	// cheaper than copy_file_range which is cheaper than sendfile since
+	// the data stays in the kernel and may be offloaded.
+
+	RestoreMethod restore_method = get_restore_method(file_paths->system_path);
+
+	if (restore_method == RESTORE_CLONE)
+	{
+	    struct stat fs;
+	    if (clonefile(src_fd, dest_fd) && fstat(dest_fd, &fs) == 0)
+	    {
+		bytesCloned += fs.st_size;
+		return true;
+	    }
+
+	    // Otherwise, e.g. for EINVAL, only this file is copied.
+
+	    if (is_unsupported_for_config(errno))
+		set_restore_method(file_paths->system_path, RESTORE_COPY_FILE_RANGE);
+	}
+
+	if (restore_method <= RESTORE_COPY_FILE_RANGE)
+	{
+	    unsigned long long copied = 0;
+	    bool ret = copyfilerange(src_fd, dest_fd, copied);
+	    bytesCopied += copied;
+	    if (ret)
+		return true;
+
+	    if (copied != 0 || !(is_unsupported_for_config(errno) || errno == EINVAL))
+	    {
+		y2err("copy_file_range failed errno:" << errno << " (" << stringerror(errno) << ")");
+		return false;
+	    }
+
+	    if (errno != EINVAL)
+		set_restore_method(file_paths->system_path, RESTORE_SENDFILE);
+	}
+
+	unsigned long long copied = 0;
+	bool ret = copyfile(src_fd, dest_fd, copied);
+	bytesCopied += copied;
+	return ret;
+    }
+
+
     bool
-    File::createLink(uid_t owner, gid_t group) const
+    File::createLink(const SDir& pre_dir, const SDir& system_dir, uid_t owner, gid_t group) const
     {
+	string basename = snapper::basename(name);
+
 	string tmp;
-	readlink(getAbsolutePath(LOC_PRE), tmp);
+	pre_dir.readlink(basename, tmp);
 
-	if (symlink(tmp, getAbsolutePath(LOC_SYSTEM)) != 0)
+	if (system_dir.symlink(tmp, basename) != 0)
 	{
-	    y2err("symlink failed path:" << getAbsolutePath(LOC_SYSTEM) << " errno:" << errno <<
-		  " (" << stringerror(errno) << ")");
-	    return false;
+	    // When resuming an undo the symlink can already exist.
+
+	    int error = errno;
+
+	    string target;
+	    if (error != EEXIST || system_dir.readlink(basename, target) < 0 || target != tmp)
+	    {
+		y2err("symlink failed path:" << system_dir.fullname(basename) << " errno:" << error <<
+		      " (" << stringerror(error) << ")");
+		return false;
+	    }
 	}
 
-	if (lchown(getAbsolutePath(LOC_SYSTEM).c_str(), owner, group) != 0)
+	if (system_dir.chown(basename, owner, group, AT_SYMLINK_NOFOLLOW) != 0)
 	{
-	    y2err("lchown failed path:" << getAbsolutePath(LOC_SYSTEM) << " errno:" << errno <<
+	    y2err("lchown failed path:" << system_dir.fullname(basename) << " errno:" << errno <<
 		  " (" << stringerror(errno) << ")");
 	    return false;
 	}
@@ -431,15 +641,41 @@ namespace snapper
     bool
     File::deleteAllTypes() const
     {
+	try
+	{
+	    SDir system_dir = openParentDirectory(file_paths->system_path, false);
+
+	    return deleteAllTypes(system_dir);
+	}
+	catch (const IOErrorException& e)
+	{
+	    SN_CAUGHT(e);
+
+	    // Nothing to delete if the parent directory is missing.
+
+	    struct stat fs;
+	    if (lstat(getAbsolutePath(LOC_SYSTEM).c_str(), &fs) != 0 && errno == ENOENT)
+		return true;
+
+	    return false;
+	}
+    }
+
+
+    bool
+    File::deleteAllTypes(const SDir& system_dir) const
+    {
+	string basename = snapper::basename(name);
+
 	struct stat fs;
-	if (lstat(getAbsolutePath(LOC_SYSTEM).c_str(), &fs) == 0)
+	if (system_dir.stat(basename, &fs, AT_SYMLINK_NOFOLLOW) == 0)
 	{
 	    switch (fs.st_mode & S_IFMT)
 	    {
 		case S_IFDIR: {
-		    if (rmdir(getAbsolutePath(LOC_SYSTEM).c_str()) != 0)
+		    if (system_dir.unlink(basename, AT_REMOVEDIR) != 0)
 		    {
-			y2err("rmdir failed path:" << getAbsolutePath(LOC_SYSTEM) <<
+			y2err("rmdir failed path:" << system_dir.fullname(basename) <<
 			      " errno:" << errno << " (" << stringerror(errno) << ")");
 			return false;
 		    }
@@ -447,9 +683,9 @@ namespace snapper
 
 		case S_IFREG:
 		case S_IFLNK: {
-		    if (unlink(getAbsolutePath(LOC_SYSTEM).c_str()) != 0)
+		    if (system_dir.unlink(basename, 0) != 0)
 		    {
-			y2err("unlink failed path:" << getAbsolutePath(LOC_SYSTEM) <<
+			y2err("unlink failed path:" << system_dir.fullname(basename) <<
 			      " errno:" << errno << " (" << stringerror(errno) << ")");
 			return false;
 		    }
@@ -461,7 +697,7 @@ namespace snapper
 	    if (errno == ENOENT)
 		return true;
 
-	    y2err("lstat failed path:" << getAbsolutePath(LOC_SYSTEM) <<
+	    y2err("lstat failed path:" << system_dir.fullname(basename) <<
 		  " errno:" << errno << " (" << stringerror(errno) << ")");
 	    return false;
 	}
@@ -471,36 +707,38 @@ namespace snapper
 
 
     bool
-    File::modifyAllTypes() const
+    File::modifyAllTypes()
     {
-	struct stat fs;
-	if (lstat(getAbsolutePath(LOC_PRE).c_str(), &fs) != 0)
-	{
-	    y2err("lstat failed path:" << getAbsolutePath(LOC_SYSTEM) << " errno:" << errno <<
-		  " (" << stringerror(errno) << ")");
-	    return false;
-	}
-	else if (!createParentDirectories(getAbsolutePath(LOC_SYSTEM)))
-	{
-	    return false;
-	}
-	else
+	try
 	{
+	    SDir pre_dir = openParentDirectory(file_paths->pre_path, false);
+	    SDir system_dir = openParentDirectory(file_paths->system_path, true);
+
+	    string basename = snapper::basename(name);
+
+	    struct stat fs;
+	    if (pre_dir.stat(basename, &fs, AT_SYMLINK_NOFOLLOW) != 0)
+	    {
+		y2err("lstat failed path:" << pre_dir.fullname(basename) << " errno:" << errno <<
+		      " (" << stringerror(errno) << ")");
+		return false;
+	    }
+
 	    if (getPreToPostStatus() & CONTENT)
 	    {
 		switch (fs.st_mode & S_IFMT)
 		{
 		    case S_IFREG: {
-			if (!deleteAllTypes())
+			if (!deleteAllTypes(system_dir))
 			    return false;
-			else if (!createFile(fs.st_mode, fs.st_uid, fs.st_gid))
+			else if (!createFile(pre_dir, system_dir, fs.st_mode, fs.st_uid, fs.st_gid))
 			    return false;
 		    } break;
 
 		    case S_IFLNK: {
-			if (!deleteAllTypes())
+			if (!deleteAllTypes(system_dir))
 			    return false;
-			else if (!createLink(fs.st_uid, fs.st_gid))
+			else if (!createLink(pre_dir, system_dir, fs.st_uid, fs.st_gid))
 			    return false;
 		    } break;
 		}
@@ -508,9 +746,9 @@ namespace snapper
 
 	    if (getPreToPostStatus() & (OWNER | GROUP))
 	    {
-		if (lchown(getAbsolutePath(LOC_SYSTEM).c_str(), fs.st_uid, fs.st_gid) != 0)
+		if (system_dir.chown(basename, fs.st_uid, fs.st_gid, AT_SYMLINK_NOFOLLOW) != 0)
 		{
-		    y2err("lchown failed path:" << getAbsolutePath(LOC_SYSTEM) << " errno:" <<
+		    y2err("lchown failed path:" << system_dir.fullname(basename) << " errno:" <<
 			  errno <<  " (" << stringerror(errno) << ")");
 		    return false;
 		}
@@ -520,15 +758,20 @@ namespace snapper
 	    {
 		if (!S_ISLNK(fs.st_mode))
 		{
-		    if (chmod(getAbsolutePath(LOC_SYSTEM).c_str(), fs.st_mode) != 0)
+		    if (system_dir.chmod(basename, fs.st_mode, 0) != 0)
 		    {
-			y2err("chmod failed path:" << getAbsolutePath(LOC_SYSTEM) << " errno:" <<
+			y2err("chmod failed path:" << system_dir.fullname(basename) << " errno:" <<
 			      errno << " (" << stringerror(errno) << ")");
 			return false;
 		    }
 		}
 	    }
 	}
+	catch (const IOErrorException& e)
+	{
+	    SN_CAUGHT(e);
+	    return false;
+	}
 
 	return true;
     }
@@ -624,6 +867,68 @@ namespace snapper
     }
 
 
+    void
+    Files::computeStatuses(Cmp cmp, unsigned int num_threads)
+    {
+	if (cmp == CMP_PRE_TO_POST)
+	    return;
+
+	const string& base_path = cmp == CMP_PRE_TO_SYSTEM ? file_paths->pre_path :
+	    file_paths->post_path;
+
+	if (num_threads == 0)
+	    num_threads = boost::thread::hardware_concurrency();
+	num_threads = std::max(1U, std::min<unsigned int>(num_threads, entries.size() / 1024 + 1));
+
+	y2mil("cmp:" << cmp << " entries:" << entries.size() << " num_threads:" << num_threads);
+
+	// Every thread handles a contiguous range of the sorted entries with
+	// its own directory stacks.
+
+	vector<std::exception_ptr> exceptions(num_threads);
+
+	std::function<void(unsigned int)> worker = [&](unsigned int i) {
+
+	    try
+	    {
+		DirStack stack1(base_path);
+		DirStack stack2(file_paths->system_path);
+
+		size_t first = entries.size() * i / num_threads;
+		size_t last = entries.size() * (i + 1) / num_threads;
+
+		for (size_t j = first; j < last; ++j)
+		{
+		    File& file = entries[j];
+
+		    unsigned int& status = cmp == CMP_PRE_TO_SYSTEM ? file.pre_to_system_status :
+			file.post_to_system_status;
+
+		    if (status == (unsigned int)(-1))
+			status = cmp_file(stack1, stack2, file.name);
+		}
+	    }
+	    catch (...)
+	    {
+		exceptions[i] = std::current_exception();
+	    }
+
+	};
+
+	boost::thread_group threads;
+	for (unsigned int i = 1; i < num_threads; ++i)
+	    threads.create_thread(std::bind(worker, i));
+
+	worker(0);
+
+	threads.join_all();
+
+	for (const std::exception_ptr& exception : exceptions)
+	    if (exception)
+		std::rethrow_exception(exception);
+    }
+
+
     bool
     File::doUndo()
     {
@@ -699,6 +1004,9 @@ namespace snapper
 		    case MODIFY: rs.numModify++; break;
 		    case DELETE: rs.numDelete++; break;
 		}
+
+		rs.bytesCloned += it->bytesCloned;
+		rs.bytesCopied += it->bytesCopied;
 	    }
 	}
 
@@ -744,6 +1052,143 @@ namespace snapper
     }
 
 
+    bool
+    Files::doUndoSteps(const vector<UndoStep>& undo_steps, undo_cb_t cb, unsigned int num_threads)
+    {
+	const size_t total = undo_steps.size();
+
+	// Build the dependency graph. Steps for a directory and for entries
+	// within it are ordered: Entries are deleted before the step for the
+	// directory, everything else happens after it. Steps for unrelated
+	// files are independent. The graph is acyclic since a delete only
+	// waits for deletes of deeper entries.
+
+	vector<vector<size_t>> successors(total);
+	vector<size_t> num_predecessors(total, 0);
+
+	std::function<void(size_t, size_t)> add_edge = [&successors, &num_predecessors](size_t i, size_t j) {
+	    successors[i].push_back(j);
+	    ++num_predecessors[j];
+	};
+
+	std::unordered_map<string, size_t> indices;
+
+	for (size_t i = 0; i < total; ++i)
+	{
+	    std::pair<std::unordered_map<string, size_t>::iterator, bool> tmp =
+		indices.emplace(undo_steps[i].name, i);
+	    if (!tmp.second)
+	    {
+		add_edge(tmp.first->second, i);
+		tmp.first->second = i;
+	    }
+	}
+
+	for (size_t i = 0; i < total; ++i)
+	{
+	    const UndoStep& undo_step = undo_steps[i];
+
+	    for (string dir = snapper::dirname(undo_step.name); dir != "/" && dir != ".";
+		 dir = snapper::dirname(dir))
+	    {
+		std::unordered_map<string, size_t>::const_iterator it = indices.find(dir);
+		if (it == indices.end())
+		    continue;
+
+		if (undo_step.action == DELETE)
+		    add_edge(i, it->second);
+		else
+		    add_edge(it->second, i);
+	    }
+	}
+
+	std::deque<size_t> ready;
+	for (size_t i = 0; i < total; ++i)
+	    if (num_predecessors[i] == 0)
+		ready.push_back(i);
+
+	if (num_threads == 0)
+	    num_threads = boost::thread::hardware_concurrency();
+	num_threads = std::max(1U, std::min<unsigned int>(num_threads, total));
+
+	y2mil("total:" << total << " num_threads:" << num_threads);
+
+	boost::mutex mutex;
+	boost::condition_variable condition;
+
+	size_t done = 0;
+	bool ret = true;
+	std::exception_ptr exception;
+
+	std::function<void()> worker = [&]() {
+
+	    boost::unique_lock<boost::mutex> lock(mutex);
+
+	    while (true)
+	    {
+		while (ready.empty() && done < total && !exception)
+		    condition.wait(lock);
+
+		if (ready.empty() || exception)
+		    return;
+
+		size_t i = ready.front();
+		ready.pop_front();
+
+		lock.unlock();
+
+		bool ok = false;
+
+		try
+		{
+		    ok = doUndoStep(undo_steps[i]);
+		}
+		catch (const Exception& e)
+		{
+		    SN_CAUGHT(e);
+		}
+
+		lock.lock();
+
+		++done;
+
+		if (!ok)
+		    ret = false;
+
+		try
+		{
+		    if (cb)
+			cb(undo_steps[i], ok, done, total);
+		}
+		catch (...)
+		{
+		    exception = std::current_exception();
+		}
+
+		for (size_t j : successors[i])
+		    if (--num_predecessors[j] == 0)
+			ready.push_back(j);
+
+		condition.notify_all();
+	    }
+
+	};
+
+	boost::thread_group threads;
+	for (unsigned int i = 1; i < num_threads; ++i)
+	    threads.create_thread(worker);
+
+	worker();
+
+	threads.join_all();
+
+	if (exception)
+	    std::rethrow_exception(exception);
+
+	return ret;
+    }
+
+
     string
     statusToString(unsigned int status)
     {
@@ -28,6 +28,7 @@
 
 #include <string>
 #include <vector>
+#include <functional>
 
 
 namespace snapper
@@ -36,6 +37,9 @@ namespace snapper
     using std::vector;
 
 
+    class SDir;
+
+
     enum StatusFlags
     {
 	CREATED = 1,		// created
@@ -68,7 +72,7 @@ namespace snapper
 
     struct UndoStatistic
     {
-	UndoStatistic() : numCreate(0), numModify(0), numDelete(0) {}
+	UndoStatistic() : numCreate(0), numModify(0), numDelete(0), bytesCloned(0), bytesCopied(0) {}
 
 	bool empty() const { return numCreate == 0 && numModify == 0 && numDelete == 0; }
 
@@ -76,6 +80,11 @@ namespace snapper
 	unsigned int numModify;
 	unsigned int numDelete;
 
+	// Bytes of file content restored so far by cloning (reflink) and by
+	// copying.
+	unsigned long long bytesCloned;
+	unsigned long long bytesCopied;
+
 	friend std::ostream& operator<<(std::ostream& s, const UndoStatistic& rs);
     };
 
@@ -117,7 +126,7 @@ namespace snapper
 	File(const FilePaths* file_paths, const string& name, unsigned int pre_to_post_status)
 	    : file_paths(file_paths), name(name), pre_to_post_status(pre_to_post_status),
 	      pre_to_system_status(-1), post_to_system_status(-1), undo(false),
-	      xaCreated(0), xaDeleted(0), xaReplaced(0)
+	      xaCreated(0), xaDeleted(0), xaReplaced(0), bytesCloned(0), bytesCopied(0)
 	{}
 
 	const string& getName() const { return name; }
@@ -143,18 +152,23 @@ namespace snapper
 	// C++ locale aware less-than comparison
 	static bool cmp_lt(const string& lhs, const string& rhs);
 
+	friend class Files;
+
     private:
 
-	bool createParentDirectories(const string& path) const;
+	SDir openParentDirectory(const string& base_path, bool create) const;
 
-	bool createAllTypes() const;
-	bool createDirectory(mode_t mode, uid_t owner, gid_t group) const;
-	bool createFile(mode_t mode, uid_t owner, gid_t group) const;
-	bool createLink(uid_t owner, gid_t group) const;
+	bool createAllTypes();
+	bool createDirectory(const SDir& system_dir, mode_t mode, uid_t owner, gid_t group) const;
+	bool createFile(const SDir& pre_dir, const SDir& system_dir, mode_t mode, uid_t owner,
+			gid_t group);
+	bool restoreContent(int src_fd, int dest_fd);
+	bool createLink(const SDir& pre_dir, const SDir& system_dir, uid_t owner, gid_t group) const;
 
 	bool deleteAllTypes() const;
+	bool deleteAllTypes(const SDir& system_dir) const;
 
-	bool modifyAllTypes() const;
+	bool modifyAllTypes();
 
 	const FilePaths* file_paths;
 
@@ -173,6 +187,9 @@ namespace snapper
 	unsigned int xaDeleted;
 	unsigned int xaReplaced;
 
+	unsigned long long bytesCloned;
+	unsigned long long bytesCopied;
+
     };
 
 
@@ -207,12 +224,37 @@ namespace snapper
 	iterator findAbsolutePath(const string& name);
 	const_iterator findAbsolutePath(const string& name) const;
 
+	/**
+	 * Computes the status of all files for cmp at once. Much faster
+	 * than querying the status of each file since directories are only
+	 * opened once. The files are split into ranges handled by
+	 * num_threads threads (0 for one per CPU).
+	 */
+	void computeStatuses(Cmp cmp, unsigned int num_threads = 1);
+
 	UndoStatistic getUndoStatistic() const;
 
 	vector<UndoStep> getUndoSteps() const;
 
 	bool doUndoStep(const UndoStep& undo_step);
 
+	/**
+	 * Callback for doUndoSteps(). Called once for every undo step after
+	 * it was performed together with the number of performed steps and
+	 * the total number of steps. Calls are never concurrent.
+	 */
+	typedef std::function<void(const UndoStep& undo_step, bool ok, size_t done,
+				   size_t total)> undo_cb_t;
+
+	/**
+	 * Performs the undo steps using num_threads threads (0 for one per
+	 * CPU). Steps for unrelated files run in parallel. For files within
+	 * each other directories are created before and deleted after their
+	 * entries. Returns false if any step failed.
+	 */
+	bool doUndoSteps(const vector<UndoStep>& undo_steps, undo_cb_t cb,
+			 unsigned int num_threads = 0);
+
         XAUndoStatistic getXAUndoStatistic() const;
 
     protected:
@@ -28,6 +28,7 @@
 #include <sys/stat.h>
 #include <sys/mount.h>
 #include <sys/xattr.h>
+#include <sys/syscall.h>
 #include <fcntl.h>
 #include <stddef.h>
 #include <dirent.h>
@@ -39,6 +40,7 @@
 #include <selinux/selinux.h>
 #endif
 #include <algorithm>
+#include <atomic>
 
 #include "snapper/FileUtils.h"
 #include "snapper/AppUtil.h"
@@ -57,6 +59,29 @@ namespace snapper
     boost::mutex SDir::cwd_mutex;
 
 
+#if defined(SYS_getxattrat) && defined(SYS_listxattrat)
+
+    // struct xattr_args from linux/xattr.h
+    struct XattrArgs
+    {
+	uint64_t value;
+	uint32_t size;
+	uint32_t flags;
+    };
+
+    // Set once the kernel reports that the *xattrat syscalls are missing.
+    static std::atomic<bool> xattrat_missing(false);
+
+#endif
+
+
+    static string
+    proc_fd_path(int fd)
+    {
+	return "/proc/self/fd/" + to_string(fd);
+    }
+
+
     SDir::SDir(const string& base_path)
 	: base_path(base_path), path()
     {
@@ -336,6 +361,16 @@ namespace snapper
     }
 
 
+    int
+    SDir::symlink(const string& oldpath, const string& name) const
+    {
+	assert(name.find('/') == string::npos);
+	assert(name != "..");
+
+	return ::symlinkat(oldpath.c_str(), dirfd, name.c_str());
+    }
+
+
     int
     SDir::unlink(const string& name, int flags) const
     {
@@ -458,23 +493,61 @@ namespace snapper
 	}
 	else if (errno == ELOOP || errno == ENXIO || errno == EWOULDBLOCK)
 	{
-	    boost::lock_guard<boost::mutex> lock(cwd_mutex);
+	    return listxattr_nofollow(path, list, size);
+	}
+	else
+	{
+	    return -1;
+	}
+    }
 
-	    int r1 = fchdir(dirfd);
-	    if (r1 != 0)
-	    {
-		y2err("fchdir failed errno:" << errno << " (" << stringerror(errno) << ")");
-		return -1;
-	    }
 
-	    ssize_t r2 = ::llistxattr(path.c_str(), list, size);
-	    chdir("/");
-	    return r2;
+    ssize_t
+    SDir::listxattr_nofollow(const string& path, char* list, size_t size) const
+    {
+#if defined(SYS_listxattrat) && defined(SYS_getxattrat)
+	if (!xattrat_missing.load(memory_order_relaxed))
+	{
+	    ssize_t r1 = syscall(SYS_listxattrat, dirfd, path.c_str(), AT_SYMLINK_NOFOLLOW, list,
+				 size);
+	    if (r1 >= 0 || errno != ENOSYS)
+		return r1;
+
+	    xattrat_missing.store(true, memory_order_relaxed);
 	}
-	else
+#endif
+
+	int fd = ::openat(dirfd, path.c_str(), O_PATH | O_NOFOLLOW | O_CLOEXEC);
+	if (fd < 0)
+	    return -1;
+
+	// The /proc entry of an O_PATH fd refers to the file itself, even
+	// for a symlink.
+
+	ssize_t r1 = ::listxattr(proc_fd_path(fd).c_str(), list, size);
+	int errno_saved = errno;
+	::close(fd);
+
+	if (r1 >= 0 || errno_saved != ENOENT)
+	{
+	    errno = errno_saved;
+	    return r1;
+	}
+
+	// /proc is not available, e.g. in a chroot
+
+	boost::lock_guard<boost::mutex> lock(cwd_mutex);
+
+	int r2 = fchdir(dirfd);
+	if (r2 != 0)
 	{
+	    y2err("fchdir failed errno:" << errno << " (" << stringerror(errno) << ")");
 	    return -1;
 	}
+
+	ssize_t r3 = ::llistxattr(path.c_str(), list, size);
+	chdir("/");
+	return r3;
     }
 
 
@@ -494,23 +567,59 @@ namespace snapper
 	}
 	else if (errno == ELOOP || errno == ENXIO || errno == EWOULDBLOCK)
 	{
-	    boost::lock_guard<boost::mutex> lock(cwd_mutex);
+	    return getxattr_nofollow(path, name, value, size);
+	}
+	else
+	{
+	    return -1;
+	}
+    }
 
-	    int r1 = fchdir(dirfd);
-	    if (r1 != 0)
-	    {
-		y2err("fchdir failed errno:" << errno << " (" << stringerror(errno) << ")");
-		return -1;
-	    }
 
-	    ssize_t r2 = ::lgetxattr(path.c_str(), name, value, size);
-	    chdir("/");
-	    return r2;
+    ssize_t
+    SDir::getxattr_nofollow(const string& path, const char* name, void* value, size_t size) const
+    {
+#if defined(SYS_listxattrat) && defined(SYS_getxattrat)
+	if (!xattrat_missing.load(memory_order_relaxed))
+	{
+	    XattrArgs args = { (uint64_t)(uintptr_t) value, (uint32_t) size, 0 };
+	    ssize_t r1 = syscall(SYS_getxattrat, dirfd, path.c_str(), AT_SYMLINK_NOFOLLOW, name,
+				 &args, sizeof(args));
+	    if (r1 >= 0 || errno != ENOSYS)
+		return r1;
+
+	    xattrat_missing.store(true, memory_order_relaxed);
 	}
-	else
+#endif
+
+	int fd = ::openat(dirfd, path.c_str(), O_PATH | O_NOFOLLOW | O_CLOEXEC);
+	if (fd < 0)
+	    return -1;
+
+	ssize_t r1 = ::getxattr(proc_fd_path(fd).c_str(), name, value, size);
+	int errno_saved = errno;
+	::close(fd);
+
+	if (r1 >= 0 || errno_saved != ENOENT)
+	{
+	    errno = errno_saved;
+	    return r1;
+	}
+
+	// /proc is not available, e.g. in a chroot
+
+	boost::lock_guard<boost::mutex> lock(cwd_mutex);
+
+	int r2 = fchdir(dirfd);
+	if (r2 != 0)
 	{
+	    y2err("fchdir failed errno:" << errno << " (" << stringerror(errno) << ")");
 	    return -1;
 	}
+
+	ssize_t r3 = ::lgetxattr(path.c_str(), name, value, size);
+	chdir("/");
+	return r3;
     }
 
 
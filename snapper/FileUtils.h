@@ -24,6 +24,7 @@
 #define SNAPPER_FILE_UTILS_H
 
 
+#include <unistd.h>
 #include <string>
 #include <vector>
 #include <functional>
@@ -47,8 +48,10 @@ namespace snapper
     /*
      * The member functions of SDir and SFile are secure (avoid race
      * conditions, see openat(2)) by using either openat and alike functions
-     * or by modifying the current working directory (e.g. mount, umount,
-     * listxattr and getxattr).
+     * or by modifying the current working directory (e.g. mount and
+     * umount). listxattr and getxattr use listxattrat and getxattrat or
+     * an O_PATH file descriptor for symlinks and special files and only
+     * modify the current working directory if /proc is not available.
      */
 
     class SDir
@@ -85,6 +88,7 @@ namespace snapper
 	int open(const string& name, int flags, mode_t mode) const;
 	ssize_t readlink(const string& name, string& buf) const;
 	int mkdir(const string& name, mode_t mode) const;
+	int symlink(const string& oldpath, const string& name) const;
 	int unlink(const string& name, int flags) const;
 	int chmod(const string& name, mode_t mode, int flags) const;
 	int chown(const string& name, uid_t owner, gid_t group, int flags) const;
@@ -112,6 +116,9 @@ namespace snapper
 	XaAttrsStatus xastatus;
 	void setXaStatus();
 
+	ssize_t listxattr_nofollow(const string& path, char* list, size_t size) const;
+	ssize_t getxattr_nofollow(const string& path, const char* name, void* value, size_t size) const;
+
 	const string base_path;
 	const string path;
 
@@ -182,6 +189,39 @@ namespace snapper
 
     };
 
+
+    // Closes the file descriptor when going out of scope.
+    struct FdCloser
+    {
+	FdCloser(int fd)
+	    : fd(fd)
+	{
+	}
+
+	~FdCloser()
+	{
+	    if (fd > -1)
+		::close(fd);
+	}
+
+	void reset()
+	{
+	    fd = -1;
+	}
+
+	int close()
+	{
+	    int r = ::close(fd);
+	    fd = -1;
+	    return r;
+	}
+
+    private:
+
+	int fd;
+
+    };
+
 }
 
 
@@ -45,6 +45,9 @@
 #ifdef ENABLE_LVM
 #include "snapper/Lvm.h"
 #endif
+#ifdef ENABLE_REFLINK
+#include "snapper/Reflink.h"
+#endif
 #include "snapper/Snapper.h"
 #include "snapper/SnapperTmpl.h"
 #include "snapper/SnapperDefines.h"
@@ -106,6 +109,9 @@ namespace snapper
 #endif
 #ifdef ENABLE_LVM
 		&Lvm::create,
+#endif
+#ifdef ENABLE_REFLINK
+		&Reflink::create,
 #endif
 		NULL
 	};
@@ -156,6 +162,21 @@ namespace snapper
     }
 
 
+    std::set<unsigned int>
+    Filesystem::checkSnapshots(const vector<unsigned int>& nums) const
+    {
+	std::set<unsigned int> ret;
+
+	for (unsigned int num : nums)
+	{
+	    if (checkSnapshot(num))
+		ret.insert(num);
+	}
+
+	return ret;
+    }
+
+
     void
     Filesystem::cmpDirs(const SDir& dir1, const SDir& dir2, cmpdirs_cb_t cb) const
     {
@@ -27,6 +27,7 @@
 
 #include <string>
 #include <vector>
+#include <set>
 #include <utility>
 
 #include "snapper/FileUtils.h"
@@ -81,6 +82,12 @@ namespace snapper
 
 	virtual bool checkSnapshot(unsigned int num) const = 0;
 
+	/**
+	 * Like checkSnapshot() but for several snapshots at once. Returns
+	 * the numbers of the snapshots that passed the check.
+	 */
+	virtual std::set<unsigned int> checkSnapshots(const vector<unsigned int>& nums) const;
+
 	virtual void cmpDirs(const SDir& dir1, const SDir& dir2, cmpdirs_cb_t cb) const;
 
 	virtual bool isDefault(unsigned int num) const;
@@ -73,7 +73,7 @@ namespace snapper
 	if (subvolume == "/" && filesystem->fstype() == "btrfs" &&
 	    access("/usr/lib/snapper/plugins/grub", X_OK) == 0)
 	{
-	    SystemCmd cmd(string("/usr/lib/snapper/plugins/grub ") + option);
+	    SystemCmd cmd(SystemCmd::Args({ "/usr/lib/snapper/plugins/grub", option }));
 	}
 #endif
     }
@@ -88,7 +88,7 @@ namespace snapper
 	// Fate#319108
 	if (access(ROLLBACK_SCRIPT, X_OK) == 0)
 	{
-	    SystemCmd cmd(string(ROLLBACK_SCRIPT) + " " + old_root + " " + new_root);
+	    SystemCmd cmd(SystemCmd::Args({ ROLLBACK_SCRIPT, old_root, new_root }));
 	}
 #endif
     }
@@ -33,10 +33,27 @@ namespace snapper
     const string* component = new string("libsnapper");
 
 
+    // Default log query of the default logger: everything but debug.
+    std::atomic<unsigned int> log_level_mask((1U << MILESTONE) | (1U << WARNING) | (1U << ERROR));
+
+
+    void
+    updateLogLevelMask()
+    {
+	unsigned int mask = 0;
+
+	for (LogLevel level : { DEBUG, MILESTONE, WARNING, ERROR })
+	    if (callLogQuery(level, *component))
+		mask |= 1U << level;
+
+	log_level_mask.store(mask, std::memory_order_relaxed);
+    }
+
+
     bool
     testLogLevel(LogLevel level)
     {
-	return callLogQuery(level, *component);
+	return isLogLevelEnabled(level);
     }
 
 
@@ -67,4 +84,45 @@ namespace snapper
 	stream = nullptr;
     }
 
+
+    void
+    formatLogFields(string& text, const LogField* fields, size_t num_fields)
+    {
+	for (const LogField* field = fields; field != fields + num_fields; ++field)
+	{
+	    text += ' ';
+	    text += field->key;
+	    text += '=';
+
+	    switch (field->type)
+	    {
+		case LogField::STRING:
+		    text += '\'';
+		    text += field->s;
+		    text += '\'';
+		    break;
+
+		case LogField::SIGNED:
+		    text += std::to_string(field->i);
+		    break;
+
+		case LogField::UNSIGNED:
+		    text += std::to_string(field->u);
+		    break;
+
+		case LogField::BOOLEAN:
+		    text += field->i ? "true" : "false";
+		    break;
+	    }
+	}
+    }
+
+
+    void
+    logFields(LogLevel level, const char* file, unsigned line, const char* func,
+	      const char* message, std::initializer_list<LogField> fields)
+    {
+	callLogDoFields(level, *component, file, line, func, message, fields);
+    }
+
 }
@@ -24,15 +24,44 @@
 #define SNAPPER_LOG_H
 
 #include <sstream>
+#include <atomic>
+#include <initializer_list>
 
 #include "Logger.h"
 
 
+/*
+ * Log statements below this level are removed at compile time, e.g.
+ * compile with -DSNAPPER_MIN_LOG_LEVEL=1 to remove all debug statements.
+ */
+#ifndef SNAPPER_MIN_LOG_LEVEL
+#define SNAPPER_MIN_LOG_LEVEL 0
+#endif
+
+
 namespace snapper
 {
     using std::string;
 
 
+    /*
+     * Bit mask of the enabled log levels caching the result of the log
+     * query function. It is recomputed by every call of setLogQuery() and
+     * initDefaultLogger(). There is only one component, libsnapper, so one
+     * mask is enough.
+     */
+    extern std::atomic<unsigned int> log_level_mask;
+
+    void updateLogLevelMask();
+
+    inline bool
+    isLogLevelEnabled(LogLevel level)
+    {
+	return level >= SNAPPER_MIN_LOG_LEVEL &&
+	    (log_level_mask.load(std::memory_order_relaxed) & (1U << level));
+    }
+
+    // Out-of-line version of isLogLevelEnabled() kept for existing callers.
     bool testLogLevel(LogLevel level);
 
     void prepareLogStream(std::ostringstream& stream);
@@ -49,7 +78,7 @@ namespace snapper
 
 #define y2log_op(level, file, line, func, op)				\
     do {								\
-	if (snapper::testLogLevel(level))				\
+	if (snapper::isLogLevelEnabled(level))				\
 	{								\
 	    std::ostringstream* __buf = snapper::logStreamOpen();	\
 	    *__buf << op;						\
@@ -57,6 +86,63 @@ namespace snapper
 	}								\
     } while (0)
 
+
+    /*
+     * A key and value for structured logging. The key must be a string
+     * literal. Numbers are only formatted when the line is written, with
+     * the asynchronous logger in the writer thread.
+     */
+    struct LogField
+    {
+	enum Type { STRING, SIGNED, UNSIGNED, BOOLEAN };
+
+	LogField() : key(""), type(STRING), i(0), u(0), s() {}
+
+	LogField(const char* key, const string& value) : key(key), type(STRING), i(0), u(0), s(value) {}
+	LogField(const char* key, const char* value) : key(key), type(STRING), i(0), u(0), s(value) {}
+
+	LogField(const char* key, int value) : key(key), type(SIGNED), i(value), u(0), s() {}
+	LogField(const char* key, long value) : key(key), type(SIGNED), i(value), u(0), s() {}
+	LogField(const char* key, long long value) : key(key), type(SIGNED), i(value), u(0), s() {}
+
+	LogField(const char* key, unsigned int value) : key(key), type(UNSIGNED), i(0), u(value), s() {}
+	LogField(const char* key, unsigned long value) : key(key), type(UNSIGNED), i(0), u(value), s() {}
+	LogField(const char* key, unsigned long long value) : key(key), type(UNSIGNED), i(0), u(value), s() {}
+
+	LogField(const char* key, bool value) : key(key), type(BOOLEAN), i(value), u(0), s() {}
+
+	const char* key;
+	Type type;
+	long long i;
+	unsigned long long u;
+	string s;
+    };
+
+    /*
+     * Appends the fields as " key=value" to text. String values are
+     * quoted.
+     */
+    void formatLogFields(string& text, const LogField* fields, size_t num_fields);
+
+    void logFields(LogLevel level, const char* file, unsigned line, const char* func,
+		   const char* message, std::initializer_list<LogField> fields);
+
+    void callLogDoFields(LogLevel level, const string& component, const char* file, int line,
+			 const char* func, const char* message, std::initializer_list<LogField> fields);
+
+    /*
+     * Structured logging, e.g. y2deb_kv("method call", { "member", member }, { "num", num }).
+     * Like with y2deb the arguments are not evaluated if the level is disabled.
+     */
+#define y2deb_kv(message, ...) y2log_kv(snapper::DEBUG, __FILE__, __LINE__, __FUNCTION__, message, __VA_ARGS__)
+#define y2mil_kv(message, ...) y2log_kv(snapper::MILESTONE, __FILE__, __LINE__, __FUNCTION__, message, __VA_ARGS__)
+
+#define y2log_kv(level, file, line, func, message, ...)			\
+    do {								\
+	if (snapper::isLogLevelEnabled(level))				\
+	    snapper::logFields(level, file, line, func, message, { __VA_ARGS__ }); \
+    } while (0)
+
 }
 
 #endif
@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2019 SUSE LLC
+ *
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of version 2 of the GNU General Public License as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, contact Novell, Inc.
+ *
+ * To contact Novell about this file by physical or electronic mail, you may
+ * find current contact information at www.novell.com.
+ */
+
+
+#include "snapper/LogQueue.h"
+
+
+namespace snapper
+{
+
+    static size_t
+    round_up_to_power_of_two(size_t n)
+    {
+	size_t r = 2;
+	while (r < n)
+	    r <<= 1;
+	return r;
+    }
+
+
+    LogQueue::LogQueue(size_t capacity)
+	: mask(round_up_to_power_of_two(capacity) - 1), slots(new Slot[mask + 1]), enqueue_pos(0),
+	  dequeue_pos(0), dropped(0)
+    {
+	for (size_t i = 0; i <= mask; ++i)
+	    slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+
+    /*
+     * The sequence of a slot tells whether it is free for the producer at
+     * position pos (sequence == pos) or filled for the consumer at
+     * position pos (sequence == pos + 1), see Dmitry Vyukov's bounded MPMC
+     * queue.
+     */
+    bool
+    LogQueue::try_push(LogLevel level, time_t time, const char* file, int line, const char* func,
+		       const string& text, const LogField* fields, size_t num_fields)
+    {
+	size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+
+	Slot* slot;
+
+	while (true)
+	{
+	    slot = &slots[pos & mask];
+
+	    size_t sequence = slot->sequence.load(std::memory_order_acquire);
+	    ptrdiff_t diff = (ptrdiff_t) sequence - (ptrdiff_t) pos;
+
+	    if (diff == 0)
+	    {
+		if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+		    break;
+	    }
+	    else if (diff < 0)
+	    {
+		return false;
+	    }
+	    else
+	    {
+		pos = enqueue_pos.load(std::memory_order_relaxed);
+	    }
+	}
+
+	LogEntry& entry = slot->entry;
+	entry.level = level;
+	entry.time = time;
+	entry.file.assign(file);
+	entry.line = line;
+	entry.func.assign(func);
+	entry.text.assign(text);
+	entry.fields.assign(fields, fields + num_fields);
+
+	slot->sequence.store(pos + 1, std::memory_order_release);
+
+	return true;
+    }
+
+
+    bool
+    LogQueue::push(LogLevel level, time_t time, const char* file, int line, const char* func,
+		   const string& text, const LogField* fields, size_t num_fields)
+    {
+	if (try_push(level, time, file, line, func, text, fields, num_fields))
+	    return true;
+
+	dropped.fetch_add(1, std::memory_order_relaxed);
+
+	return false;
+    }
+
+
+    bool
+    LogQueue::pop(LogEntry& entry)
+    {
+	Slot& slot = slots[dequeue_pos & mask];
+
+	if (slot.sequence.load(std::memory_order_acquire) != dequeue_pos + 1)
+	    return false;
+
+	entry.level = slot.entry.level;
+	entry.time = slot.entry.time;
+	entry.file.swap(slot.entry.file);
+	entry.line = slot.entry.line;
+	entry.func.swap(slot.entry.func);
+	entry.text.swap(slot.entry.text);
+	entry.fields.swap(slot.entry.fields);
+
+	slot.sequence.store(dequeue_pos + mask + 1, std::memory_order_release);
+
+	++dequeue_pos;
+
+	return true;
+    }
+
+
+    bool
+    LogQueue::empty() const
+    {
+	const Slot& slot = slots[dequeue_pos & mask];
+
+	return slot.sequence.load(std::memory_order_acquire) != dequeue_pos + 1;
+    }
+
+}
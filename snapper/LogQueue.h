@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2019 SUSE LLC
+ *
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of version 2 of the GNU General Public License as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, contact Novell, Inc.
+ *
+ * To contact Novell about this file by physical or electronic mail, you may
+ * find current contact information at www.novell.com.
+ */
+
+
+#ifndef SNAPPER_LOG_QUEUE_H
+#define SNAPPER_LOG_QUEUE_H
+
+
+#include <time.h>
+#include <stddef.h>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <boost/noncopyable.hpp>
+
+#include "snapper/Log.h"
+
+
+namespace snapper
+{
+    using std::string;
+
+
+    struct LogEntry
+    {
+	LogEntry() : level(DEBUG), time(0), line(0) {}
+
+	LogLevel level;
+	time_t time;
+	string file;
+	int line;
+	string func;
+	string text;
+	std::vector<LogField> fields;
+    };
+
+
+    /*
+     * Bounded lock-free queue for log entries with several producers and
+     * a single consumer. If the queue is full push() drops the entry and
+     * counts it while try_push() leaves handling the entry to the caller.
+     * The strings of the slots are reused so after a while
+     * pushing does not allocate memory.
+     */
+    class LogQueue : private boost::noncopyable
+    {
+    public:
+
+	// The capacity is rounded up to a power of two.
+	explicit LogQueue(size_t capacity);
+
+	bool push(LogLevel level, time_t time, const char* file, int line, const char* func,
+		  const string& text, const LogField* fields = nullptr, size_t num_fields = 0);
+
+	bool try_push(LogLevel level, time_t time, const char* file, int line, const char* func,
+		      const string& text, const LogField* fields = nullptr, size_t num_fields = 0);
+
+	// Must only be called by the consumer.
+	bool pop(LogEntry& entry);
+	bool empty() const;
+
+	// Returns the number of dropped entries since the last call.
+	unsigned long take_dropped() { return dropped.exchange(0); }
+
+    private:
+
+	struct Slot
+	{
+	    std::atomic<size_t> sequence;
+	    LogEntry entry;
+	};
+
+	const size_t mask;
+
+	std::unique_ptr<Slot[]> slots;
+
+	std::atomic<size_t> enqueue_pos;
+	size_t dequeue_pos;
+
+	std::atomic<unsigned long> dropped;
+
+    };
+
+}
+
+
+#endif
@@ -22,15 +22,21 @@
 
 
 #include <pwd.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <unistd.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 #include <libxml/tree.h>
 #include <string>
+#include <atomic>
 #include <boost/thread.hpp>
 
 #include "snapper/Log.h"
 #include "snapper/AppUtil.h"
+#include "snapper/LogQueue.h"
 
 
 #define LOG_FILENAME "/var/log/snapper.log"
@@ -46,10 +52,20 @@ namespace snapper
 
 	struct LoggerData
 	{
-	    LoggerData() : filename(LOG_FILENAME), mutex() {}
+	    LoggerData() : filename(LOG_FILENAME), mutex(), queue(nullptr), writer(nullptr),
+			   stop(false), sleeping(false) {}
 
 	    string filename;
 	    boost::mutex mutex;
+
+	    // Only used by the asynchronous logger.
+
+	    std::atomic<LogQueue*> queue;
+	    boost::thread* writer;
+	    boost::mutex writer_mutex;
+	    boost::condition_variable writer_condition;
+	    std::atomic<bool> stop;
+	    std::atomic<bool> sleeping;
 	};
 
 
@@ -76,6 +92,74 @@ namespace snapper
     setLogQuery(LogQuery new_log_query)
     {
 	log_query = new_log_query;
+
+	updateLogLevelMask();
+    }
+
+
+    static const char* ln[4] = { "DEB", "MIL", "WAR", "ERR" };
+
+
+    static void
+    format_lines(string& out, const string& date, LogLevel level, const char* file, int line,
+		 const char* func, const string& text)
+    {
+	string prefix = date + " " + ln[level] + " libsnapper(" + std::to_string(getpid()) + ") " +
+	    file + "(" + func + "):" + std::to_string(line) + " - ";
+
+	string::size_type pos1 = 0;
+
+	while (true)
+	{
+	    string::size_type pos2 = text.find('\n', pos1);
+
+	    if (pos2 != string::npos || pos1 != text.length())
+	    {
+		out += prefix;
+		out.append(text, pos1, pos2 == string::npos ? string::npos : pos2 - pos1);
+		out += '\n';
+	    }
+
+	    if (pos2 == string::npos)
+		break;
+
+	    pos1 = pos2 + 1;
+	}
+    }
+
+
+    static void
+    notify_writer(LogLevel level)
+    {
+	if (level == ERROR || logger_data->sleeping.load(std::memory_order_relaxed))
+	    logger_data->writer_condition.notify_one();
+    }
+
+
+    /*
+     * Queues a log entry for the writer thread. Returns false if the queue
+     * is full and the entry is a warning or an error. Those are never
+     * dropped but must be written synchronously by the caller, so they can
+     * appear before older lines still in the queue.
+     */
+    static bool
+    queue_entry(LogQueue* queue, LogLevel level, const char* file, int line, const char* func,
+		const string& text, const LogField* fields = nullptr, size_t num_fields = 0)
+    {
+	if (level >= WARNING)
+	{
+	    if (!queue->try_push(level, time(0), file, line, func, text, fields, num_fields))
+		return false;
+	}
+	else
+	{
+	    if (!queue->push(level, time(0), file, line, func, text, fields, num_fields))
+		return true;
+	}
+
+	notify_writer(level);
+
+	return true;
     }
 
 
@@ -83,35 +167,160 @@ namespace snapper
     simple_log_do(LogLevel level, const string& component, const char* file, int line,
 		  const char* func, const string& text)
     {
-	static const char* ln[4] = { "DEB", "MIL", "WAR", "ERR" };
+	LogQueue* queue = logger_data->queue.load();
+	if (queue && queue_entry(queue, level, file, line, func, text))
+	    return;
 
-	string prefix = sformat("%s %s libsnapper(%d) %s(%s):%d", datetime(time(0), false, true).c_str(),
-				ln[level], getpid(), file, func, line);
+	string lines;
+	format_lines(lines, datetime(time(0), false, true), level, file, line, func, text);
 
 	boost::lock_guard<boost::mutex> lock(logger_data->mutex);
 
 	FILE* f = fopen(logger_data->filename.c_str(), "ae");
 	if (f)
 	{
-	    string tmp = text;
+	    fputs(lines.c_str(), f);
+	    fclose(f);
+	}
+    }
+
+
+    /*
+     * The writer thread of the asynchronous logger keeps the log file open
+     * and writes the queued lines in batches. Once a second it checks
+     * whether the log file was rotated, i.e. the file name points to
+     * another inode, and reopens it.
+     */
+    class LogWriter
+    {
+    public:
+
+	LogWriter() : fd(-1), last_check() {}
+	~LogWriter() { if (fd >= 0) close(fd); }
+
+	void operator()();
+
+    private:
+
+	void check_reopen();
+	void write_buffer();
+
+	int fd;
+	boost::posix_time::ptime last_check;
+
+	string buffer;
 
-	    string::size_type pos1 = 0;
+    };
 
-	    while (true)
+
+    void
+    LogWriter::operator()()
+    {
+	LoggerData* data = logger_data;
+	LogQueue* queue = data->queue;
+
+	LogEntry entry;
+
+	// Formatting the date is expensive so it is cached.
+
+	time_t date_time = 0;
+	string date = datetime(date_time, false, true);
+
+	while (true)
+	{
+	    bool stop = data->stop.load();
+
+	    while (queue->pop(entry))
 	    {
-		string::size_type pos2 = tmp.find('\n', pos1);
+		if (!entry.fields.empty())
+		    formatLogFields(entry.text, entry.fields.data(), entry.fields.size());
 
-		if (pos2 != string::npos || pos1 != tmp.length())
-		    fprintf(f, "%s - %s\n", prefix.c_str(), tmp.substr(pos1, pos2 - pos1).c_str());
+		if (entry.time != date_time)
+		{
+		    date_time = entry.time;
+		    date = datetime(date_time, false, true);
+		}
 
-		if (pos2 == string::npos)
-		    break;
+		format_lines(buffer, date, entry.level, entry.file.c_str(), entry.line,
+			     entry.func.c_str(), entry.text);
 
-		pos1 = pos2 + 1;
+		if (buffer.size() > 64 * 1024)
+		    write_buffer();
 	    }
 
-	    fclose(f);
+	    unsigned long dropped = queue->take_dropped();
+	    if (dropped > 0)
+		format_lines(buffer, datetime(time(0), false, true), WARNING, __FILE__, __LINE__,
+			     __FUNCTION__, sformat("log queue full, dropped %lu lines", dropped));
+
+	    write_buffer();
+
+	    if (stop)
+		break;
+
+	    boost::unique_lock<boost::mutex> lock(data->writer_mutex);
+
+	    data->sleeping = true;
+
+	    if (queue->empty() && !data->stop.load())
+		data->writer_condition.timed_wait(lock, boost::posix_time::milliseconds(100));
+
+	    data->sleeping = false;
+	}
+    }
+
+
+    void
+    LogWriter::check_reopen()
+    {
+	boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+
+	if (fd >= 0 && now - last_check < boost::posix_time::seconds(1))
+	    return;
+
+	last_check = now;
+
+	if (fd >= 0)
+	{
+	    struct stat buf1, buf2;
+	    if (stat(logger_data->filename.c_str(), &buf1) == 0 && fstat(fd, &buf2) == 0 &&
+		buf1.st_dev == buf2.st_dev && buf1.st_ino == buf2.st_ino)
+		return;
+
+	    close(fd);
+	}
+
+	fd = open(logger_data->filename.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0666);
+    }
+
+
+    void
+    LogWriter::write_buffer()
+    {
+	if (buffer.empty())
+	    return;
+
+	check_reopen();
+
+	if (fd >= 0)
+	{
+	    const char* p = buffer.data();
+	    size_t n = buffer.size();
+
+	    while (n > 0)
+	    {
+		ssize_t r = write(fd, p, n);
+		if (r < 0 && errno == EINTR)
+		    continue;
+		if (r <= 0)
+		    break;
+
+		p += r;
+		n -= r;
+	    }
 	}
+
+	buffer.clear();
     }
 
 
@@ -133,6 +342,24 @@ namespace snapper
     }
 
 
+    void
+    callLogDoFields(LogLevel level, const string& component, const char* file, int line,
+		    const char* func, const char* message, std::initializer_list<LogField> fields)
+    {
+	// With the asynchronous logger the fields are formatted by the writer.
+
+	LogQueue* queue = logger_data->queue.load();
+	if (!log_do && queue && queue_entry(queue, level, file, line, func, message, fields.begin(),
+					    fields.size()))
+	    return;
+
+	string text = message;
+	formatLogFields(text, fields.begin(), fields.size());
+
+	callLogDo(level, component, file, line, func, text);
+    }
+
+
     bool
     callLogQuery(LogLevel level, const string& component)
     {
@@ -151,6 +378,15 @@ namespace snapper
     xmlGenericErrorFunc xml_error_func_ptr = &xml_error_func;
 
 
+    void
+    initDefaultLogger(const string& filename)
+    {
+	initDefaultLogger();
+
+	logger_data->filename = filename;
+    }
+
+
     void
     initDefaultLogger()
     {
@@ -175,7 +411,54 @@ namespace snapper
 	log_do = NULL;
 	log_query = NULL;
 
+	updateLogLevelMask();
+
 	initGenericErrorDefaultFunc(&xml_error_func_ptr);
     }
 
+
+    void
+    startAsyncLogger(size_t capacity)
+    {
+	if (logger_data->queue)
+	    return;
+
+	logger_data->stop = false;
+	logger_data->queue = new LogQueue(capacity);
+	logger_data->writer = new boost::thread(LogWriter());
+
+	static bool registered = false;
+	if (!registered)
+	{
+	    atexit(stopAsyncLogger);
+	    registered = true;
+	}
+    }
+
+
+    void
+    stopAsyncLogger()
+    {
+	if (!logger_data->queue)
+	    return;
+
+	logger_data->stop = true;
+	logger_data->writer_condition.notify_one();
+	logger_data->writer->join();
+
+	delete logger_data->writer;
+	logger_data->writer = nullptr;
+
+	// Lines logged while stopping are written synchronously. The queue
+	// is intentionally not deleted since other threads may still use it.
+
+	LogQueue* queue = logger_data->queue;
+	logger_data->queue = nullptr;
+
+	LogEntry entry;
+	while (queue->pop(entry))
+	    simple_log_do(entry.level, "", entry.file.c_str(), entry.line, entry.func.c_str(),
+			  entry.text);
+    }
+
 }
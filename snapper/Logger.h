@@ -23,6 +23,7 @@
 #ifndef SNAPPER_LOGGER_H
 #define SNAPPER_LOGGER_H
 
+#include <stddef.h>
 #include <string>
 
 
@@ -43,6 +44,10 @@ namespace snapper
 
     void setLogDo(LogDo log_do);
 
+    /*
+     * The result of the log query function is cached. If it changes call
+     * setLogQuery() again to update the cache.
+     */
     void setLogQuery(LogQuery log_query);
 
     void callLogDo(LogLevel level, const string& component, const char* file, int line,
@@ -52,6 +57,27 @@ namespace snapper
 
     void initDefaultLogger();
 
+    /*
+     * Like initDefaultLogger() but logs to the given file.
+     */
+    void initDefaultLogger(const string& filename);
+
+    /*
+     * Let the default logger write the log file from a separate thread.
+     * Log lines are queued in a ring buffer with the given capacity. If
+     * the ring buffer is full lines are dropped and the number of dropped
+     * lines is logged. Warnings and errors are never dropped but written
+     * synchronously. Must be called after initDefaultLogger().
+     */
+    void startAsyncLogger(size_t capacity = 16384);
+
+    /*
+     * Write all queued log lines and stop the thread. Also registered with
+     * atexit() by startAsyncLogger(). Queued lines are lost if the
+     * program exits otherwise, e.g. by _exit() or a signal.
+     */
+    void stopAsyncLogger();
+
 }
 
 #endif
@@ -459,7 +459,7 @@ namespace snapper
     LvmCapabilities::LvmCapabilities()
 	: ignoreactivationskip(), time_support(false)
     {
-	SystemCmd cmd(string(LVMBIN " version"));
+	SystemCmd cmd(SystemCmd::Args({ LVMBIN, "version" }));
 
 	if (cmd.retcode() != 0 || cmd.stdout().empty())
 	{
@@ -485,7 +485,7 @@ namespace snapper
 
 		if (version >= lvm_version(2,2,99))
 		{
-		    ignoreactivationskip = " -K";
+		    ignoreactivationskip = "-K";
 		}
 
 		time_support = (version >= lvm_version(2,2,88));
@@ -68,7 +68,7 @@ namespace snapper
     private:
 	LvmCapabilities();
 
-	// empty or " -K" if lvm supports ignore activation skip flag
+	// empty or "-K" if lvm supports ignore activation skip flag
 	string ignoreactivationskip;
 	// true if lvm2 supports time info stored in metadata
 	bool time_support;
@@ -27,12 +27,83 @@
 #include "snapper/LvmCache.h"
 #include "snapper/Lvm.h"
 #include "snapper/SystemCmd.h"
+#include "snapper/LvmShell.h"
 
 
 namespace snapper
 {
     using std::make_pair;
 
+
+    /*
+     * Runs an LVM command preferably in the persistent lvm shell. If the
+     * shell is not available the command is run as separate process.
+     */
+    static bool
+    lvm_execute(const SystemCmd::Args& cmd_args)
+    {
+	vector<string> args = cmd_args.get_values();
+	args.front() = args.front().substr(args.front().rfind('/') + 1);
+
+	bool success;
+	vector<LvmShell::Row> rows;
+	if (LvmShell::get_lvm_shell()->run(args, "lv", success, rows))
+	    return success;
+
+	SystemCmd cmd(cmd_args);
+	return cmd.retcode() == 0;
+    }
+
+
+    /*
+     * Queries the given fields of the LVs selected by what (a VG or an
+     * LV). Every row holds the values in the order of fields.
+     */
+    static bool
+    lvm_report_lvs(const vector<string>& fields, const string& what, vector<vector<string>>& rows)
+    {
+	rows.clear();
+
+	const string joined_fields = boost::join(fields, ",");
+
+	bool success;
+	vector<LvmShell::Row> shell_rows;
+	if (LvmShell::get_lvm_shell()->run({ "lvs", "-o", joined_fields, what }, "lv", success,
+					   shell_rows))
+	{
+	    if (!success)
+		return false;
+
+	    for (const LvmShell::Row& shell_row : shell_rows)
+	    {
+		vector<string> row;
+		for (const string& field : fields)
+		{
+		    LvmShell::Row::const_iterator it = shell_row.find(field);
+		    row.push_back(it != shell_row.end() ? it->second : "");
+		}
+		rows.push_back(row);
+	    }
+
+	    return true;
+	}
+
+	SystemCmd cmd(SystemCmd::Args({ LVSBIN, "--noheadings", "-o", joined_fields, what }));
+	if (cmd.retcode() != 0)
+	    return false;
+
+	for (const string& line : cmd.stdout())
+	{
+	    vector<string> row;
+	    const string tmp = boost::trim_copy(line);
+	    boost::split(row, tmp, boost::is_any_of(" \t\n"), boost::token_compress_on);
+	    rows.push_back(row);
+	}
+
+	return true;
+    }
+
+
     bool
     LvAttrs::extract_active(const string& raw)
     {
@@ -47,6 +118,34 @@ namespace snapper
     }
 
 
+    /*
+     * Queries lv_name, lv_attr and segtype of all LVs of a VG.
+     */
+    static bool
+    lvm_report_vg(const string& vg_name, vg_content_raw& content)
+    {
+	vector<vector<string>> rows;
+	if (!lvm_report_lvs({ "lv_name", "lv_attr", "segtype" }, vg_name, rows))
+	    return false;
+
+	content.clear();
+
+	for (const vector<string>& row : rows)
+	{
+	    if (row.size() < 1)
+		return false;
+
+	    content.insert(make_pair(row.front(), vector<string>(row.begin() + 1, row.end())));
+	}
+
+	return true;
+    }
+
+
+    // Time during which a refresh of a VG is considered current.
+    static const std::chrono::milliseconds refresh_coalesce_window(500);
+
+
     LvAttrs::LvAttrs(bool active, bool thin)
 	: active(active), thin(thin)
     {
@@ -86,9 +185,12 @@ namespace snapper
 	    {
 		boost::upgrade_to_unique_lock<boost::shared_mutex> unique_lock(upg_lock);
 
-		SystemCmd cmd(LVCHANGEBIN + caps->get_ignoreactivationskip() + " -ay " +
-			      quote(vg->get_vg_name() + "/" + lv_name));
-		if (cmd.retcode() != 0)
+		SystemCmd::Args cmd_args = { LVCHANGEBIN };
+		if (!caps->get_ignoreactivationskip().empty())
+		    cmd_args << caps->get_ignoreactivationskip();
+		cmd_args << "-ay" << vg->get_vg_name() + "/" + lv_name;
+
+		if (!lvm_execute(cmd_args))
 		{
 		    y2err("lvm cache: " << vg->get_vg_name() << "/" << lv_name << " activation failed!");
 		    throw LvmCacheException();
@@ -122,8 +224,7 @@ namespace snapper
 	    {
 		boost::upgrade_to_unique_lock<boost::shared_mutex> unique_lock(upg_lock);
 
-		SystemCmd cmd(LVCHANGEBIN " -an " + quote(vg->get_vg_name() + "/" + lv_name));
-		if (cmd.retcode() != 0)
+		if (!lvm_execute(SystemCmd::Args({ LVCHANGEBIN, "-an", vg->get_vg_name() + "/" + lv_name })))
 		{
 		    y2err("lvm cache: " << vg->get_vg_name() << "/" << lv_name << " deactivation failed!");
 		    throw LvmCacheException();
@@ -138,25 +239,10 @@ namespace snapper
 
 
     void
-    LogicalVolume::update()
+    LogicalVolume::update(const LvAttrs& new_attrs)
     {
 	boost::unique_lock<boost::shared_mutex> unique_lock(lv_mutex);
 
-	SystemCmd cmd(LVSBIN " --noheadings -o lv_attr,segtype " + quote(vg->get_vg_name() + "/" + lv_name));
-	if (cmd.retcode() != 0 || cmd.stdout().empty())
-	{
-	    y2err("lvm cache: failed to get info about " << vg->get_vg_name() << "/" << lv_name);
-	    throw LvmCacheException();
-	}
-
-	vector<string> args;
-	const string tmp = boost::trim_copy(cmd.stdout().front());
-	boost::split(args, tmp, boost::is_any_of(" \t\n"), boost::token_compress_on);
-	if (args.size() < 1)
-	    throw LvmCacheException();
-
-	LvAttrs new_attrs(args);
-
 	attrs = new_attrs;
     }
 
@@ -178,10 +264,10 @@ namespace snapper
 
 
     VolumeGroup::VolumeGroup(vg_content_raw& input, const string& vg_name, const string& add_lv_name)
-	: vg_name(vg_name)
+	: vg_name(vg_name), last_refresh(std::chrono::steady_clock::now())
     {
 	for (vg_content_raw::const_iterator cit = input.begin(); cit != input.end(); cit++)
-	    if (cit->first == add_lv_name || cit->first.find("-snapshot") != string::npos)
+	    if (is_included(cit->first, add_lv_name))
 		lv_info_map.insert(make_pair(cit->first, new LogicalVolume(this, cit->first, LvAttrs(cit->second))));
     }
 
@@ -258,47 +344,101 @@ namespace snapper
 
 	boost::upgrade_to_unique_lock<boost::shared_mutex> unique_lock(upg_lock);
 
-	SystemCmd cmd(LVCREATEBIN " --permission r --snapshot --name " +
-		      quote(lv_snapshot_name) + " " + quote(vg_name + "/" + lv_origin_name));
-
-	if (cmd.retcode() != 0)
+	if (!lvm_execute(SystemCmd::Args({ LVCREATEBIN, "--permission", "r", "--snapshot", "--name",
+					   lv_snapshot_name, vg_name + "/" + lv_origin_name })))
 	    throw LvmCacheException();
 
 	lv_info_map.insert(make_pair(lv_snapshot_name, new LogicalVolume(this, lv_snapshot_name)));
     }
 
 
+    bool
+    VolumeGroup::is_included(const string& lv_name, const string& include_lv_name)
+    {
+	return lv_name == include_lv_name || lv_name.find("-snapshot") != string::npos;
+    }
+
+
     void
     VolumeGroup::add_or_update(const string& lv_name)
     {
+	refresh(lv_name);
+
+	if (!contains(lv_name))
+	{
+	    y2err("lvm cache: failed to get info about " << vg_name << "/" << lv_name);
+	    throw LvmCacheException();
+	}
+    }
+
+
+    void
+    VolumeGroup::refresh(const string& include_lv_name)
+    {
+	const std::chrono::steady_clock::time_point requested = std::chrono::steady_clock::now();
+
+	boost::lock_guard<boost::mutex> refresh_lock(refresh_mutex);
+
+	// A refresh started shortly before or after the request is as good
+	// as a new one unless the requested LV is still missing.
+
+	if (last_refresh + refresh_coalesce_window >= requested && contains(include_lv_name))
+	{
+	    y2deb("lvm cache: " << vg_name << " is current");
+	    return;
+	}
+
+	const std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+
+	// Readers may continue while the report is running.
+
 	boost::upgrade_lock<boost::shared_mutex> upg_lock(vg_mutex);
 
-	iterator it = lv_info_map.find(lv_name);
-	if (it != lv_info_map.end())
+	vg_content_raw content;
+	if (!lvm_report_vg(vg_name, content))
 	{
-	    // FIXME: upgrade lock is too strict here. Should be shared_lock only
-	    it->second->update();
+	    y2err("lvm cache: failed to get info about VG " << vg_name);
+	    throw LvmCacheException();
 	}
-	else
+
+	// Prepare the new map without modifying the current one, readers
+	// still use it.
+
+	vg_content_t new_lv_info_map;
+
+	for (vg_content_raw::const_iterator cit = content.begin(); cit != content.end(); ++cit)
 	{
-	    SystemCmd cmd(LVSBIN " --noheadings -o lv_attr,segtype " + quote(vg_name + "/" + lv_name));
-	    if (cmd.retcode() != 0 || cmd.stdout().empty())
+	    const_iterator it = lv_info_map.find(cit->first);
+	    if (it != lv_info_map.end())
+		new_lv_info_map.insert(*it);
+	    else if (is_included(cit->first, include_lv_name))
+		new_lv_info_map.insert(make_pair(cit->first, new LogicalVolume(this, cit->first,
+									       LvAttrs(cit->second))));
+	}
+
+	{
+	    boost::upgrade_to_unique_lock<boost::shared_mutex> unique_lock(upg_lock);
+
+	    for (const_iterator cit = lv_info_map.begin(); cit != lv_info_map.end(); ++cit)
 	    {
-		y2err("lvm cache: failed to get info about " << vg_name << "/" << lv_name);
-		throw LvmCacheException();
+		vg_content_raw::const_iterator it = content.find(cit->first);
+		if (it != content.end())
+		{
+		    cit->second->update(LvAttrs(it->second));
+		}
+		else
+		{
+		    y2mil("lvm cache: " << vg_name << "/" << cit->first << " disappeared");
+		    delete cit->second;
+		}
 	    }
 
-	    vector<string> args;
-	    const string tmp = boost::trim_copy(cmd.stdout().front());
-	    boost::split(args, tmp, boost::is_any_of(" \t\n"), boost::token_compress_on);
-	    if (args.size() < 1)
-		throw LvmCacheException();
-
-	    LogicalVolume* p_lv = new LogicalVolume(this, lv_name, LvAttrs(args));
+	    lv_info_map.swap(new_lv_info_map);
 
-	    boost::upgrade_to_unique_lock<boost::shared_mutex> unique_lock(upg_lock);
-	    lv_info_map.insert(make_pair(lv_name, p_lv));
+	    y2deb("lvm cache: refreshed " << vg_name << " with " << lv_info_map.size() << " LVs");
 	}
+
+	last_refresh = started;
     }
 
 
@@ -317,8 +457,7 @@ namespace snapper
 	// wait for all invidual lv cache operations under shared vg lock to finish
 	boost::upgrade_to_unique_lock<boost::shared_mutex> unique_lock(upg_lock);
 
-	SystemCmd cmd(LVREMOVEBIN " --force " + quote(vg_name + "/" + lv_name));
-	if (cmd.retcode() != 0)
+	if (!lvm_execute(SystemCmd::Args({ LVREMOVEBIN, "--force", vg_name + "/" + lv_name })))
 	    throw LvmCacheException();
 
 	delete cit->second;
@@ -436,27 +575,13 @@ namespace snapper
     void
     LvmCache::add_vg(const string& vg_name, const string& include_lv_name)
     {
-	SystemCmd cmd(LVSBIN " --noheadings -o lv_name,lv_attr,segtype " + quote(vg_name));
-	if (cmd.retcode() != 0)
+	vg_content_raw new_content;
+	if (!lvm_report_vg(vg_name, new_content))
 	{
 	    y2err("lvm cache: failed to get info about VG " << vg_name);
 	    throw LvmCacheException();
 	}
 
-	vg_content_raw new_content;
-
-	for (vector<string>::const_iterator cit = cmd.stdout().begin(); cit != cmd.stdout().end(); cit++)
-	{
-	    vector<string> args;
-
-	    const string tmp = boost::trim_copy(*cit);
-	    boost::split(args, tmp, boost::is_any_of(" \t\n"), boost::token_compress_on);
-	    if (args.size() < 1)
-		throw LvmCacheException();
-
-	    new_content.insert(make_pair(args.front(), vector<string>(args.begin() + 1, args.end())));
-	}
-
 	VolumeGroup *p_vg = new VolumeGroup(new_content, vg_name, include_lv_name);
 
 	vgroups.insert(std::make_pair(vg_name, p_vg));
@@ -25,8 +25,10 @@
 #include <set>
 #include <string>
 #include <vector>
+#include <chrono>
 
 #include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
 #include <boost/thread/shared_mutex.hpp>
 
 
@@ -74,7 +76,7 @@ namespace snapper
 	void activate(); // upg -> excl. lock
 	void deactivate(); // upg -> excl. lock
 
-	void update(); // shared, unique_lock
+	void update(const LvAttrs& new_attrs); // unique_lock
 
 	bool thin(); // shared
 
@@ -123,11 +125,25 @@ namespace snapper
     private:
 	void debug(std::ostream& out) const;
 
+	/*
+	 * Updates all LVs of the VG with a single report. Requests arriving
+	 * shortly after the start of a refresh share its result.
+	 */
+	void refresh(const string& include_lv_name); // refresh mutex, upg lock -> excl
+
+	static bool is_included(const string& lv_name, const string& include_lv_name);
+
 	const string vg_name;
 
 	mutable boost::shared_mutex vg_mutex;
 
 	vg_content_t lv_info_map;
+
+	// serializes refreshes, protects last_refresh
+	boost::mutex refresh_mutex;
+
+	// start time of the last completed refresh
+	std::chrono::steady_clock::time_point last_refresh;
     };
 
 
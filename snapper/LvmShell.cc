@@ -0,0 +1,694 @@
+/*
+ * Copyright (c) 2019 SUSE LLC
+ *
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of version 2 of the GNU General Public License as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, contact Novell, Inc.
+ *
+ * To contact Novell about this file by physical or electronic mail, you may
+ * find current contact information at www.novell.com.
+ */
+
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <spawn.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <chrono>
+#include <boost/algorithm/string.hpp>
+
+#include "snapper/Log.h"
+#include "snapper/AppUtil.h"
+#include "snapper/LvmShell.h"
+
+
+extern char **environ;
+
+
+namespace snapper
+{
+    using namespace std;
+
+
+    static const char* prompt = "lvm> ";
+
+    static const char* report_options = " --reportformat json --config log/report_command_log=1\n";
+
+    // Commands like lvcreate may wait for locks, so be generous.
+    static const chrono::seconds command_timeout(300);
+
+
+    namespace
+    {
+
+	/*
+	 * Minimal JSON parser for the LVM reports. Numbers and literals are
+	 * kept as strings, LVM reports all values as strings anyway.
+	 */
+	struct JsonValue
+	{
+	    enum Type { STRING, ARRAY, OBJECT };
+
+	    JsonValue() : type(STRING) {}
+
+	    Type type;
+	    string str;
+	    vector<JsonValue> array;
+	    vector<pair<string, JsonValue>> object;
+
+	    const JsonValue* find(const string& key) const
+	    {
+		for (const pair<string, JsonValue>& member : object)
+		    if (member.first == key)
+			return &member.second;
+		return nullptr;
+	    }
+	};
+
+
+	class JsonParser
+	{
+	public:
+
+	    JsonParser(const string& text) : text(text), pos(0) {}
+
+	    bool parse(JsonValue& value)
+	    {
+		return parse_value(value, 0) && (skip_space(), pos == text.size());
+	    }
+
+	private:
+
+	    void skip_space()
+	    {
+		while (pos < text.size() && isspace((unsigned char) text[pos]))
+		    ++pos;
+	    }
+
+	    bool parse_string(string& str)
+	    {
+		if (text[pos] != '"')
+		    return false;
+
+		for (++pos; pos < text.size(); ++pos)
+		{
+		    char c = text[pos];
+
+		    if (c == '"')
+		    {
+			++pos;
+			return true;
+		    }
+
+		    if (c == '\\')
+		    {
+			if (++pos == text.size())
+			    return false;
+
+			switch (text[pos])
+			{
+			    case 'n': str += '\n'; break;
+			    case 't': str += '\t'; break;
+			    case 'r': str += '\r'; break;
+			    case 'b': str += '\b'; break;
+			    case 'f': str += '\f'; break;
+			    case 'u':
+				// Not used by LVM for names, keep it verbatim.
+				str += "\\u";
+				break;
+			    default: str += text[pos]; break;
+			}
+
+			continue;
+		    }
+
+		    str += c;
+		}
+
+		return false;
+	    }
+
+	    bool parse_value(JsonValue& value, int depth)
+	    {
+		if (depth > 32)
+		    return false;
+
+		skip_space();
+
+		if (pos == text.size())
+		    return false;
+
+		switch (text[pos])
+		{
+		    case '"':
+			value.type = JsonValue::STRING;
+			return parse_string(value.str);
+
+		    case '[':
+		    {
+			value.type = JsonValue::ARRAY;
+
+			++pos;
+			skip_space();
+			if (pos < text.size() && text[pos] == ']')
+			{
+			    ++pos;
+			    return true;
+			}
+
+			while (true)
+			{
+			    value.array.emplace_back();
+			    if (!parse_value(value.array.back(), depth + 1))
+				return false;
+
+			    skip_space();
+			    if (pos == text.size())
+				return false;
+
+			    if (text[pos++] == ']')
+				return true;
+
+			    if (text[pos - 1] != ',')
+				return false;
+			}
+		    }
+
+		    case '{':
+		    {
+			value.type = JsonValue::OBJECT;
+
+			++pos;
+			skip_space();
+			if (pos < text.size() && text[pos] == '}')
+			{
+			    ++pos;
+			    return true;
+			}
+
+			while (true)
+			{
+			    skip_space();
+
+			    string key;
+			    if (pos == text.size() || !parse_string(key))
+				return false;
+
+			    skip_space();
+			    if (pos == text.size() || text[pos++] != ':')
+				return false;
+
+			    value.object.emplace_back(key, JsonValue());
+			    if (!parse_value(value.object.back().second, depth + 1))
+				return false;
+
+			    skip_space();
+			    if (pos == text.size())
+				return false;
+
+			    if (text[pos++] == '}')
+				return true;
+
+			    if (text[pos - 1] != ',')
+				return false;
+			}
+		    }
+
+		    default:
+		    {
+			// number, true, false or null
+
+			value.type = JsonValue::STRING;
+
+			size_t start = pos;
+			while (pos < text.size() && (isalnum((unsigned char) text[pos]) ||
+						     text[pos] == '-' || text[pos] == '+' ||
+						     text[pos] == '.'))
+			    ++pos;
+
+			value.str = text.substr(start, pos - start);
+			return pos != start;
+		    }
+		}
+	    }
+
+	    const string& text;
+	    size_t pos;
+	};
+
+    }
+
+
+    /*
+     * Extracts the rows of the reports of the given type and the return
+     * code of the command from the command log. Returns false if the
+     * report cannot be parsed or does not include the status of the
+     * command.
+     */
+    static bool
+    parse_report(const string& text, const string& report_type, bool& success,
+		 vector<LvmShell::Row>& rows)
+    {
+	JsonValue root;
+	if (!JsonParser(text).parse(root) || root.type != JsonValue::OBJECT)
+	{
+	    y2err("lvm shell: failed to parse report");
+	    return false;
+	}
+
+	const JsonValue* reports = root.find("report");
+	if (reports && reports->type == JsonValue::ARRAY)
+	{
+	    for (const JsonValue& report : reports->array)
+	    {
+		const JsonValue* entries = report.find(report_type);
+		if (!entries || entries->type != JsonValue::ARRAY)
+		    continue;
+
+		for (const JsonValue& entry : entries->array)
+		{
+		    LvmShell::Row row;
+		    for (const pair<string, JsonValue>& member : entry.object)
+			row[member.first] = member.second.str;
+		    rows.push_back(row);
+		}
+	    }
+	}
+
+	const JsonValue* log = root.find("log");
+	if (log && log->type == JsonValue::ARRAY)
+	{
+	    for (const JsonValue& entry : log->array)
+	    {
+		const JsonValue* type = entry.find("log_type");
+		const JsonValue* object_type = entry.find("log_object_type");
+		const JsonValue* ret_code = entry.find("log_ret_code");
+
+		if (type && type->str == "status" && object_type && object_type->str == "cmd" &&
+		    ret_code)
+		{
+		    // The ret code is 1 for success, see ECMD_PROCESSED in LVM.
+		    success = ret_code->str == "1";
+		    return true;
+		}
+	    }
+	}
+
+	y2err("lvm shell: no command status in report");
+	return false;
+    }
+
+
+    static int
+    move_above_report_fd(int fd)
+    {
+	// The fds of the child must not collide with the fds 0 to 3 used
+	// for the pipes.
+
+	if (fd > 3)
+	    return fd;
+
+	int tmp = fcntl(fd, F_DUPFD_CLOEXEC, 4);
+	close(fd);
+	return tmp;
+    }
+
+
+    LvmShell::LvmShell(const string& program)
+	: program(program), mutex(), failed(false), pid(-1), in_fd(-1), out_fd(-1), report_fd(-1)
+    {
+    }
+
+
+    LvmShell::~LvmShell()
+    {
+	stop();
+    }
+
+
+    LvmShell*
+    LvmShell::get_lvm_shell()
+    {
+	// Intentionally never deleted, the shell exits when its stdin is
+	// closed at exit.
+
+	static LvmShell* lvm_shell = new LvmShell(LVMBIN);
+	return lvm_shell;
+    }
+
+
+    bool
+    LvmShell::start()
+    {
+	y2mil("lvm shell: starting " << program);
+
+	int in[2], out[2], report[2];
+
+	if (pipe2(in, O_CLOEXEC) < 0)
+	    return false;
+
+	if (pipe2(out, O_CLOEXEC) < 0)
+	{
+	    close(in[0]);
+	    close(in[1]);
+	    return false;
+	}
+
+	if (pipe2(report, O_CLOEXEC) < 0)
+	{
+	    close(in[0]);
+	    close(in[1]);
+	    close(out[0]);
+	    close(out[1]);
+	    return false;
+	}
+
+	in[0] = move_above_report_fd(in[0]);
+	out[1] = move_above_report_fd(out[1]);
+	report[1] = move_above_report_fd(report[1]);
+
+	posix_spawn_file_actions_t actions;
+	posix_spawn_file_actions_init(&actions);
+	posix_spawn_file_actions_adddup2(&actions, in[0], STDIN_FILENO);
+	posix_spawn_file_actions_adddup2(&actions, out[1], STDOUT_FILENO);
+	posix_spawn_file_actions_adddup2(&actions, out[1], STDERR_FILENO);
+	posix_spawn_file_actions_adddup2(&actions, report[1], 3);
+#if defined(__GLIBC__) && __GLIBC_PREREQ(2, 34)
+	posix_spawn_file_actions_addclosefrom_np(&actions, 4);
+#endif
+
+	vector<string> env_strings;
+	for (char** v = environ; *v != NULL; ++v)
+	{
+	    if (strncmp(*v, "LC_ALL=", strlen("LC_ALL=")) != 0 &&
+		strncmp(*v, "LANGUAGE=", strlen("LANGUAGE=")) != 0 &&
+		strncmp(*v, "LVM_", strlen("LVM_")) != 0)
+		env_strings.push_back(*v);
+	}
+
+	env_strings.push_back("LC_ALL=C");
+	env_strings.push_back("LANGUAGE=C");
+	env_strings.push_back("LVM_REPORT_FD=3");
+	env_strings.push_back("LVM_SUPPRESS_FD_WARNINGS=1");
+
+	vector<char*> env;
+	for (const string& s : env_strings)
+	    env.push_back(const_cast<char*>(s.c_str()));
+	env.push_back(nullptr);
+
+	char* argv[] = { const_cast<char*>(program.c_str()), nullptr };
+
+	int r = posix_spawn(&pid, program.c_str(), &actions, nullptr, argv, &env[0]);
+
+	posix_spawn_file_actions_destroy(&actions);
+
+	close(in[0]);
+	close(out[1]);
+	close(report[1]);
+
+	in_fd = in[1];
+	out_fd = out[0];
+	report_fd = report[0];
+
+	if (r != 0)
+	{
+	    y2err("lvm shell: posix_spawn failed errno:" << r << " (" << stringerror(r) << ")");
+	    pid = -1;
+	    stop();
+	    return false;
+	}
+
+	fcntl(out_fd, F_SETFL, O_NONBLOCK);
+	fcntl(report_fd, F_SETFL, O_NONBLOCK);
+
+	string output, report_text;
+	if (!wait_for_prompt(output, report_text))
+	{
+	    y2err("lvm shell: no prompt, output:'" << output << "'");
+	    stop();
+	    return false;
+	}
+
+	// Without JSON reports including the command log the result of
+	// commands cannot be determined.
+
+	bool success = false;
+	vector<Row> rows;
+
+	if (!write_line(string("version") + report_options) || !wait_for_prompt(output, report_text) ||
+	    !parse_report(report_text, "", success, rows) || !success)
+	{
+	    y2err("lvm shell: probe failed, output:'" << output << "'");
+	    stop();
+	    return false;
+	}
+
+	return true;
+    }
+
+
+    void
+    LvmShell::stop()
+    {
+	if (in_fd >= 0)
+	{
+	    close(in_fd);
+	    in_fd = -1;
+	}
+
+	if (pid > 0)
+	{
+	    // The shell exits on end of input, otherwise it is killed.
+
+	    int status;
+	    int r = 0;
+	    for (int i = 0; i < 100 && (r = waitpid(pid, &status, WNOHANG)) == 0; ++i)
+		usleep(10000);
+
+	    if (r == 0)
+	    {
+		kill(pid, SIGKILL);
+		waitpid(pid, &status, 0);
+	    }
+
+	    pid = -1;
+	}
+
+	if (out_fd >= 0)
+	{
+	    close(out_fd);
+	    out_fd = -1;
+	}
+
+	if (report_fd >= 0)
+	{
+	    close(report_fd);
+	    report_fd = -1;
+	}
+    }
+
+
+    /*
+     * Writing to a dead shell must not kill the process with SIGPIPE. The
+     * signal disposition is process-wide and belongs to the program, so
+     * instead SIGPIPE is blocked for this thread during the write and a
+     * SIGPIPE caused by the write is consumed.
+     */
+    bool
+    LvmShell::write_line(const string& line)
+    {
+	sigset_t sigpipe_set, old_set, pending_set;
+	sigemptyset(&sigpipe_set);
+	sigaddset(&sigpipe_set, SIGPIPE);
+
+	pthread_sigmask(SIG_BLOCK, &sigpipe_set, &old_set);
+
+	sigpending(&pending_set);
+	bool was_pending = sigismember(&pending_set, SIGPIPE);
+
+	const char* p = line.c_str();
+	size_t len = line.size();
+	while (len > 0)
+	{
+	    ssize_t n = write(in_fd, p, len);
+	    if (n < 0 && errno == EINTR)
+		continue;
+
+	    if (n <= 0)
+		break;
+
+	    p += n;
+	    len -= n;
+	}
+
+	int error = errno;
+
+	if (len > 0 && error == EPIPE && !was_pending)
+	{
+	    const struct timespec timeout = { 0, 0 };
+	    while (sigtimedwait(&sigpipe_set, nullptr, &timeout) < 0 && errno == EINTR)
+		;
+	}
+
+	pthread_sigmask(SIG_SETMASK, &old_set, nullptr);
+
+	if (len > 0)
+	{
+	    y2err("lvm shell: write failed errno:" << error << " (" << stringerror(error) << ")");
+	    return false;
+	}
+
+	return true;
+    }
+
+
+    bool
+    LvmShell::wait_for_prompt(string& output, string& report)
+    {
+	// Both pipes must be read while waiting, otherwise lvm can block
+	// writing a large report.
+
+	const chrono::steady_clock::time_point deadline = chrono::steady_clock::now() +
+	    command_timeout;
+
+	while (!boost::ends_with(output, prompt))
+	{
+	    chrono::milliseconds remaining = chrono::duration_cast<chrono::milliseconds>(
+		deadline - chrono::steady_clock::now());
+	    if (remaining <= chrono::milliseconds(0))
+	    {
+		y2err("lvm shell: timeout");
+		return false;
+	    }
+
+	    struct pollfd pfds[2] = { { out_fd, POLLIN, 0 }, { report_fd, POLLIN, 0 } };
+
+	    int r = poll(pfds, 2, remaining.count());
+	    if (r < 0)
+	    {
+		if (errno == EINTR)
+		    continue;
+
+		y2err("lvm shell: poll failed errno:" << errno << " (" << stringerror(errno) << ")");
+		return false;
+	    }
+
+	    for (int i = 0; i < 2; ++i)
+	    {
+		if (pfds[i].revents == 0)
+		    continue;
+
+		char buf[4096];
+		ssize_t n = read(pfds[i].fd, buf, sizeof(buf));
+		if (n > 0)
+		{
+		    (i == 0 ? output : report).append(buf, n);
+		}
+		else if (n == 0 || (errno != EINTR && errno != EAGAIN))
+		{
+		    y2err("lvm shell: shell exited");
+		    return false;
+		}
+	    }
+	}
+
+	output.erase(output.size() - strlen(prompt));
+
+	// The report is complete when the prompt is shown.
+
+	char buf[4096];
+	ssize_t n;
+	while ((n = read(report_fd, buf, sizeof(buf))) > 0)
+	    report.append(buf, n);
+
+	return true;
+    }
+
+
+    bool
+    LvmShell::run(const vector<string>& args, const string& report_type, bool& success,
+		  vector<Row>& rows)
+    {
+	// The shell splits the command line at whitespace, so arguments
+	// needing quoting are not passed to it.
+
+	for (const string& arg : args)
+	{
+	    if (arg.empty() || arg.find_first_of(" \t\n\"'\\") != string::npos)
+		return false;
+	}
+
+	boost::lock_guard<boost::mutex> lock(mutex);
+
+	if (failed)
+	    return false;
+
+	if (pid < 0 && !start())
+	{
+	    y2war("lvm shell: not available, using separate processes");
+	    failed = true;
+	    return false;
+	}
+
+	string line = boost::join(args, " ") + report_options;
+
+	y2mil("lvm shell: " << line.substr(0, line.size() - 1));
+
+	StopWatch stopwatch;
+
+	if (!write_line(line))
+	{
+	    stop();
+	    failed = true;
+	    return false;
+	}
+
+	// From here on the command may have been executed, so it must not
+	// be run again as separate process. Failures are reported as
+	// failure of the command.
+
+	success = false;
+
+	string output, report;
+	if (!wait_for_prompt(output, report))
+	{
+	    stop();
+	    failed = true;
+	    return true;
+	}
+
+	if (!output.empty())
+	    y2mil("lvm shell: output:'" << boost::trim_copy(output) << "'");
+
+	rows.clear();
+	if (!parse_report(report, report_type, success, rows))
+	{
+	    y2err("lvm shell: report:'" << report << "'");
+	    stop();
+	    failed = true;
+	    return true;
+	}
+
+	y2mil("lvm shell: stopwatch " << stopwatch << " success:" << success << " rows:" << rows.size());
+
+	return true;
+    }
+
+}
@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2019 SUSE LLC
+ *
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of version 2 of the GNU General Public License as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, contact Novell, Inc.
+ *
+ * To contact Novell about this file by physical or electronic mail, you may
+ * find current contact information at www.novell.com.
+ */
+
+
+#ifndef SNAPPER_LVM_SHELL_H
+#define SNAPPER_LVM_SHELL_H
+
+
+#include <sys/types.h>
+#include <map>
+#include <string>
+#include <vector>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/lock_guard.hpp>
+
+
+namespace snapper
+{
+    using std::map;
+    using std::string;
+    using std::vector;
+
+
+    /*
+     * Runs LVM commands in one long-running lvm shell instead of a new
+     * process per command, which avoids the LVM startup and device scan
+     * for every command. Reports are requested in JSON format via
+     * LVM_REPORT_FD and include the command log, from which the result
+     * of the command is taken. When starting the shell this is probed
+     * with the version command.
+     *
+     * If the shell fails in any way it is stopped and not used anymore.
+     * The caller must then run the command as a separate process.
+     */
+    class LvmShell : private boost::noncopyable
+    {
+    public:
+
+	typedef map<string, string> Row;
+
+	explicit LvmShell(const string& program);
+	~LvmShell();
+
+	/*
+	 * Runs a command, e.g. { "lvs", "-o", "lv_name", "vg" }. Returns
+	 * false if the command could not be run in the shell. Otherwise
+	 * success tells whether the command succeeded and rows holds the
+	 * rows of all reports of the given type (e.g. "lv"). If the shell
+	 * fails after the command was sent the command counts as failed.
+	 */
+	bool run(const vector<string>& args, const string& report_type, bool& success,
+		 vector<Row>& rows);
+
+	static LvmShell* get_lvm_shell();
+
+    private:
+
+	bool start();
+	void stop();
+
+	bool write_line(const string& line);
+	bool wait_for_prompt(string& output, string& report);
+
+	const string program;
+
+	boost::mutex mutex;
+
+	bool failed;
+
+	pid_t pid;
+
+	int in_fd;
+	int out_fd;
+	int report_fd;
+
+    };
+
+}
+
+
+#endif
@@ -20,32 +20,45 @@
  */
 
 
-#include <ostream>
+#ifndef SNAPPER_RANGE_H
+#define SNAPPER_RANGE_H
 
-using std::istream;
-using std::ostream;
 
+#include <stddef.h>
+#include <ostream>
 
-/*
- * Simple class to hold a range of two size_ts as min and max.
- */
-class Range
+
+namespace snapper
 {
-public:
+    using std::istream;
+    using std::ostream;
+
+
+    /*
+     * Simple class to hold a range of two size_ts as min and max.
+     */
+    class Range
+    {
+    public:
+
+	enum Value { MIN, MAX };
+
+	Range(size_t value) : min(value), max(value) {}
+
+	size_t value(Value value) const { return value == MIN ? min : max; }
 
-    enum Value { MIN, MAX };
+	bool is_degenerated() const { return min == max; }
 
-    Range(size_t value) : min(value), max(value) {}
+	friend istream& operator>>(istream& s, Range& range);
+	friend ostream& operator<<(ostream& s, const Range& range);
 
-    size_t value(Value value) const { return value == MIN ? min : max; }
+    private:
 
-    bool is_degenerated() const { return min == max; }
+	size_t min;
+	size_t max;
+    };
 
-    friend istream& operator>>(istream& s, Range& range);
-    friend ostream& operator<<(ostream& s, const Range& range);
+}
 
-private:
 
-    size_t min;
-    size_t max;
-};
+#endif
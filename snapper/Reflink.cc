@@ -0,0 +1,859 @@
+/*
+ * Copyright (c) 2019 SUSE LLC
+ *
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of version 2 of the GNU General Public License as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, contact Novell, Inc.
+ *
+ * To contact Novell about this file by physical or electronic mail, you may
+ * find current contact information at www.novell.com.
+ */
+
+
+#include "config.h"
+
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/xattr.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <algorithm>
+#include <functional>
+#include <exception>
+#include <atomic>
+#include <boost/thread.hpp>
+
+#include "snapper/Log.h"
+#include "snapper/Reflink.h"
+#include "snapper/Snapper.h"
+#include "snapper/SnapperTmpl.h"
+#include "snapper/AppUtil.h"
+#include "snapper/Exception.h"
+
+
+namespace snapper
+{
+
+    Filesystem*
+    Reflink::create(const string& fstype, const string& subvolume, const string& root_prefix)
+    {
+	if (fstype == "reflink")
+	    return new Reflink(subvolume, root_prefix);
+
+	return NULL;
+    }
+
+
+    Reflink::Reflink(const string& subvolume, const string& root_prefix)
+	: Filesystem(subvolume, root_prefix)
+    {
+    }
+
+
+    void
+    Reflink::createConfig() const
+    {
+	SDir subvolume_dir = openSubvolumeDir();
+
+	int r1 = subvolume_dir.mkdir(".snapshots", 0750);
+	if (r1 != 0 && errno != EEXIST)
+	{
+	    y2err("mkdir failed errno:" << errno << " (" << stringerror(errno) << ")");
+	    SN_THROW(CreateConfigFailedException("mkdir failed"));
+	}
+    }
+
+
+    void
+    Reflink::deleteConfig() const
+    {
+	SDir subvolume_dir = openSubvolumeDir();
+
+	int r1 = subvolume_dir.unlink(".snapshots", AT_REMOVEDIR);
+	if (r1 != 0)
+	{
+	    y2err("rmdir failed errno:" << errno << " (" << stringerror(errno) << ")");
+	    SN_THROW(DeleteConfigFailedException("rmdir failed"));
+	}
+    }
+
+
+    string
+    Reflink::snapshotDir(unsigned int num) const
+    {
+	return (subvolume == "/" ? "" : subvolume) + "/.snapshots/" + decString(num) +
+	    "/snapshot";
+    }
+
+
+    SDir
+    Reflink::openInfosDir() const
+    {
+	SDir subvolume_dir = openSubvolumeDir();
+	SDir infos_dir(subvolume_dir, ".snapshots");
+
+	struct stat stat;
+	if (infos_dir.stat(&stat) != 0)
+	{
+	    SN_THROW(IOErrorException("stat on .snapshots failed"));
+	}
+
+	if (stat.st_uid != 0)
+	{
+	    y2err(".snapshots must have owner root");
+	    SN_THROW(IOErrorException(".snapshots must have owner root"));
+	}
+
+	if (stat.st_gid != 0 && stat.st_mode & S_IWGRP)
+	{
+	    y2err(".snapshots must have group root or must not be group-writable");
+	    SN_THROW(IOErrorException(".snapshots must have group root or must not be group-writable"));
+	}
+
+	if (stat.st_mode & S_IWOTH)
+	{
+	    y2err(".snapshots must not be world-writable");
+	    SN_THROW(IOErrorException(".snapshots must not be world-writable"));
+	}
+
+	return infos_dir;
+    }
+
+
+    SDir
+    Reflink::openSnapshotDir(unsigned int num) const
+    {
+	SDir info_dir = openInfoDir(num);
+	SDir snapshot_dir(info_dir, "snapshot");
+
+	return snapshot_dir;
+    }
+
+
+    /*
+     * Processes a directory tree with several threads. Every directory is
+     * a job identified by its path relative to the top directory ("" for
+     * the top directory itself). The function handling a job adds the
+     * names of the subdirectories that need a job of their own. Only paths
+     * are queued so that the number of open directories stays small.
+     */
+    static void
+    walk_tree(std::function<void(const string& path, vector<string>& subdirs)> func)
+    {
+	boost::mutex mutex;
+	boost::condition_variable condition;
+
+	vector<string> todo = { "" };
+	unsigned int busy = 0;
+	std::exception_ptr exception;
+
+	run_workers([&]() {
+
+	    boost::unique_lock<boost::mutex> lock(mutex);
+
+	    while (true)
+	    {
+		while (todo.empty() && busy != 0 && !exception)
+		    condition.wait(lock);
+
+		if (todo.empty() || exception)
+		    break;
+
+		string path = todo.back();
+		todo.pop_back();
+		++busy;
+
+		lock.unlock();
+
+		vector<string> subdirs;
+		std::exception_ptr tmp;
+
+		try
+		{
+		    func(path, subdirs);
+		}
+		catch (...)
+		{
+		    tmp = std::current_exception();
+		}
+
+		lock.lock();
+
+		--busy;
+
+		if (tmp && !exception)
+		    exception = tmp;
+
+		for (const string& subdir : subdirs)
+		    todo.push_back(path.empty() ? subdir : path + "/" + subdir);
+
+		condition.notify_all();
+	    }
+
+	});
+
+	if (exception)
+	    std::rethrow_exception(exception);
+    }
+
+
+    static SDir
+    open_tree_dir(const SDir& top, const string& path)
+    {
+	return path.empty() ? top : SDir::deepopen(top, path);
+    }
+
+
+    /*
+     * Copies the extended attributes, including ACLs. For symlinks and
+     * special files the fds are O_PATH fds which only work via /proc.
+     */
+    static void
+    copy_xattrs(int src_fd, int dest_fd, bool o_path, const string& name)
+    {
+#ifdef ENABLE_XATTRS
+	const string src_proc = "/proc/self/fd/" + decString(src_fd);
+	const string dest_proc = "/proc/self/fd/" + decString(dest_fd);
+
+	vector<char> names;
+	vector<char> value;
+
+	ssize_t size;
+	while (true)
+	{
+	    size = o_path ? ::listxattr(src_proc.c_str(), names.data(), names.size()) :
+		::flistxattr(src_fd, names.data(), names.size());
+	    if (size >= 0 && (!names.empty() || size == 0))
+		break;
+
+	    if (size < 0 && errno != ERANGE)
+	    {
+		if (errno == ENOTSUP)
+		    return;
+
+		y2err("listxattr failed path:" << name << " errno:" << errno << " (" <<
+		      stringerror(errno) << ")");
+		SN_THROW(CreateSnapshotFailedException());
+	    }
+
+	    names.resize(std::max<size_t>(names.size() * 2, 256));
+	}
+
+	for (ssize_t pos = 0; pos < size; pos += strlen(names.data() + pos) + 1)
+	{
+	    const char* xa_name = names.data() + pos;
+
+	    ssize_t v_size;
+	    while (true)
+	    {
+		v_size = o_path ? ::getxattr(src_proc.c_str(), xa_name, value.data(), value.size()) :
+		    ::fgetxattr(src_fd, xa_name, value.data(), value.size());
+		if (v_size >= 0 && (!value.empty() || v_size == 0))
+		    break;
+
+		if (v_size < 0 && errno != ERANGE)
+		{
+		    y2err("getxattr failed path:" << name << " xa_name:" << xa_name << " errno:" <<
+			  errno << " (" << stringerror(errno) << ")");
+		    SN_THROW(CreateSnapshotFailedException());
+		}
+
+		value.resize(std::max<size_t>(value.size() * 2, 256));
+	    }
+
+	    int r1 = o_path ? ::setxattr(dest_proc.c_str(), xa_name, value.data(), v_size, 0) :
+		::fsetxattr(dest_fd, xa_name, value.data(), v_size, 0);
+	    if (r1 != 0)
+	    {
+		y2err("setxattr failed path:" << name << " xa_name:" << xa_name << " errno:" <<
+		      errno << " (" << stringerror(errno) << ")");
+		SN_THROW(CreateSnapshotFailedException());
+	    }
+	}
+#endif
+    }
+
+
+    class TreeCloner
+    {
+    public:
+
+	TreeCloner(const SDir& src_top, const SDir& dest_top, bool skip_snapshots)
+	    : src_top(src_top), dest_top(dest_top), skip_snapshots(skip_snapshots),
+	      clone(true), files(0), bytes_cloned(0), bytes_copied(0)
+	{
+	    struct stat stat;
+	    if (src_top.stat(&stat) != 0)
+		SN_THROW(IOErrorException("stat failed path:" + src_top.fullname()));
+
+	    dev = stat.st_dev;
+	}
+
+	void run()
+	{
+	    walk_tree(std::bind(&TreeCloner::cloneDir, this, std::placeholders::_1,
+				std::placeholders::_2));
+
+	    y2mil("files:" << files << " bytes-cloned:" << bytes_cloned << " bytes-copied:" <<
+		  bytes_copied);
+	}
+
+    private:
+
+	void cloneDir(const string& path, vector<string>& subdirs);
+
+	bool cloneEntry(const SDir& src, const SDir& dest, const string& name,
+			const struct stat& stat);
+
+	void cloneReg(const SDir& src, const SDir& dest, const string& name);
+	void cloneContent(int src_fd, int dest_fd, const string& name);
+
+	void setMetadata(const SDir& dest, const string& name, const struct stat& stat,
+			 int src_fd, int dest_fd, bool o_path) const;
+
+	void setTimes(const SDir& dest, const string& name, const struct stat& stat) const;
+
+	const SDir& src_top;
+	const SDir& dest_top;
+
+	// skip .snapshots in the top directory
+	const bool skip_snapshots;
+
+	dev_t dev;
+
+	// false once cloning has failed as unsupported, so copy right away
+	std::atomic<bool> clone;
+
+	std::atomic<unsigned long long> files;
+	std::atomic<unsigned long long> bytes_cloned;
+	std::atomic<unsigned long long> bytes_copied;
+
+    };
+
+
+    void
+    TreeCloner::cloneDir(const string& path, vector<string>& subdirs)
+    {
+	boost::this_thread::interruption_point();
+
+	SDir src = open_tree_dir(src_top, path);
+	SDir dest = open_tree_dir(dest_top, path);
+
+	struct stat stat;
+	if (src.stat(&stat) != 0)
+	    SN_THROW(IOErrorException("stat failed path:" + src.fullname()));
+
+	setMetadata(dest, "", stat, src.fd(), dest.fd(), false);
+
+	for (const string& name : src.entries())
+	{
+	    if (path.empty() && skip_snapshots && name == ".snapshots")
+		continue;
+
+	    struct stat tmp;
+	    if (src.stat(name, &tmp, AT_SYMLINK_NOFOLLOW) != 0)
+	    {
+		// the file was deleted meanwhile
+		if (errno == ENOENT)
+		    continue;
+
+		SN_THROW(IOErrorException("stat failed path:" + src.fullname(name)));
+	    }
+
+	    if (cloneEntry(src, dest, name, tmp))
+		subdirs.push_back(name);
+	}
+
+	// Only now since creating the entries changes the times of the
+	// directory.
+
+	if (futimens(dest.fd(), &stat.st_atim) != 0)
+	{
+	    y2err("futimens failed path:" << dest.fullname() << " errno:" << errno << " (" <<
+		  stringerror(errno) << ")");
+	    SN_THROW(CreateSnapshotFailedException());
+	}
+    }
+
+
+    /*
+     * Creates the entry in the destination directory. Returns true if the
+     * entry is a directory that must be cloned.
+     */
+    bool
+    TreeCloner::cloneEntry(const SDir& src, const SDir& dest, const string& name,
+			   const struct stat& stat)
+    {
+	// Files mounted from another filesystem, e.g. a bind mounted
+	// /etc/resolv.conf, are not part of the subvolume. Like for
+	// directories only an empty mount point is created.
+
+	if (!S_ISDIR(stat.st_mode) && stat.st_dev != dev)
+	{
+	    if (!S_ISREG(stat.st_mode))
+		return false;
+
+	    int dest_fd = dest.open(name, O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC,
+				    0600);
+	    if (dest_fd < 0)
+	    {
+		y2err("open failed path:" << dest.fullname(name) << " errno:" << errno << " (" <<
+		      stringerror(errno) << ")");
+		SN_THROW(CreateSnapshotFailedException());
+	    }
+
+	    FdCloser dest_closer(dest_fd);
+
+	    setMetadata(dest, name, stat, -1, dest_fd, false);
+	    setTimes(dest, name, stat);
+
+	    return false;
+	}
+
+	switch (stat.st_mode & S_IFMT)
+	{
+	    case S_IFDIR: {
+
+		if (dest.mkdir(name, 0700) != 0)
+		{
+		    y2err("mkdir failed path:" << dest.fullname(name) << " errno:" << errno <<
+			  " (" << stringerror(errno) << ")");
+		    SN_THROW(CreateSnapshotFailedException());
+		}
+
+		// Like subvolumes for btrfs, mount points stay empty.
+
+		if (stat.st_dev == dev)
+		    return true;
+
+		SDir tmp(dest, name);
+		setMetadata(tmp, "", stat, -1, tmp.fd(), false);
+		setTimes(dest, name, stat);
+
+	    } break;
+
+	    case S_IFREG: {
+
+		cloneReg(src, dest, name);
+
+	    } break;
+
+	    case S_IFLNK: {
+
+		string target;
+		if (src.readlink(name, target) < 0)
+		{
+		    if (errno == ENOENT)
+			return false;
+
+		    y2err("readlink failed path:" << src.fullname(name) << " errno:" << errno);
+		    SN_THROW(CreateSnapshotFailedException());
+		}
+
+		if (dest.symlink(target, name) != 0)
+		{
+		    y2err("symlink failed path:" << dest.fullname(name) << " errno:" << errno <<
+			  " (" << stringerror(errno) << ")");
+		    SN_THROW(CreateSnapshotFailedException());
+		}
+
+		setMetadata(dest, name, stat, src.open(name, O_PATH | O_NOFOLLOW | O_CLOEXEC),
+			    dest.open(name, O_PATH | O_NOFOLLOW | O_CLOEXEC), true);
+		setTimes(dest, name, stat);
+
+	    } break;
+
+	    default: {
+
+		if (mknodat(dest.fd(), name.c_str(), (stat.st_mode & S_IFMT) | 0600,
+			    stat.st_rdev) != 0)
+		{
+		    y2err("mknod failed path:" << dest.fullname(name) << " errno:" << errno <<
+			  " (" << stringerror(errno) << ")");
+		    SN_THROW(CreateSnapshotFailedException());
+		}
+
+		setMetadata(dest, name, stat, src.open(name, O_PATH | O_NOFOLLOW | O_CLOEXEC),
+			    dest.open(name, O_PATH | O_NOFOLLOW | O_CLOEXEC), true);
+		setTimes(dest, name, stat);
+
+	    } break;
+	}
+
+	++files;
+
+	return false;
+    }
+
+
+    void
+    TreeCloner::cloneReg(const SDir& src, const SDir& dest, const string& name)
+    {
+	int src_fd = src.open(name, O_RDONLY | O_NOFOLLOW | O_NOATIME | O_CLOEXEC);
+	if (src_fd < 0)
+	{
+	    // the file was deleted meanwhile
+	    if (errno == ENOENT)
+		return;
+
+	    y2err("open failed path:" << src.fullname(name) << " errno:" << errno << " (" <<
+		  stringerror(errno) << ")");
+	    SN_THROW(CreateSnapshotFailedException());
+	}
+
+	FdCloser src_closer(src_fd);
+
+	// The stat of the opened file matches the content that is cloned.
+
+	struct stat stat;
+	if (fstat(src_fd, &stat) != 0)
+	{
+	    y2err("fstat failed path:" << src.fullname(name) << " errno:" << errno);
+	    SN_THROW(CreateSnapshotFailedException());
+	}
+
+	int dest_fd = dest.open(name, O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, 0600);
+	if (dest_fd < 0)
+	{
+	    y2err("open failed path:" << dest.fullname(name) << " errno:" << errno << " (" <<
+		  stringerror(errno) << ")");
+	    SN_THROW(CreateSnapshotFailedException());
+	}
+
+	FdCloser dest_closer(dest_fd);
+
+	cloneContent(src_fd, dest_fd, dest.fullname(name));
+
+	setMetadata(dest, name, stat, src_fd, dest_fd, false);
+
+	if (futimens(dest_fd, &stat.st_atim) != 0)
+	{
+	    y2err("futimens failed path:" << dest.fullname(name) << " errno:" << errno);
+	    SN_THROW(CreateSnapshotFailedException());
+	}
+    }
+
+
+    void
+    TreeCloner::cloneContent(int src_fd, int dest_fd, const string& name)
+    {
+	// Like File::restoreContent() clone if possible and otherwise copy
+	// the data, with copy_file_range if available.
+
+	if (clone.load(std::memory_order_relaxed))
+	{
+	    if (clonefile(src_fd, dest_fd))
+	    {
+		struct stat stat;
+		if (fstat(dest_fd, &stat) == 0)
+		    bytes_cloned += stat.st_size;
+		return;
+	    }
+
+	    // Only stop cloning if the filesystem does not support it at
+	    // all. EINVAL or EXDEV only affect this file.
+
+	    if (is_unsupported(errno))
+	    {
+		if (clone.exchange(false))
+		    y2mil("cloning not supported, copying data");
+	    }
+	    else if (errno != EINVAL && errno != EXDEV)
+	    {
+		y2err("clone failed path:" << name << " errno:" << errno << " (" <<
+		      stringerror(errno) << ")");
+		SN_THROW(CreateSnapshotFailedException());
+	    }
+	}
+
+	unsigned long long copied = 0;
+	bool ret = copyfilerange(src_fd, dest_fd, copied);
+	if (!ret && copied == 0 && (is_unsupported(errno) || errno == EINVAL || errno == EXDEV))
+	    ret = copyfile(src_fd, dest_fd, copied);
+
+	bytes_copied += copied;
+
+	if (!ret)
+	{
+	    y2err("copying failed path:" << name << " errno:" << errno << " (" <<
+		  stringerror(errno) << ")");
+	    SN_THROW(CreateSnapshotFailedException());
+	}
+    }
+
+
+    /*
+     * Sets owner, permissions and extended attributes. The owner must be
+     * set first since chown clears the setuid and setgid bits and file
+     * capabilities. If src_fd is -1 no extended attributes are copied.
+     * Closes the fds if o_path is true.
+     */
+    void
+    TreeCloner::setMetadata(const SDir& dest, const string& name, const struct stat& stat,
+			    int src_fd, int dest_fd, bool o_path) const
+    {
+	FdCloser src_closer(o_path ? src_fd : -1);
+	FdCloser dest_closer(o_path ? dest_fd : -1);
+
+	const string fullname = name.empty() ? dest.fullname() : dest.fullname(name);
+
+	if (o_path && (src_fd < 0 || dest_fd < 0))
+	{
+	    y2err("open failed path:" << fullname << " errno:" << errno);
+	    SN_THROW(CreateSnapshotFailedException());
+	}
+
+	int r1 = o_path ? dest.chown(name, stat.st_uid, stat.st_gid, AT_SYMLINK_NOFOLLOW) :
+	    fchown(dest_fd, stat.st_uid, stat.st_gid);
+	if (r1 != 0)
+	{
+	    y2err("chown failed path:" << fullname << " errno:" << errno << " (" <<
+		  stringerror(errno) << ")");
+	    SN_THROW(CreateSnapshotFailedException());
+	}
+
+	// Permissions of symlinks cannot be changed (and are always 0777).
+
+	if (!S_ISLNK(stat.st_mode))
+	{
+	    int r2 = o_path ? dest.chmod(name, stat.st_mode & 07777, 0) :
+		fchmod(dest_fd, stat.st_mode & 07777);
+	    if (r2 != 0)
+	    {
+		y2err("chmod failed path:" << fullname << " errno:" << errno << " (" <<
+		      stringerror(errno) << ")");
+		SN_THROW(CreateSnapshotFailedException());
+	    }
+	}
+
+	if (src_fd >= 0)
+	    copy_xattrs(src_fd, dest_fd, o_path, fullname);
+    }
+
+
+    void
+    TreeCloner::setTimes(const SDir& dest, const string& name, const struct stat& stat) const
+    {
+	if (utimensat(dest.fd(), name.c_str(), &stat.st_atim, AT_SYMLINK_NOFOLLOW) != 0)
+	{
+	    y2err("utimensat failed path:" << dest.fullname(name) << " errno:" << errno);
+	    SN_THROW(CreateSnapshotFailedException());
+	}
+    }
+
+
+    /*
+     * Removes the content of the directory tree. Files are removed by
+     * several threads, the directories afterwards in reverse order so that
+     * subdirectories are removed before their parents.
+     */
+    static void
+    remove_tree_content(const SDir& top)
+    {
+	boost::mutex mutex;
+	vector<string> dirs;
+
+	walk_tree([&](const string& path, vector<string>& subdirs) {
+
+	    boost::this_thread::interruption_point();
+
+	    SDir dir = open_tree_dir(top, path);
+
+	    for (const string& name : dir.entries())
+	    {
+		struct stat stat;
+		if (dir.stat(name, &stat, AT_SYMLINK_NOFOLLOW) != 0)
+		    SN_THROW(IOErrorException("stat failed path:" + dir.fullname(name)));
+
+		if (S_ISDIR(stat.st_mode))
+		{
+		    subdirs.push_back(name);
+		}
+		else if (dir.unlink(name, 0) != 0)
+		{
+		    y2err("unlink failed path:" << dir.fullname(name) << " errno:" << errno <<
+			  " (" << stringerror(errno) << ")");
+		    SN_THROW(DeleteSnapshotFailedException());
+		}
+	    }
+
+	    boost::lock_guard<boost::mutex> lock(mutex);
+	    for (const string& subdir : subdirs)
+		dirs.push_back(path.empty() ? subdir : path + "/" + subdir);
+
+	});
+
+	// A path sorts before all paths below it.
+
+	std::sort(dirs.begin(), dirs.end(), std::greater<string>());
+
+	for (const string& dir : dirs)
+	{
+	    string::size_type pos = dir.rfind('/');
+
+	    SDir parent = open_tree_dir(top, pos == string::npos ? "" : dir.substr(0, pos));
+	    string name = pos == string::npos ? dir : dir.substr(pos + 1);
+
+	    if (parent.unlink(name, AT_REMOVEDIR) != 0)
+	    {
+		y2err("rmdir failed path:" << parent.fullname(name) << " errno:" << errno << " (" <<
+		      stringerror(errno) << ")");
+		SN_THROW(DeleteSnapshotFailedException());
+	    }
+	}
+    }
+
+
+    void
+    Reflink::createSnapshot(unsigned int num, unsigned int num_parent, bool read_only,
+			    bool quota, bool empty) const
+    {
+	if (!read_only)
+	    throw std::logic_error("not implemented");
+
+	SDir info_dir = openInfoDir(num);
+
+	if (info_dir.mkdir("snapshot", 0700) != 0)
+	{
+	    y2err("mkdir failed errno:" << errno << " (" << stringerror(errno) << ")");
+	    SN_THROW(CreateSnapshotFailedException());
+	}
+
+	SDir snapshot_dir(info_dir, "snapshot");
+
+	try
+	{
+	    SDir src_dir = num_parent == 0 ? openSubvolumeDir() : openSnapshotDir(num_parent);
+
+	    if (empty)
+	    {
+		struct stat stat;
+		if (src_dir.stat(&stat) != 0 || fchmod(snapshot_dir.fd(), stat.st_mode & 07777) != 0)
+		    SN_THROW(CreateSnapshotFailedException());
+	    }
+	    else
+	    {
+		StopWatch stopwatch;
+
+		TreeCloner tree_cloner(src_dir, snapshot_dir, num_parent == 0);
+		tree_cloner.run();
+
+		y2mil("stopwatch " << stopwatch << " for cloning directory tree");
+	    }
+	}
+	catch (const Exception& e)
+	{
+	    SN_CAUGHT(e);
+
+	    try
+	    {
+		remove_tree_content(snapshot_dir);
+		info_dir.unlink("snapshot", AT_REMOVEDIR);
+	    }
+	    catch (const Exception& e)
+	    {
+		SN_CAUGHT(e);
+	    }
+
+	    SN_THROW(CreateSnapshotFailedException());
+	}
+    }
+
+
+    void
+    Reflink::deleteSnapshot(unsigned int num) const
+    {
+	SDir info_dir = openInfoDir(num);
+
+	try
+	{
+	    StopWatch stopwatch;
+
+	    remove_tree_content(SDir(info_dir, "snapshot"));
+
+	    y2mil("stopwatch " << stopwatch << " for removing directory tree");
+	}
+	catch (const Exception& e)
+	{
+	    SN_CAUGHT(e);
+	    SN_THROW(DeleteSnapshotFailedException());
+	}
+
+	if (info_dir.unlink("snapshot", AT_REMOVEDIR) != 0)
+	{
+	    y2err("rmdir failed errno:" << errno << " (" << stringerror(errno) << ")");
+	    SN_THROW(DeleteSnapshotFailedException());
+	}
+    }
+
+
+    bool
+    Reflink::isSnapshotMounted(unsigned int num) const
+    {
+	return true;
+    }
+
+
+    void
+    Reflink::mountSnapshot(unsigned int num) const
+    {
+    }
+
+
+    void
+    Reflink::umountSnapshot(unsigned int num) const
+    {
+    }
+
+
+    bool
+    Reflink::isSnapshotReadOnly(unsigned int num) const
+    {
+	// Snapshots are plain directories, thus only read-only by
+	// convention.
+
+	return true;
+    }
+
+
+    bool
+    Reflink::checkSnapshot(unsigned int num) const
+    {
+	try
+	{
+	    SDir info_dir = openInfoDir(num);
+
+	    struct stat stat;
+	    int r = info_dir.stat("snapshot", &stat, AT_SYMLINK_NOFOLLOW);
+	    return r == 0 && S_ISDIR(stat.st_mode);
+	}
+	catch (const IOErrorException& e)
+	{
+	    return false;
+	}
+    }
+
+
+    void
+    Reflink::cmpDirs(const SDir& dir1, const SDir& dir2, cmpdirs_cb_t cb) const
+    {
+	// Unchanged files of a snapshot share their extents with the
+	// original if they were cloned. Checking that avoids reading files
+	// whose mtime changed but not their content.
+
+	snapper::cmpDirs(dir1, dir2, cb, true);
+    }
+
+}
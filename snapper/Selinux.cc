@@ -110,6 +110,8 @@ namespace snapper
     {
 	char *con;
 
+	boost::lock_guard<boost::mutex> lock(mutex);
+
 	if (!::selabel_lookup(handle, &con, path.c_str(), mode))
 	{
 	    y2deb("found label for path " << path << ": " << con);
@@ -29,6 +29,7 @@
 #include <selinux/selinux.h>
 
 #include <boost/noncopyable.hpp>
+#include <boost/thread.hpp>
 
 #include "snapper/Exception.h"
 
@@ -77,6 +78,9 @@ namespace snapper {
 	SelinuxLabelHandle();
 
 	struct selabel_handle* handle;
+
+	// Lookups may happen from several threads.
+	boost::mutex mutex;
     };
 
 }
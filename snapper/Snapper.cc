@@ -25,6 +25,7 @@
 
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <fcntl.h>
 #include <sys/statvfs.h>
 #include <glob.h>
 #include <string.h>
@@ -86,7 +87,8 @@ namespace snapper
 
 
     Snapper::Snapper(const string& config_name, const string& root_prefix, bool disable_filters)
-	: config_info(NULL), filesystem(NULL), snapshots(this), selabel_handle(NULL)
+	: config_info(NULL), filesystem(NULL), snapshots(this), selabel_handle(NULL),
+	  change_journal(NULL)
     {
 	y2mil("Snapper constructor");
 	y2mil("libsnapper version " VERSION);
@@ -259,6 +261,27 @@ namespace snapper
     }
 
 
+    void
+    Snapper::deleteSnapshots(const vector<Snapshots::iterator>& tmp)
+    {
+	snapshots.deleteSnapshots(tmp);
+    }
+
+
+    SnapshotChange
+    Snapper::reloadSnapshot(unsigned int num)
+    {
+	return snapshots.reload(num);
+    }
+
+
+    vector<unsigned int>
+    Snapper::getOutdatedSnapshots() const
+    {
+	return snapshots.outdated();
+    }
+
+
     ConfigInfo
     Snapper::getConfig(const string& config_name, const string& root_prefix)
     {
@@ -441,6 +464,20 @@ namespace snapper
 	    }
 	}
 
+	try
+	{
+	    // The infos dir must be empty for some filesystems, so remove
+	    // the snapshot catalog and the selinux marker.
+
+	    SDir infos_dir = snapper->openInfosDir();
+	    infos_dir.unlink("catalog", 0);
+	    infos_dir.unlink("selinux-verified", 0);
+	}
+	catch (const Exception& e)
+	{
+	    SN_CAUGHT(e);
+	}
+
 	try
 	{
 	    snapper->getFilesystem()->deleteConfig();
@@ -884,6 +921,107 @@ namespace snapper
     }
 
 
+#ifdef ENABLE_SELINUX
+
+    /*
+     * The selinux marker file in the infos dir records which info dirs
+     * have verified labels together with a stamp of the policy files. An
+     * info dir is only relabeled if it is new, its mtime changed (e.g. a
+     * filelist or the info.xml was written) or the policy changed.
+     */
+    static const char* selinux_marker_name = "selinux-verified";
+    static const char* selinux_marker_header = "snapper-selinux-verified 1";
+
+
+    static string
+    selinux_policy_stamp(bool skip_snapshot_dir)
+    {
+	string stamp = skip_snapshot_dir ? "skip" : "all";
+
+	for (const char* path : { selinux_file_context_path(), selinux_snapperd_contexts_path() })
+	{
+	    struct stat fs;
+	    if (path && stat(path, &fs) == 0)
+		stamp += sformat(" %llu:%lld:%lld.%09ld", (unsigned long long) fs.st_ino,
+				 (long long) fs.st_size, (long long) fs.st_mtim.tv_sec,
+				 fs.st_mtim.tv_nsec);
+	    else
+		stamp += " -";
+	}
+
+	return stamp;
+    }
+
+
+    static string
+    selinux_info_dir_stamp(const SDir& infos_dir, const string& name)
+    {
+	struct stat fs;
+	if (infos_dir.stat(name, &fs, AT_SYMLINK_NOFOLLOW) != 0 || !S_ISDIR(fs.st_mode))
+	    return "";
+
+	return sformat("%llu:%lld.%09ld", (unsigned long long) fs.st_ino,
+		       (long long) fs.st_mtim.tv_sec, fs.st_mtim.tv_nsec);
+    }
+
+
+    static void
+    read_selinux_marker(const SDir& infos_dir, const string& policy_stamp,
+			map<string, string>& verified)
+    {
+	int fd = infos_dir.open(selinux_marker_name, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+	if (fd < 0)
+	    return;
+
+	AsciiFileReader asciifile(fd);
+
+	string line;
+	if (!asciifile.getline(line) || line != selinux_marker_header)
+	    return;
+
+	if (!asciifile.getline(line) || line != policy_stamp)
+	{
+	    y2mil("selinux policy changed");
+	    return;
+	}
+
+	while (asciifile.getline(line))
+	{
+	    string::size_type pos = line.find('\t');
+	    if (pos != string::npos)
+		verified[line.substr(0, pos)] = line.substr(pos + 1);
+	}
+    }
+
+
+    static void
+    write_selinux_marker(const SDir& infos_dir, const string& policy_stamp,
+			 const map<string, string>& verified)
+    {
+	string tmp_name = string(selinux_marker_name) + ".tmp-XXXXXX";
+
+	FILE* file = fdopen(infos_dir.mktemp(tmp_name), "w");
+	if (!file)
+	{
+	    y2war("mkstemp failed errno:" << errno << " (" << stringerror(errno) << ")");
+	    return;
+	}
+
+	fprintf(file, "%s\n%s\n", selinux_marker_header, policy_stamp.c_str());
+
+	for (const map<string, string>::value_type& value : verified)
+	    fprintf(file, "%s\t%s\n", value.first.c_str(), value.second.c_str());
+
+	if (fclose(file) != 0 || infos_dir.rename(tmp_name, selinux_marker_name) != 0)
+	{
+	    y2war("writing selinux marker failed errno:" << errno << " (" << stringerror(errno) << ")");
+	    infos_dir.unlink(tmp_name, 0);
+	}
+    }
+
+#endif
+
+
     void
     Snapper::syncSelinuxContextsInInfosDir(bool skip_snapshot_dir) const
     {
@@ -895,34 +1033,83 @@ namespace snapper
 
 	SDir infos_dir = openInfosDir();
 
+	string policy_stamp = selinux_policy_stamp(skip_snapshot_dir);
+
+	map<string, string> old_verified;
+	read_selinux_marker(infos_dir, policy_stamp, old_verified);
+
+	map<string, string> verified;
+
+	vector<string> outdated;
+	vector<string> stamps;
+
 	vector<string> infos = infos_dir.entries();
 	for (vector<string>::const_iterator it1 = infos.begin(); it1 != infos.end(); ++it1)
 	{
 	    if (!rx.match(*it1))
 		continue;
 
-	    SDir info_dir(infos_dir, *it1);
-	    info_dir.restorecon(selabel_handle);
-
-	    SFile info(info_dir, "info.xml");
-	    info.restorecon(selabel_handle);
+	    string stamp = selinux_info_dir_stamp(infos_dir, *it1);
+	    if (stamp.empty())
+		continue;
 
-	    if (!skip_snapshot_dir)
+	    map<string, string>::const_iterator it2 = old_verified.find(*it1);
+	    if (it2 != old_verified.end() && it2->second == stamp)
 	    {
-		SFile snapshot_dir(info_dir, "snapshot");
-		snapshot_dir.restorecon(selabel_handle);
+		verified.insert(*it2);
+		continue;
 	    }
 
-	    vector<string> info_content = info_dir.entries();
-	    for (vector<string>::const_iterator it2 = info_content.begin(); it2 != info_content.end(); ++it2)
+	    outdated.push_back(*it1);
+	    stamps.push_back(stamp);
+	}
+
+	y2mil("relabeling " << outdated.size() << " of " << verified.size() + outdated.size() <<
+	      " info dirs");
+
+	vector<char> done(outdated.size(), false);
+
+	parallel_for(outdated.size(), 64, [&](size_t i) {
+	    try
 	    {
-		if (!rx_filelist.match(*it2))
-		    continue;
+		SDir info_dir(infos_dir, outdated[i]);
+		info_dir.restorecon(selabel_handle);
+
+		SFile info(info_dir, "info.xml");
+		info.restorecon(selabel_handle);
+
+		if (!skip_snapshot_dir)
+		{
+		    SFile snapshot_dir(info_dir, "snapshot");
+		    snapshot_dir.restorecon(selabel_handle);
+		}
+
+		vector<string> info_content = info_dir.entries();
+		for (vector<string>::const_iterator it2 = info_content.begin(); it2 != info_content.end(); ++it2)
+		{
+		    if (!rx_filelist.match(*it2))
+			continue;
+
+		    SFile fl(info_dir, *it2);
+		    fl.restorecon(selabel_handle);
+		}
 
-		SFile fl(info_dir, *it2);
-		fl.restorecon(selabel_handle);
+		// Failures are not retried until the policy changes.
+
+		done[i] = true;
 	    }
-	}
+	    catch (const Exception& e)
+	    {
+		y2err("relabeling " << outdated[i] << " failed");
+	    }
+	});
+
+	for (size_t i = 0; i < outdated.size(); ++i)
+	    if (done[i])
+		verified[outdated[i]] = stamps[i];
+
+	if (verified != old_verified)
+	    write_selinux_marker(infos_dir, policy_stamp, verified);
 #endif
     }
 
@@ -1012,6 +1199,11 @@ namespace snapper
 #endif
 	    "ext4,"
 
+#ifndef ENABLE_REFLINK
+	    "no-"
+#endif
+	    "reflink,"
+
 #ifndef ENABLE_XATTRS
 	    "no-"
 #endif
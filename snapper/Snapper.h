@@ -26,6 +26,7 @@
 
 
 #include <vector>
+#include <functional>
 #include <boost/noncopyable.hpp>
 
 #include "snapper/Snapshot.h"
@@ -107,6 +108,11 @@ namespace snapper
 	explicit FreeSpaceException(const char* msg) : Exception(msg) {}
     };
 
+    struct InvalidCleanupAlgorithmException : public Exception
+    {
+	explicit InvalidCleanupAlgorithmException() : Exception("invalid cleanup algorithm") {}
+    };
+
 
     struct QuotaData
     {
@@ -121,6 +127,31 @@ namespace snapper
     };
 
 
+    /**
+     * Predicate for Snapper::cleanup(). Snapshots for which the predicate
+     * returns false are never deleted.
+     */
+    typedef std::function<bool(unsigned int num)> cleanup_pred_t;
+
+    /**
+     * Callback for Snapper::cleanup(). Called with the numbers of the
+     * snapshots deleted in one batch.
+     */
+    typedef std::function<void(const vector<unsigned int>& nums)> cleanup_cb_t;
+
+    /**
+     * Guard for Snapper::cleanup(). Called with a function accessing the
+     * snapshots, e.g. calculating the candidates or deleting one batch
+     * and calling the callback, which the guard must run. Allows the
+     * caller to lock the snapshots only for that time and not during the
+     * quota rescans in between.
+     */
+    typedef std::function<void(const std::function<void()>& func)> cleanup_guard_t;
+
+
+    class ChangeJournal;
+
+
     class Snapper : private boost::noncopyable
     {
     public:
@@ -150,6 +181,36 @@ namespace snapper
 
 	void deleteSnapshot(Snapshots::iterator snapshot);
 
+	/**
+	 * Delete several snapshots at once. Compared to deleting the
+	 * snapshots one by one the filelists of the other snapshots are
+	 * cleaned up in one pass and the hooks are only run once. A snapshot
+	 * given several times is only deleted once.
+	 */
+	void deleteSnapshots(const vector<Snapshots::iterator>& snapshots);
+
+	/**
+	 * Run the cleanup algorithm, one of "number", "timeline" and
+	 * "empty-pre-post". The snapshots to delete are calculated upfront
+	 * and deleted in batches, see deleteSnapshots().
+	 */
+	void cleanup(const string& algorithm, cleanup_pred_t pred, cleanup_cb_t cb,
+		     cleanup_guard_t guard = nullptr);
+
+	/**
+	 * Reload a single snapshot, e.g. after it was created, modified or
+	 * deleted by another program. Iterators to other snapshots stay
+	 * valid.
+	 */
+	SnapshotChange reloadSnapshot(unsigned int num);
+
+	/**
+	 * Return the numbers of the snapshots whose entries in the catalog
+	 * differ from the loaded snapshots, e.g. since another program
+	 * changed them. Should be followed by reloadSnapshot().
+	 */
+	vector<unsigned int> getOutdatedSnapshots() const;
+
 	const vector<string>& getIgnorePatterns() const { return ignore_patterns; }
 
 	static ConfigInfo getConfig(const string& config_name, const string& root_prefix);
@@ -164,6 +225,13 @@ namespace snapper
 
 	const Filesystem* getFilesystem() const { return filesystem; }
 
+	/**
+	 * Set the journal of changes of the subvolume, see ChangeJournal.
+	 * The journal must outlive the snapper object.
+	 */
+	void setChangeJournal(ChangeJournal* change_journal) { Snapper::change_journal = change_journal; }
+	ChangeJournal* getChangeJournal() const { return change_journal; }
+
 	const ConfigInfo& getConfigInfo() { return *config_info; }
 	void setConfigInfo(const map<string, string>& raw);
 
@@ -214,6 +282,8 @@ namespace snapper
 
 	SelinuxLabelHandle* selabel_handle;
 
+	ChangeJournal* change_journal;
+
     };
 
 }
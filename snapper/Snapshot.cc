@@ -30,6 +30,7 @@
 #include <dirent.h>
 #include <errno.h>
 #include <string.h>
+#include <set>
 #include <boost/algorithm/string.hpp>
 
 #include "snapper/Snapshot.h"
@@ -44,11 +45,14 @@
 #include "snapper/Exception.h"
 #include "snapper/Regex.h"
 #include "snapper/Hooks.h"
+#include "snapper/AsciiFile.h"
+#include "snapper/ChangeJournal.h"
 
 
 namespace snapper
 {
     using std::list;
+    using std::set;
 
 
     std::ostream& operator<<(std::ostream& s, const Snapshot& snapshot)
@@ -182,95 +186,418 @@ namespace snapper
     }
 
 
-    void
-    Snapshots::read()
+    struct Snapshots::CatalogEntry
     {
-	Regex rx("^[0-9]+$");
+	CatalogEntry(const string& stamp, const Snapshot& snapshot)
+	    : stamp(stamp), snapshot(snapshot) {}
 
-	SDir infos_dir = snapper->openInfosDir();
+	string stamp;
+	Snapshot snapshot;
+    };
 
-	vector<string> infos = infos_dir.entries();
-	for (vector<string>::const_iterator it1 = infos.begin(); it1 != infos.end(); ++it1)
+
+    static const char* catalog_name = "catalog";
+    static const char* catalog_header = "snapper-catalog 1";
+
+
+    /*
+     * Returns a string identifying the content of the info.xml file of the
+     * snapshot or an empty string if the file cannot be stat'ed. Rewriting
+     * info.xml always gives a new inode, ctime and mtime.
+     */
+    static string
+    info_stamp(const SDir& infos_dir, const string& name)
+    {
+	struct stat fs;
+	if (infos_dir.stat(name + "/info.xml", &fs, AT_SYMLINK_NOFOLLOW) != 0 || !S_ISREG(fs.st_mode))
+	    return "";
+
+	return sformat("%llu:%lld:%lld.%09ld:%lld.%09ld", (unsigned long long) fs.st_ino,
+		       (long long) fs.st_size, (long long) fs.st_mtim.tv_sec, fs.st_mtim.tv_nsec,
+		       (long long) fs.st_ctim.tv_sec, fs.st_ctim.tv_nsec);
+    }
+
+
+    static string
+    catalog_escape(const string& in)
+    {
+	string out;
+	out.reserve(in.size());
+
+	for (char c : in)
 	{
-	    if (!rx.match(*it1))
+	    switch (c)
+	    {
+		case '\\': out += "\\\\"; break;
+		case '\t': out += "\\t"; break;
+		case '\n': out += "\\n"; break;
+		default: out += c; break;
+	    }
+	}
+
+	return out;
+    }
+
+
+    static bool
+    catalog_unescape(const string& in, string& out)
+    {
+	out.clear();
+
+	for (string::size_type i = 0; i < in.size(); ++i)
+	{
+	    if (in[i] != '\\')
+	    {
+		out += in[i];
 		continue;
+	    }
 
-	    try
+	    if (++i == in.size())
+		return false;
+
+	    switch (in[i])
 	    {
-		SDir info_dir(infos_dir, *it1);
-		int fd = info_dir.open("info.xml", O_NOFOLLOW | O_CLOEXEC);
-		XmlFile file(fd, "");
+		case '\\': out += '\\'; break;
+		case 't': out += '\t'; break;
+		case 'n': out += '\n'; break;
+		default: return false;
+	    }
+	}
+
+	return true;
+    }
+
+
+    void
+    Snapshots::readCatalog(const SDir& infos_dir, map<string, CatalogEntry>& catalog) const
+    {
+	int fd = infos_dir.open(catalog_name, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+	if (fd < 0)
+	{
+	    if (errno != ENOENT)
+		y2war("opening catalog failed errno:" << errno << " (" << stringerror(errno) << ")");
+	    return;
+	}
+
+	AsciiFileReader asciifile(fd);
 
-		const xmlNode* root = file.getRootElement();
-		const xmlNode* node = getChildNode(root, "snapshot");
+	string line;
+	if (!asciifile.getline(line) || line != catalog_header)
+	{
+	    y2war("unknown catalog format");
+	    return;
+	}
+
+	// Fields: name, stamp, type, num, date, uid, pre_num, description,
+	// cleanup and pairs of userdata key and value. An invalid line is
+	// ignored, the snapshot is then read from its info.xml.
+
+	while (asciifile.getline(line))
+	{
+	    vector<string> fields;
+	    boost::split(fields, line, boost::is_any_of("\t"), boost::token_compress_off);
+
+	    if (fields.size() < 9 || fields.size() % 2 != 1)
+		continue;
 
+	    bool valid = true;
+
+	    for (string& field : fields)
+	    {
 		string tmp;
+		if (!(valid = catalog_unescape(field, tmp)))
+		    break;
+		field.swap(tmp);
+	    }
 
-		SnapshotType type;
-		if (!getChildValue(node, "type", tmp) || !toValue(tmp, type, true))
-		{
-		    y2err("type missing or invalid. not adding snapshot " << *it1);
-		    continue;
-		}
+	    if (!valid)
+		continue;
 
-		unsigned int num;
-		if (!getChildValue(node, "num", num) || num == 0)
-		{
-		    y2err("num missing or invalid. not adding snapshot " << *it1);
-		    continue;
-		}
+	    SnapshotType type;
+	    if (!toValue(fields[2], type, false))
+		continue;
 
-		time_t date;
-		if (!getChildValue(node, "date", tmp) || (date = scan_datetime(tmp, true)) == (time_t)(-1))
-		{
-		    y2err("date missing or invalid. not adding snapshot " << *it1);
+	    unsigned int num = 0;
+	    fields[3] >> num;
+	    if (num == 0 || fields[0] != decString(num))
+		continue;
+
+	    long long date = -1;
+	    fields[4] >> date;
+
+	    Snapshot snapshot(snapper, type, num, date);
+	    fields[5] >> snapshot.uid;
+	    fields[6] >> snapshot.pre_num;
+	    snapshot.description = fields[7];
+	    snapshot.cleanup = fields[8];
+
+	    for (size_t i = 9; i < fields.size(); i += 2)
+		snapshot.userdata[fields[i]] = fields[i + 1];
+
+	    catalog.emplace(fields[0], CatalogEntry(fields[1], snapshot));
+	}
+    }
+
+
+    void
+    Snapshots::writeCatalog() const
+    {
+	try
+	{
+	    SDir infos_dir = snapper->openInfosDir();
+
+	    string tmp_name = string(catalog_name) + ".tmp-XXXXXX";
+
+	    FILE* file = fdopen(infos_dir.mktemp(tmp_name), "w");
+	    if (!file)
+		SN_THROW(IOErrorException(sformat("mkstemp failed errno:%d (%s)", errno,
+						  stringerror(errno).c_str())));
+
+	    fprintf(file, "%s\n", catalog_header);
+
+	    for (const_iterator it = begin(); it != end(); ++it)
+	    {
+		if (it->isCurrent())
 		    continue;
-		}
 
-		Snapshot snapshot(snapper, type, num, date);
+		string name = decString(it->num);
 
-		*it1 >> num;
-		if (num != snapshot.num)
-		{
-		    y2err("num mismatch. not adding snapshot " << *it1);
+		string stamp = info_stamp(infos_dir, name);
+		if (stamp.empty())
 		    continue;
-		}
 
-		getChildValue(node, "uid", snapshot.uid);
+		fprintf(file, "%s\t%s\t%s\t%u\t%lld\t%u\t%u\t%s\t%s", name.c_str(), stamp.c_str(),
+			toString(it->type).c_str(), it->num, (long long) it->date,
+			(unsigned int) it->uid, it->pre_num, catalog_escape(it->description).c_str(),
+			catalog_escape(it->cleanup).c_str());
+
+		for (map<string, string>::const_iterator it2 = it->userdata.begin();
+		     it2 != it->userdata.end(); ++it2)
+		    fprintf(file, "\t%s\t%s", catalog_escape(it2->first).c_str(),
+			    catalog_escape(it2->second).c_str());
+
+		fprintf(file, "\n");
+	    }
+
+	    if (fclose(file) != 0)
+	    {
+		infos_dir.unlink(tmp_name, 0);
+		SN_THROW(IOErrorException(sformat("writing catalog failed errno:%d (%s)", errno,
+						  stringerror(errno).c_str())));
+	    }
+
+	    if (infos_dir.rename(tmp_name, catalog_name) != 0)
+	    {
+		infos_dir.unlink(tmp_name, 0);
+		SN_THROW(IOErrorException(sformat("rename catalog failed errno:%d (%s)", errno,
+						  stringerror(errno).c_str())));
+	    }
+	}
+	catch (const Exception& e)
+	{
+	    SN_CAUGHT(e);
+
+	    // The catalog is only a cache, see readCatalog().
+
+	    y2war("writing catalog failed");
+	}
+    }
+
+
+    bool
+    Snapshots::readInfo(const SDir& infos_dir, const string& name, Snapshot& snapshot) const
+    {
+	SDir info_dir(infos_dir, name);
+	int fd = info_dir.open("info.xml", O_NOFOLLOW | O_CLOEXEC);
+	if (fd < 0)
+	    SN_THROW(IOErrorException(sformat("open info.xml failed infoDir:%s errno:%d (%s)",
+					      info_dir.fullname().c_str(), errno,
+					      stringerror(errno).c_str())));
+
+	XmlTextReader reader(fd, "");
+
+	// Like getChildValue() only the first occurrence of an element is
+	// used. Like before, for userdata the last value of a key wins.
+
+	map<string, string> values;
+	map<string, string> userdata;
+
+	bool in_snapshot = false;
+	bool in_userdata = false;
+	string key, value;
+
+	int depth;
+	string element;
+	while (reader.nextElement(depth, element))
+	{
+	    if (depth == 0)
+	    {
+		in_snapshot = element == "snapshot";
+		continue;
+	    }
+
+	    if (!in_snapshot)
+		continue;
+
+	    if (depth == 1)
+	    {
+		if (in_userdata && !key.empty())
+		    userdata[key] = value;
+
+		in_userdata = element == "userdata";
+		key.clear();
+		value.clear();
+
+		if (!in_userdata)
+		    values.emplace(element, reader.readString());
+	    }
+	    else if (depth == 2 && in_userdata)
+	    {
+		if (element == "key")
+		    key = reader.readString();
+		else if (element == "value")
+		    value = reader.readString();
+	    }
+	}
+
+	if (in_userdata && !key.empty())
+	    userdata[key] = value;
+
+	map<string, string>::const_iterator it;
+
+	SnapshotType type;
+	if ((it = values.find("type")) == values.end() || !toValue(it->second, type, true))
+	{
+	    y2err("type missing or invalid. not adding snapshot " << name);
+	    return false;
+	}
+
+	unsigned int num = 0;
+	if ((it = values.find("num")) != values.end())
+	    it->second >> num;
+	if (num == 0)
+	{
+	    y2err("num missing or invalid. not adding snapshot " << name);
+	    return false;
+	}
+
+	time_t date;
+	if ((it = values.find("date")) == values.end() ||
+	    (date = scan_datetime(it->second, true)) == (time_t)(-1))
+	{
+	    y2err("date missing or invalid. not adding snapshot " << name);
+	    return false;
+	}
+
+	snapshot = Snapshot(snapper, type, num, date);
+
+	name >> num;
+	if (num != snapshot.num)
+	{
+	    y2err("num mismatch. not adding snapshot " << name);
+	    return false;
+	}
+
+	if ((it = values.find("uid")) != values.end())
+	    it->second >> snapshot.uid;
+
+	if ((it = values.find("pre_num")) != values.end())
+	    it->second >> snapshot.pre_num;
+
+	if ((it = values.find("description")) != values.end())
+	    snapshot.description = it->second;
+
+	if ((it = values.find("cleanup")) != values.end())
+	    snapshot.cleanup = it->second;
+
+	snapshot.userdata = userdata;
+
+	return true;
+    }
+
+
+    void
+    Snapshots::read()
+    {
+	Regex rx("^[0-9]+$");
+
+	SDir infos_dir = snapper->openInfosDir();
+
+	map<string, CatalogEntry> catalog;
+	readCatalog(infos_dir, catalog);
+
+	list<Snapshot> tmp;
 
-		getChildValue(node, "pre_num", snapshot.pre_num);
+	vector<string> uncached;
 
-		getChildValue(node, "description", snapshot.description);
+	vector<string> infos = infos_dir.entries();
+	for (vector<string>::const_iterator it1 = infos.begin(); it1 != infos.end(); ++it1)
+	{
+	    if (!rx.match(*it1))
+		continue;
 
-		getChildValue(node, "cleanup", snapshot.cleanup);
+	    string stamp = info_stamp(infos_dir, *it1);
 
-		const list<const xmlNode*> l = getChildNodes(node, "userdata");
-		for (list<const xmlNode*>::const_iterator it2 = l.begin(); it2 != l.end(); ++it2)
+	    map<string, CatalogEntry>::const_iterator it2 = catalog.find(*it1);
+	    if (!stamp.empty() && it2 != catalog.end() && it2->second.stamp == stamp)
+		tmp.push_back(it2->second.snapshot);
+	    else
+		uncached.push_back(*it1);
+	}
+
+	size_t num_cached = tmp.size();
+
+	// Read the info.xml files not in the catalog with several threads.
+	// The order does not matter since the entries are sorted below.
+
+	if (!uncached.empty())
+	{
+	    vector<Snapshot> snapshots(uncached.size(), Snapshot(snapper, SINGLE, 0, (time_t)(-1)));
+	    vector<char> valid(uncached.size(), false);
+
+	    // libxml2 must be initialized before it is used by several threads.
+
+	    xmlInitParser();
+
+	    parallel_for(uncached.size(), 64, [&](size_t i) {
+		try
 		{
-		    string key, value;
-		    getChildValue(*it2, "key", key);
-		    getChildValue(*it2, "value", value);
-		    if (!key.empty())
-			snapshot.userdata[key] = value;
+		    valid[i] = readInfo(infos_dir, uncached[i], snapshots[i]);
 		}
-
-		if (!snapper->getFilesystem()->checkSnapshot(snapshot.num))
+		catch (const Exception& e)
 		{
-		    y2err("snapshot check failed. not adding snapshot " << *it1);
-		    continue;
+		    y2err("loading " << uncached[i] << " failed");
 		}
+	    });
 
-		entries.push_back(snapshot);
-	    }
-	    catch (const IOErrorException& e)
+	    for (size_t i = 0; i < uncached.size(); ++i)
+		if (valid[i])
+		    tmp.push_back(snapshots[i]);
+	}
+
+	vector<unsigned int> nums;
+	for (const Snapshot& snapshot : tmp)
+	    nums.push_back(snapshot.num);
+
+	set<unsigned int> valid_nums = snapper->getFilesystem()->checkSnapshots(nums);
+
+	for (const Snapshot& snapshot : tmp)
+	{
+	    if (valid_nums.find(snapshot.num) == valid_nums.end())
 	    {
-		y2err("loading " << *it1 << " failed");
+		y2err("snapshot check failed. not adding snapshot " << snapshot.num);
+		continue;
 	    }
+
+	    entries.push_back(snapshot);
 	}
 
 	entries.sort();
 
-	y2mil("found " << entries.size() << " snapshots");
+	y2mil("found " << entries.size() << " snapshots (" << num_cached << " from catalog)");
+
+	if (!uncached.empty() || num_cached != catalog.size())
+	    writeCatalog();
     }
 
 
@@ -291,10 +618,7 @@ namespace snapper
 
 		case PRE:
 		{
-		    int n = 0;
-		    for (const_iterator i2 = begin(); i2 != end(); ++i2)
-			if (i2->pre_num == i1->num)
-			    n++;
+		    size_t n = post_index.count(i1->num);
 		    if (n > 1)
 			y2err("pre-num " << i1->num << " has " << n << " post-nums");
 		}
@@ -363,6 +687,8 @@ namespace snapper
 	    y2err("reading failed");
 	}
 
+	rebuildIndex();
+
 	check();
     }
 
@@ -373,13 +699,8 @@ namespace snapper
 	if (pre == entries.end() || pre->isCurrent() || pre->getType() != PRE)
 	    SN_THROW(IllegalSnapshotException());
 
-	for (iterator it = begin(); it != end(); ++it)
-	{
-	    if (it->getType() == POST && it->getPreNum() == pre->getNum())
-		return it;
-	}
-
-	return end();
+	std::multimap<unsigned int, iterator>::const_iterator it = post_index.find(pre->getNum());
+	return it != post_index.end() ? it->second : end();
     }
 
 
@@ -389,13 +710,8 @@ namespace snapper
 	if (pre == entries.end() || pre->isCurrent() || pre->getType() != PRE)
 	    SN_THROW(IllegalSnapshotException());
 
-	for (const_iterator it = begin(); it != end(); ++it)
-	{
-	    if (it->getType() == POST && it->getPreNum() == pre->getNum())
-		return it;
-	}
-
-	return end();
+	std::multimap<unsigned int, iterator>::const_iterator it = post_index.find(pre->getNum());
+	return it != post_index.end() ? it->second : end();
     }
 
 
@@ -665,6 +981,15 @@ namespace snapper
 	// parent == end indicates the btrfs default subvolume. Unclean, but
 	// adding a special snapshot like current needs too many API changes.
 
+	// Read-only snapshots of the current system restart the change
+	// journal. Until endSnapshot() the journal is not used.
+
+	ChangeJournal* change_journal = parent != end() && parent->isCurrent() && read_only &&
+	    !empty ? snapper->getChangeJournal() : nullptr;
+
+	if (change_journal)
+	    change_journal->beginSnapshot();
+
 	try
 	{
 	    if (parent != end())
@@ -676,6 +1001,9 @@ namespace snapper
 	{
 	    SN_CAUGHT(e);
 
+	    if (change_journal)
+		change_journal->abortSnapshot();
+
 	    SDir infos_dir = snapper->openInfosDir();
 	    infos_dir.unlink(decString(snapshot.getNum()), AT_REMOVEDIR);
 
@@ -690,6 +1018,9 @@ namespace snapper
 	{
 	    SN_CAUGHT(e);
 
+	    if (change_journal)
+		change_journal->abortSnapshot();
+
 	    snapshot.deleteFilesystemSnapshot();
 	    SDir infos_dir = snapper->openInfosDir();
 	    infos_dir.unlink(decString(snapshot.getNum()), AT_REMOVEDIR);
@@ -697,16 +1028,29 @@ namespace snapper
 	    SN_RETHROW(e);
 	}
 
+	if (change_journal)
+	    change_journal->endSnapshot(snapshot.getNum(), snapshot.getDate());
+
 	Hooks::create_snapshot(snapper->subvolumeDir(), snapper->getFilesystem());
 
-	return entries.insert(entries.end(), snapshot);
+	iterator ret = entries.insert(entries.end(), snapshot);
+	addToIndex(ret);
+
+	writeCatalog();
+
+	return ret;
     }
 
 
+    // Files in the info dir referring to another snapshot: the filelists
+    // and the undo journals, see UndoJournal.
+
     static bool
     is_filelist_file(unsigned char type, const char* name)
     {
-	return (type == DT_UNKNOWN || type == DT_REG) && (fnmatch("filelist-*.txt", name, 0) == 0);
+	return (type == DT_UNKNOWN || type == DT_REG) && (fnmatch("filelist-*.txt", name, 0) == 0 ||
+							  fnmatch("undo-*.txt", name, 0) == 0 ||
+							  fnmatch("undo-*.log", name, 0) == 0);
     }
 
 
@@ -724,6 +1068,8 @@ namespace snapper
 
 	snapshot->writeInfo();
 
+	writeCatalog();
+
 	Hooks::modify_snapshot(snapper->subvolumeDir(), snapper->getFilesystem());
     }
 
@@ -731,40 +1077,226 @@ namespace snapper
     void
     Snapshots::deleteSnapshot(iterator snapshot)
     {
-	if (snapshot == entries.end() || snapshot->isCurrent() || snapshot->isDefault() ||
-	    snapshot->isActive())
-	    SN_THROW(IllegalSnapshotException());
+	deleteSnapshots({ snapshot });
+    }
 
-	snapshot->deleteFilesystemSnapshot();
 
-	SDir info_dir = snapshot->openInfoDir();
+    void
+    Snapshots::deleteSnapshots(const vector<iterator>& tmp)
+    {
+	for (const_iterator snapshot : tmp)
+	{
+	    if (snapshot == entries.end() || snapshot->isCurrent() || snapshot->isDefault() ||
+		snapshot->isActive())
+		SN_THROW(IllegalSnapshotException());
+	}
+
+	// A snapshot given several times is only deleted once.
 
-	info_dir.unlink("info.xml", 0);
+	vector<iterator> snapshots;
+	set<unsigned int> nums;
 
-	vector<string> tmp1 = info_dir.entries(is_filelist_file);
-	for (vector<string>::const_iterator it = tmp1.begin(); it != tmp1.end(); ++it)
+	for (iterator snapshot : tmp)
 	{
-	    info_dir.unlink(*it, 0);
+	    if (nums.insert(snapshot->getNum()).second)
+		snapshots.push_back(snapshot);
 	}
 
+	// First delete the filesystem snapshots and everything in their info
+	// dirs. If that fails for one snapshot the bookkeeping below is still
+	// done for the snapshots deleted so far.
+
+	vector<iterator> deleted;
+
+	try
+	{
+	    for (iterator snapshot : snapshots)
+	    {
+		snapshot->deleteFilesystemSnapshot();
+
+		SDir info_dir = snapshot->openInfoDir();
+
+		info_dir.unlink("info.xml", 0);
+
+		vector<string> tmp1 = info_dir.entries(is_filelist_file);
+		for (vector<string>::const_iterator it = tmp1.begin(); it != tmp1.end(); ++it)
+		{
+		    info_dir.unlink(*it, 0);
+		}
+
+		deleted.push_back(snapshot);
+	    }
+	}
+	catch (const Exception& e)
+	{
+	    SN_CAUGHT(e);
+
+	    removeInfos(deleted);
+
+	    SN_RETHROW(e);
+	}
+
+	removeInfos(deleted);
+    }
+
+
+    void
+    Snapshots::removeInfos(const vector<iterator>& deleted)
+    {
+	if (deleted.empty())
+	    return;
+
+	set<unsigned int> nums;
+	set<string> filelists;
+	for (const_iterator snapshot : deleted)
+	{
+	    nums.insert(snapshot->getNum());
+	    filelists.insert("filelist-" + decString(snapshot->getNum()) + ".txt");
+	    filelists.insert("undo-" + decString(snapshot->getNum()) + ".txt");
+	    filelists.insert("undo-" + decString(snapshot->getNum()) + ".log");
+	}
+
+	// Remove the filelists and undo journals referring to the deleted
+	// snapshots from the info dirs of all other snapshots in one pass.
+
 	for (Snapshots::iterator it = begin(); it != end(); ++it)
 	{
-	    if (!it->isCurrent())
+	    if (it->isCurrent() || nums.find(it->getNum()) != nums.end())
+		continue;
+
+	    SDir tmp2 = it->openInfoDir();
+
+	    vector<string> tmp3 = tmp2.entries(is_filelist_file);
+	    for (vector<string>::const_iterator it2 = tmp3.begin(); it2 != tmp3.end(); ++it2)
 	    {
-		SDir tmp2 = it->openInfoDir();
-		tmp2.unlink("filelist-" + decString(snapshot->getNum()) + ".txt", 0);
+		if (filelists.find(*it2) != filelists.end())
+		    tmp2.unlink(*it2, 0);
 	    }
 	}
 
 	SDir infos_dir = snapper->openInfosDir();
-	infos_dir.unlink(decString(snapshot->getNum()), AT_REMOVEDIR);
 
-	entries.erase(snapshot);
+	for (iterator snapshot : deleted)
+	{
+	    infos_dir.unlink(decString(snapshot->getNum()), AT_REMOVEDIR);
+
+	    removeFromIndex(snapshot);
+	    entries.erase(snapshot);
+	}
+
+	writeCatalog();
 
 	Hooks::delete_snapshot(snapper->subvolumeDir(), snapper->getFilesystem());
     }
 
 
+    static bool
+    equal_info(const Snapshot& lhs, const Snapshot& rhs)
+    {
+	return lhs.getType() == rhs.getType() && lhs.getDate() == rhs.getDate() &&
+	    lhs.getUid() == rhs.getUid() && lhs.getPreNum() == rhs.getPreNum() &&
+	    lhs.getDescription() == rhs.getDescription() && lhs.getCleanup() == rhs.getCleanup() &&
+	    lhs.getUserdata() == rhs.getUserdata();
+    }
+
+
+    SnapshotChange
+    Snapshots::reload(unsigned int num)
+    {
+	if (num == 0)
+	    return SNAPSHOT_UNCHANGED;
+
+	Snapshot snapshot(snapper, SINGLE, 0, (time_t)(-1));
+	bool valid = false;
+
+	try
+	{
+	    SDir infos_dir = snapper->openInfosDir();
+
+	    struct stat fs;
+	    if (infos_dir.stat(decString(num), &fs, AT_SYMLINK_NOFOLLOW) == 0)
+		valid = readInfo(infos_dir, decString(num), snapshot) &&
+		    snapper->getFilesystem()->checkSnapshot(num);
+	}
+	catch (const Exception& e)
+	{
+	    SN_CAUGHT(e);
+	}
+
+	iterator it = find(num);
+
+	if (!valid)
+	{
+	    if (it == end())
+		return SNAPSHOT_UNCHANGED;
+
+	    y2mil("removing snapshot " << num);
+
+	    removeFromIndex(it);
+	    entries.erase(it);
+
+	    return SNAPSHOT_DELETED;
+	}
+
+	if (it == end())
+	{
+	    y2mil("adding snapshot " << num);
+
+	    map<unsigned int, iterator>::const_iterator pos = index.upper_bound(num);
+	    it = entries.insert(pos != index.end() ? pos->second : end(), snapshot);
+	    addToIndex(it);
+
+	    return SNAPSHOT_CREATED;
+	}
+
+	if (equal_info(*it, snapshot))
+	    return SNAPSHOT_UNCHANGED;
+
+	y2mil("updating snapshot " << num);
+
+	// Only the info is updated, the mount state is kept.
+
+	removeFromIndex(it);
+
+	it->type = snapshot.type;
+	it->date = snapshot.date;
+	it->uid = snapshot.uid;
+	it->pre_num = snapshot.pre_num;
+	it->description = snapshot.description;
+	it->cleanup = snapshot.cleanup;
+	it->userdata = snapshot.userdata;
+
+	addToIndex(it);
+
+	return SNAPSHOT_MODIFIED;
+    }
+
+
+    vector<unsigned int>
+    Snapshots::outdated() const
+    {
+	map<string, CatalogEntry> catalog;
+	readCatalog(snapper->openInfosDir(), catalog);
+
+	set<unsigned int> ret;
+
+	for (const map<string, CatalogEntry>::value_type& value : catalog)
+	{
+	    const_iterator it = find(value.second.snapshot.getNum());
+	    if (it == end() || !equal_info(*it, value.second.snapshot))
+		ret.insert(value.second.snapshot.getNum());
+	}
+
+	for (const_iterator it = begin(); it != end(); ++it)
+	{
+	    if (!it->isCurrent() && catalog.find(decString(it->getNum())) == catalog.end())
+		ret.insert(it->getNum());
+	}
+
+	return vector<unsigned int>(ret.begin(), ret.end());
+    }
+
+
     Snapshots::iterator
     Snapshots::getDefault()
     {
@@ -792,25 +1324,65 @@ namespace snapper
     }
 
 
-    struct num_is
+    void
+    Snapshots::rebuildIndex()
     {
-	num_is(unsigned int num) : num(num) {}
-	bool operator()(const Snapshot& s) const { return s.getNum() == num; }
-	const unsigned int num;
-    };
+	index.clear();
+	post_index.clear();
+
+	for (iterator it = entries.begin(); it != entries.end(); ++it)
+	    addToIndex(it);
+    }
+
+
+    void
+    Snapshots::addToIndex(iterator snapshot)
+    {
+	index.emplace(snapshot->getNum(), snapshot);
+
+	if (snapshot->getType() == POST)
+	    post_index.emplace(snapshot->getPreNum(), snapshot);
+    }
+
+
+    void
+    Snapshots::removeFromIndex(iterator snapshot)
+    {
+	map<unsigned int, iterator>::iterator it1 = index.find(snapshot->getNum());
+	if (it1 != index.end() && it1->second == snapshot)
+	    index.erase(it1);
+
+	if (snapshot->getType() == POST)
+	{
+	    std::pair<std::multimap<unsigned int, iterator>::iterator,
+		      std::multimap<unsigned int, iterator>::iterator> range =
+		post_index.equal_range(snapshot->getPreNum());
+
+	    for (std::multimap<unsigned int, iterator>::iterator it2 = range.first; it2 != range.second; ++it2)
+	    {
+		if (it2->second == snapshot)
+		{
+		    post_index.erase(it2);
+		    break;
+		}
+	    }
+	}
+    }
 
 
     Snapshots::iterator
     Snapshots::find(unsigned int num)
     {
-	return find_if(entries.begin(), entries.end(), num_is(num));
+	map<unsigned int, iterator>::const_iterator it = index.find(num);
+	return it != index.end() ? it->second : end();
     }
 
 
     Snapshots::const_iterator
     Snapshots::find(unsigned int num) const
     {
-	return find_if(entries.begin(), entries.end(), num_is(num));
+	map<unsigned int, iterator>::const_iterator it = index.find(num);
+	return it != index.end() ? it->second : end();
     }
 
 }
@@ -29,6 +29,8 @@
 #include <string>
 #include <list>
 #include <map>
+#include <vector>
+#include <boost/noncopyable.hpp>
 
 #include "snapper/Exception.h"
 
@@ -38,6 +40,7 @@ namespace snapper
     using std::string;
     using std::list;
     using std::map;
+    using std::vector;
 
 
     class Snapper;
@@ -46,6 +49,8 @@ namespace snapper
 
     enum SnapshotType { SINGLE, PRE, POST };
 
+    enum SnapshotChange { SNAPSHOT_UNCHANGED, SNAPSHOT_CREATED, SNAPSHOT_MODIFIED, SNAPSHOT_DELETED };
+
 
     struct CreateSnapshotFailedException : public Exception
     {
@@ -204,7 +209,7 @@ namespace snapper
     };
 
 
-    class Snapshots
+    class Snapshots : private boost::noncopyable
     {
     public:
 
@@ -264,6 +269,19 @@ namespace snapper
 
 	void read();
 
+	bool readInfo(const SDir& infos_dir, const string& name, Snapshot& snapshot) const;
+
+	/*
+	 * The catalog caches the content of all info.xml files in a single
+	 * file in the infos dir. Every entry is only used if the stat data
+	 * of the info.xml file is unchanged, so an outdated or missing
+	 * catalog only costs reading the info.xml files.
+	 */
+	struct CatalogEntry;
+
+	void readCatalog(const SDir& infos_dir, map<string, CatalogEntry>& catalog) const;
+	void writeCatalog() const;
+
 	void check() const;
 
 	void checkUserdata(const map<string, string>& userdata) const;
@@ -280,13 +298,30 @@ namespace snapper
 	void modifySnapshot(iterator snapshot, const SMD& smd);
 
 	void deleteSnapshot(iterator snapshot);
+	void deleteSnapshots(const vector<iterator>& snapshots);
+
+	void removeInfos(const vector<iterator>& deleted);
+
+	SnapshotChange reload(unsigned int num);
+	vector<unsigned int> outdated() const;
 
 	unsigned int nextNumber();
 
+	void rebuildIndex();
+	void addToIndex(iterator snapshot);
+	void removeFromIndex(iterator snapshot);
+
 	const Snapper* snapper;
 
 	list<Snapshot> entries;
 
+	/*
+	 * Indices for find() and findPost(). Since the entries are kept in
+	 * a list the iterators stay valid until the entry is erased.
+	 */
+	map<unsigned int, iterator> index;
+	std::multimap<unsigned int, iterator> post_index;
+
     };
 
 }
@@ -25,6 +25,8 @@
 #include <unistd.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <spawn.h>
+#include <signal.h>
 #include <ostream>
 #include <fstream>
 #include <sys/wait.h>
@@ -44,7 +46,7 @@ namespace snapper
 
 
     SystemCmd::SystemCmd(const string& Command_Cv, bool log_output)
-	: Combine_b(false), log_output(log_output)
+	: Combine_b(false), log_output(log_output), timed_out(false)
 {
     y2mil("constructor SystemCmd:\"" << Command_Cv << "\"");
     init();
@@ -52,6 +54,27 @@ namespace snapper
 }
 
 
+    SystemCmd::SystemCmd(const Args& args, bool log_output)
+	: Combine_b(false), log_output(log_output), timed_out(false)
+    {
+	init();
+
+	Options options;
+	options.log_output = log_output;
+
+	doSpawn(args, options);
+    }
+
+
+    SystemCmd::SystemCmd(const Args& args, const Options& options)
+	: Combine_b(false), log_output(options.log_output), timed_out(false)
+    {
+	init();
+
+	doSpawn(args, options);
+    }
+
+
 void SystemCmd::init()
     {
     File_aC[0] = File_aC[1] = NULL;
@@ -294,6 +317,255 @@ SystemCmd::doExecute( const string& Cmd )
     }
 
 
+    int
+    SystemCmd::doSpawn(const Args& args, const Options& options)
+    {
+	const vector<string>& values = args.get_values();
+
+	lastCmd.clear();
+	for (const string& value : values)
+	    lastCmd += (lastCmd.empty() ? "" : " ") + quote(value);
+
+	y2mil("SystemCmd Executing:\"" << lastCmd << "\"");
+
+	StopWatch stopwatch;
+
+	invalidate();
+
+	if (values.empty() || values[0].empty() || values[0][0] != '/')
+	{
+	    y2err("program must be given with absolute path");
+	    return Ret_i = -1;
+	}
+
+	if (testmode)
+	{
+	    y2mil("TESTMODE would execute \"" << lastCmd << "\"");
+	    return Ret_i = 0;
+	}
+
+	int sout[2];
+	if (pipe2(sout, O_CLOEXEC) < 0)
+	{
+	    y2err("pipe stdout creation failed errno:" << errno << " (" << stringerror(errno) << ")");
+	    return Ret_i = -1;
+	}
+
+	int serr[2];
+	if (pipe2(serr, O_CLOEXEC) < 0)
+	{
+	    y2err("pipe stderr creation failed errno:" << errno << " (" << stringerror(errno) << ")");
+	    close(sout[0]);
+	    close(sout[1]);
+	    return Ret_i = -1;
+	}
+
+	// dup2 clears O_CLOEXEC of the new fds. Other fds must be opened
+	// with O_CLOEXEC, with glibc 2.34 all of them are closed anyway.
+
+	posix_spawn_file_actions_t actions;
+	posix_spawn_file_actions_init(&actions);
+	posix_spawn_file_actions_adddup2(&actions, sout[1], STDOUT_FILENO);
+	posix_spawn_file_actions_adddup2(&actions, serr[1], STDERR_FILENO);
+#if defined(__GLIBC__) && __GLIBC_PREREQ(2, 34)
+	posix_spawn_file_actions_addclosefrom_np(&actions, 3);
+#endif
+
+	vector<char*> argv;
+	for (const string& value : values)
+	    argv.push_back(const_cast<char*>(value.c_str()));
+	argv.push_back(nullptr);
+
+	const vector<const char*> env = make_env();
+
+	int r = posix_spawn(&Pid_i, argv[0], &actions, nullptr, &argv[0],
+			    const_cast<char* const*>(&env[0]));
+
+	posix_spawn_file_actions_destroy(&actions);
+
+	close(sout[1]);
+	close(serr[1]);
+
+	int fds[2] = { sout[0], serr[0] };
+
+	if (r != 0)
+	{
+	    y2err("posix_spawn failed errno:" << r << " (" << stringerror(r) << ")");
+
+	    close(fds[0]);
+	    close(fds[1]);
+
+	    Ret_i = r == ENOENT ? 127 : 126;
+	}
+	else
+	{
+	    int status;
+	    readUntilExit(fds, options, status);
+
+	    Ret_i = decodeStatus(status);
+
+	    if (timed_out)
+	    {
+		y2err("command \"" << lastCmd << "\" killed after " << options.timeout.count() << "ms");
+		Ret_i = -257;
+	    }
+
+	    y2mil("stopwatch " << stopwatch << " for \"" << cmd() << "\"");
+	}
+
+	y2mil("system() Returns:" << Ret_i);
+	if (Ret_i != 0 && log_output)
+	    logOutput();
+
+	return Ret_i;
+    }
+
+
+    void
+    SystemCmd::readUntilExit(int fds[2], const Options& options, int& status)
+    {
+	using namespace std::chrono;
+
+	const steady_clock::time_point deadline = steady_clock::now() + options.timeout;
+
+	struct pollfd pfds[2];
+	string partial[2];
+
+	for (int i = 0; i < 2; ++i)
+	{
+	    fcntl(fds[i], F_SETFL, O_NONBLOCK);
+	    pfds[i].fd = fds[i];
+	    pfds[i].events = POLLIN;
+	}
+
+	bool exited = false;
+
+	while (true)
+	{
+	    // Wait in steps of one second to notice when the program exited
+	    // while a child of it still keeps the pipes open.
+
+	    int timeout_ms = 1000;
+
+	    if (options.timeout != milliseconds(0))
+	    {
+		milliseconds remaining = duration_cast<milliseconds>(deadline - steady_clock::now());
+		if (remaining <= milliseconds(0))
+		{
+		    kill(Pid_i, SIGKILL);
+		    timed_out = true;
+		    break;
+		}
+
+		timeout_ms = std::min<long>(timeout_ms, remaining.count() + 1);
+	    }
+
+	    if (exited || (pfds[0].fd < 0 && pfds[1].fd < 0))
+		break;
+
+	    int r = poll(pfds, 2, timeout_ms);
+	    if (r < 0 && errno != EINTR)
+	    {
+		y2err("poll failed errno:" << errno << " (" << stringerror(errno) << ")");
+		break;
+	    }
+
+	    for (int i = 0; i < 2; ++i)
+	    {
+		if (pfds[i].fd < 0 || pfds[i].revents == 0)
+		    continue;
+
+		char buf[4096];
+		ssize_t n = read(pfds[i].fd, buf, sizeof(buf));
+		if (n > 0)
+		    splitLines((OutputStream) i, buf, n, partial[i], options);
+		else if (n == 0 || (errno != EINTR && errno != EAGAIN))
+		    pfds[i].fd = -1;
+	    }
+
+	    if (r == 0)
+		exited = waitpid(Pid_i, &status, WNOHANG) == Pid_i;
+	}
+
+	// Read what is left if the program exited with the pipes still open.
+
+	for (int i = 0; i < 2; ++i)
+	{
+	    if (pfds[i].fd >= 0 && !timed_out)
+	    {
+		char buf[4096];
+		ssize_t n;
+		while ((n = read(pfds[i].fd, buf, sizeof(buf))) > 0)
+		    splitLines((OutputStream) i, buf, n, partial[i], options);
+	    }
+
+	    if (!partial[i].empty())
+		splitLines((OutputStream) i, "\n", 1, partial[i], options);
+
+	    close(fds[i]);
+	}
+
+	if (!exited)
+	{
+	    while (waitpid(Pid_i, &status, 0) < 0)
+	    {
+		if (errno != EINTR)
+		{
+		    y2err("waitpid failed errno:" << errno << " (" << stringerror(errno) << ")");
+		    status = -1;
+		    break;
+		}
+	    }
+	}
+    }
+
+
+    void
+    SystemCmd::splitLines(OutputStream stream, const char* buf, size_t len, string& partial,
+			  const Options& options)
+    {
+	const char* end = buf + len;
+
+	while (buf != end)
+	{
+	    const char* p = static_cast<const char*>(memchr(buf, '\n', end - buf));
+	    if (!p)
+	    {
+		partial.append(buf, end);
+		break;
+	    }
+
+	    partial.append(buf, p);
+
+	    if (options.line_callback)
+		options.line_callback(stream, partial);
+	    else
+		addLine(partial, Lines_aC[stream]);
+
+	    partial.clear();
+	    buf = p + 1;
+	}
+    }
+
+
+    int
+    SystemCmd::decodeStatus(int status)
+    {
+	if (status != -1 && WIFEXITED(status))
+	{
+	    int ret = WEXITSTATUS(status);
+	    if (ret == 126)
+		y2err("command \"" << lastCmd << "\" not executable");
+	    else if (ret == 127)
+		y2err("command \"" << lastCmd << "\" not found");
+	    return ret;
+	}
+
+	y2err("command \"" << lastCmd << "\" failed");
+	return -127;
+    }
+
+
 bool
 SystemCmd::doWait( bool Hang_bv, int& Ret_ir )
     {
@@ -329,19 +601,7 @@ SystemCmd::doWait( bool Hang_bv, int& Ret_ir )
 	    fclose( File_aC[IDX_STDERR] );
 	    File_aC[IDX_STDERR] = NULL;
 	    }
-	if (WIFEXITED(Status_ii))
-	{
-	    Ret_ir = WEXITSTATUS(Status_ii);
-	    if (Ret_ir == 126)
-		y2err("command \"" << lastCmd << "\" not executable");
-	    else if (Ret_ir == 127)
-		y2err("command \"" << lastCmd << "\" not found");
-	}
-	else
-	{
-	    Ret_ir = -127;
-	    y2err("command \"" << lastCmd << "\" failed");
-	}
+	Ret_ir = decodeStatus(Status_ii);
 	}
 
     y2deb("Wait:" << Wait_ii << " pid:" << Pid_i << " stat:" << Status_ii <<
@@ -30,6 +30,9 @@
 #include <string>
 #include <vector>
 #include <list>
+#include <chrono>
+#include <functional>
+#include <initializer_list>
 #include <boost/noncopyable.hpp>
 
 
@@ -45,8 +48,58 @@ namespace snapper
 
 	enum OutputStream { IDX_STDOUT, IDX_STDERR };
 
+	/**
+	 * Program and arguments of a command executed without a shell.
+	 */
+	class Args
+	{
+	public:
+
+	    Args() : values() {}
+	    Args(std::initializer_list<string> init) : values(init) {}
+
+	    const vector<string>& get_values() const { return values; }
+
+	    Args& operator<<(const string& value) { values.push_back(value); return *this; }
+
+	private:
+
+	    vector<string> values;
+
+	};
+
+	typedef std::function<void(OutputStream stream, const string& line)> LineCallback;
+
+	struct Options
+	{
+	    Options() : log_output(true), timeout(0), line_callback() {}
+
+	    bool log_output;
+
+	    /**
+	     * The command is killed if it takes longer, 0 for no timeout.
+	     */
+	    std::chrono::milliseconds timeout;
+
+	    /**
+	     * If set every line of output is passed to the callback as
+	     * soon as it is read instead of being stored.
+	     */
+	    LineCallback line_callback;
+	};
+
 	SystemCmd(const string& Command_Cv, bool log_output = true);
 
+	/**
+	 * Executes the program given in args directly with posix_spawn,
+	 * so without a shell and without quoting. posix_spawn does not copy
+	 * the page tables of the process, so it is much faster than fork
+	 * for a process using a lot of memory. The program must be given
+	 * with an absolute path.
+	 */
+	SystemCmd(const Args& args, bool log_output = true);
+	SystemCmd(const Args& args, const Options& options);
+
 	virtual ~SystemCmd();
 
     protected:
@@ -65,6 +118,11 @@ namespace snapper
 	string cmd() const { return lastCmd; }
 	int retcode() const { return Ret_i; }
 
+	/**
+	 * Whether the command was killed due to the timeout.
+	 */
+	bool timedOut() const { return timed_out; }
+
     protected:
 
 	unsigned numLines(bool Selected_bv = false, OutputStream Idx_ii = IDX_STDOUT) const;
@@ -91,6 +149,10 @@ namespace snapper
 	void invalidate();
 	void closeOpenFds() const;
 	int doExecute(const string& Cmd_Cv);
+	int doSpawn(const Args& args, const Options& options);
+	void readUntilExit(int fds[2], const Options& options, int& status);
+	void splitLines(OutputStream stream, const char* buf, size_t len, string& partial,
+			const Options& options);
 	bool doWait(bool Hang_bv, int& Ret_ir);
 	void checkOutput();
 	void getUntilEOF(FILE* File_Cr, std::vector<string>& Lines_Cr, bool& NewLineSeen_br,
@@ -101,6 +163,7 @@ namespace snapper
 	void init();
 
 	void logOutput() const;
+	int decodeStatus(int status);
 
 	/**
 	 * Constructs the environment for the child process.
@@ -121,6 +184,7 @@ namespace snapper
 	bool Background_b;
 	string lastCmd;
 	int Ret_i;
+	bool timed_out;
 	int Pid_i;
 	struct pollfd pfds[2];
 
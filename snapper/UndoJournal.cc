@@ -0,0 +1,277 @@
+/*
+ * Copyright (c) 2019 SUSE LLC
+ *
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of version 2 of the GNU General Public License as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License with this
+ * program; if not, contact Novell, Inc.
+ *
+ * To contact Novell about this file by physical or electronic mail, you may
+ * find current contact information at www.novell.com.
+ */
+
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <algorithm>
+
+#include "snapper/UndoJournal.h"
+#include "snapper/AppUtil.h"
+#include "snapper/AsciiFile.h"
+#include "snapper/SnapperTmpl.h"
+#include "snapper/Exception.h"
+#include "snapper/Log.h"
+
+
+namespace snapper
+{
+    using namespace std;
+
+
+    // Limits for batching completed steps.
+    static const size_t max_pending = 4096;
+    static const std::chrono::seconds max_pending_time(1);
+
+
+    UndoJournal::UndoJournal(const SDir& info_dir, const SDir& system_dir, unsigned int num2)
+	: info_dir(info_dir), system_dir(system_dir), plan_name("undo-" + decString(num2) + ".txt"),
+	  log_name("undo-" + decString(num2) + ".log"), log_fd(-1), num_pending(0),
+	  last_sync(std::chrono::steady_clock::now())
+    {
+    }
+
+
+    UndoJournal::~UndoJournal()
+    {
+	if (log_fd >= 0)
+	{
+	    sync();
+	    close(log_fd);
+	}
+    }
+
+
+    void
+    UndoJournal::open_log(int flags)
+    {
+	log_fd = info_dir.open(log_name, O_WRONLY | O_APPEND | O_NOFOLLOW | O_CLOEXEC | flags, 0600);
+	if (log_fd < 0)
+	    SN_THROW(IOErrorException(sformat("open failed path:%s errno:%d (%s)",
+					      info_dir.fullname(log_name).c_str(), errno,
+					      stringerror(errno).c_str())));
+    }
+
+
+    void
+    UndoJournal::create(const Files& files, const vector<UndoStep>& undo_steps)
+    {
+	y2mil("plan_name:" << plan_name << " undo_steps:" << undo_steps.size());
+
+	string tmp_name = plan_name + ".tmp-XXXXXX";
+
+	FILE* file = fdopen(info_dir.mktemp(tmp_name), "w");
+	if (!file)
+	    SN_THROW(IOErrorException(sformat("mkstemp failed errno:%d (%s)", errno,
+					      stringerror(errno).c_str())));
+
+	indices.clear();
+
+	for (size_t i = 0; i < undo_steps.size(); ++i)
+	{
+	    Files::const_iterator it = files.find(undo_steps[i].name);
+	    if (it == files.end())
+	    {
+		fclose(file);
+		info_dir.unlink(tmp_name, 0);
+		SN_THROW(IOErrorException("undo step without file"));
+	    }
+
+	    fprintf(file, "%s %s\n", statusToString(it->getPreToPostStatus()).c_str(),
+		    it->getName().c_str());
+
+	    indices[undo_steps[i].name] = i;
+	}
+
+	if (fflush(file) != 0 || fsync(fileno(file)) != 0)
+	{
+	    fclose(file);
+	    info_dir.unlink(tmp_name, 0);
+	    SN_THROW(IOErrorException(sformat("writing failed path:%s errno:%d (%s)",
+					      info_dir.fullname(tmp_name).c_str(), errno,
+					      stringerror(errno).c_str())));
+	}
+
+	fclose(file);
+
+	open_log(O_CREAT | O_TRUNC);
+
+	info_dir.rename(tmp_name, plan_name);
+
+	fsync(info_dir.fd());
+    }
+
+
+    bool
+    UndoJournal::load(const FilePaths* file_paths, vector<File>& files, vector<UndoStep>& undo_steps)
+    {
+	y2mil("plan_name:" << plan_name);
+
+	files.clear();
+	undo_steps.clear();
+	indices.clear();
+
+	vector<UndoStep> planned_steps;
+
+	try
+	{
+	    AsciiFileReader asciifile(info_dir.open(plan_name, O_RDONLY | O_NOFOLLOW | O_CLOEXEC));
+
+	    string line;
+	    while (asciifile.getline(line))
+	    {
+		string::size_type pos = line.find(" ");
+		if (pos == string::npos)
+		    continue;
+
+		unsigned int status = stringToStatus(string(line, 0, pos));
+		string name = string(line, pos + 1);
+
+		File file(file_paths, name, status);
+		file.setUndo(true);
+
+		indices[name] = planned_steps.size();
+		planned_steps.push_back(UndoStep(name, file.getAction()));
+
+		files.push_back(file);
+	    }
+	}
+	catch (const FileNotFoundException& e)
+	{
+	    return false;
+	}
+
+	vector<bool> done(planned_steps.size(), false);
+
+	int fd = info_dir.open(log_name, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+	if (fd >= 0)
+	{
+	    // After a crash the last line may be incomplete. Only complete
+	    // lines are used, other steps are simply done again.
+
+	    string content;
+
+	    char buffer[16384];
+	    ssize_t r;
+	    while ((r = read(fd, buffer, sizeof(buffer))) > 0)
+		content.append(buffer, r);
+
+	    close(fd);
+
+	    size_t index = 0;
+	    bool valid = false;
+
+	    for (char c : content)
+	    {
+		if (c >= '0' && c <= '9')
+		{
+		    index = 10 * index + (c - '0');
+		    valid = true;
+		}
+		else
+		{
+		    if (c == '\n' && valid && index < done.size())
+			done[index] = true;
+
+		    index = 0;
+		    valid = false;
+		}
+	    }
+	}
+
+	for (size_t i = 0; i < planned_steps.size(); ++i)
+	    if (!done[i])
+		undo_steps.push_back(planned_steps[i]);
+
+	sort(files.begin(), files.end(), [](const File& lhs, const File& rhs) {
+	    return File::cmp_lt(lhs.getName(), rhs.getName());
+	});
+
+	y2mil("planned:" << planned_steps.size() << " remaining:" << undo_steps.size());
+
+	open_log(O_CREAT);
+
+	return true;
+    }
+
+
+    void
+    UndoJournal::completed(const UndoStep& undo_step)
+    {
+	std::unordered_map<string, size_t>::const_iterator it = indices.find(undo_step.name);
+	if (it == indices.end())
+	    return;
+
+	pending += decString(it->second) + "\n";
+	++num_pending;
+
+	if (num_pending >= max_pending ||
+	    std::chrono::steady_clock::now() - last_sync >= max_pending_time)
+	    sync();
+    }
+
+
+    void
+    UndoJournal::sync()
+    {
+	last_sync = std::chrono::steady_clock::now();
+
+	if (num_pending == 0 || log_fd < 0)
+	    return;
+
+	// Sync the restored files before recording them as completed.
+
+	if (syncfs(system_dir.fd()) != 0)
+	    y2err("syncfs failed errno:" << errno << " (" << stringerror(errno) << ")");
+
+	if (write(log_fd, pending.data(), pending.size()) != (ssize_t) pending.size() ||
+	    fdatasync(log_fd) != 0)
+	    y2err("writing failed path:" << info_dir.fullname(log_name) << " errno:" << errno <<
+		  " (" << stringerror(errno) << ")");
+
+	pending.clear();
+	num_pending = 0;
+    }
+
+
+    void
+    UndoJournal::remove()
+    {
+	y2mil("plan_name:" << plan_name);
+
+	if (log_fd >= 0)
+	{
+	    close(log_fd);
+	    log_fd = -1;
+	}
+
+	pending.clear();
+	num_pending = 0;
+
+	info_dir.unlink(plan_name, 0);
+	info_dir.unlink(log_name, 0);
+    }
+
+}
@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2019 SUSE LLC
+ *
+ * All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of version 2 of the GNU General Public License as published
+ * by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License with this
+ * program; if not, contact Novell, Inc.
+ *
+ * To contact Novell about this file by physical or electronic mail, you may
+ * find current contact information at www.novell.com.
+ */
+
+
+#ifndef SNAPPER_UNDO_JOURNAL_H
+#define SNAPPER_UNDO_JOURNAL_H
+
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "snapper/File.h"
+#include "snapper/FileUtils.h"
+
+
+namespace snapper
+{
+    using std::string;
+    using std::vector;
+
+
+    /*
+     * Journal of an undo operation so that an interrupted undo can be
+     * resumed without comparing the snapshots again (which would also give
+     * a different result since the system is already partly reverted).
+     *
+     * The journal is saved in the info directory of the pre snapshot. The
+     * file undo-<num2>.txt holds the planned undo steps in the same format
+     * as the filelist. The file undo-<num2>.log holds the indices of the
+     * completed steps.
+     *
+     * Completed steps are only written in batches. Before a batch is
+     * written the filesystem of the system is synced so that a step is
+     * never recorded before its changes are on disk. Steps done since the
+     * last batch are done again when resuming, which is harmless since undo
+     * steps are idempotent.
+     */
+    class UndoJournal
+    {
+    public:
+
+	UndoJournal(const SDir& info_dir, const SDir& system_dir, unsigned int num2);
+	~UndoJournal();
+
+	/*
+	 * Saves the planned undo steps. Replaces an existing journal.
+	 */
+	void create(const Files& files, const vector<UndoStep>& undo_steps);
+
+	/*
+	 * Loads the journal. Returns the files of all planned undo steps
+	 * (sorted) and the undo steps not yet completed. Returns false if
+	 * there is no journal.
+	 */
+	bool load(const FilePaths* file_paths, vector<File>& files, vector<UndoStep>& undo_steps);
+
+	/*
+	 * Records a completed undo step. Not thread-safe, intended to be
+	 * called from the callback of Files::doUndoSteps().
+	 */
+	void completed(const UndoStep& undo_step);
+
+	/*
+	 * Writes all recorded steps to disk.
+	 */
+	void sync();
+
+	/*
+	 * Removes the journal.
+	 */
+	void remove();
+
+    private:
+
+	void open_log(int flags);
+
+	const SDir info_dir;
+	const SDir system_dir;
+
+	const string plan_name;
+	const string log_name;
+
+	int log_fd;
+
+	std::unordered_map<string, size_t> indices;
+
+	string pending;
+	size_t num_pending;
+	std::chrono::steady_clock::time_point last_sync;
+
+    };
+
+}
+
+
+#endif
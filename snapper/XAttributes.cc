@@ -27,6 +27,7 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <errno.h>
+#include <string.h>
 #include <iomanip>
 #include <boost/scoped_array.hpp>
 #include <algorithm>
@@ -456,6 +457,167 @@ namespace snapper
     }
 
 
+    void
+    FlatXAttributes::read(const SFile& file)
+    {
+	// The buffer keeps its size from the previous file, its content is
+	// simply overwritten.
+
+	entries.clear();
+
+	// Read the names-list into the start of the buffer. The list can
+	// grow between the calls, so retry on ERANGE.
+
+	ssize_t size;
+	while (true)
+	{
+	    size = file.listxattr(buffer.data(), buffer.size());
+	    if (size >= 0 && (!buffer.empty() || size == 0))
+		break;
+
+	    if (size < 0 && errno != ERANGE)
+	    {
+		y2err("Couldn't get xattributes names-list. link: " << file.fullname(true) <<
+		      ", error: " << stringerror(errno));
+		SN_THROW(XAttributesException());
+	    }
+
+	    size = file.listxattr(NULL, 0);
+	    if (size < 0)
+	    {
+		y2err("Couldn't get xattributes names-list size. link: " << file.fullname(true) <<
+		      ", error: " << stringerror(errno));
+		SN_THROW(XAttributesException());
+	    }
+
+	    buffer.resize(std::max<size_t>(size, 1));
+	}
+
+	size_t used = size;
+
+	for (size_t pos = 0; pos < (size_t) size; )
+	{
+	    Entry entry;
+	    entry.name = pos;
+	    entry.value = used;
+
+	    // move beyond separating '\0' char
+	    pos += strlen(buffer.data() + pos) + 1;
+
+	    while (true)
+	    {
+		// Try the free space of the buffer first, only query the
+		// size of the value if it does not fit. A size of zero would
+		// query the size.
+
+		ssize_t v_size;
+
+		if (used < buffer.size())
+		{
+		    v_size = file.getxattr(buffer.data() + entry.name, buffer.data() + used,
+					   buffer.size() - used);
+		    if (v_size >= 0)
+		    {
+			entry.size = v_size;
+			used += v_size;
+			break;
+		    }
+
+		    if (errno != ERANGE)
+		    {
+			y2err("Couldn't get xattribute value for the xattribute name '" <<
+			      buffer.data() + entry.name << "': " << stringerror(errno));
+			SN_THROW(XAttributesException());
+		    }
+		}
+
+		v_size = file.getxattr(buffer.data() + entry.name, NULL, 0);
+		if (v_size < 0)
+		{
+		    y2err("Couldn't get a xattribute value size for the xattribute name '" <<
+			  buffer.data() + entry.name << "': " << stringerror(errno));
+		    SN_THROW(XAttributesException());
+		}
+
+		if (v_size == 0)
+		{
+		    entry.size = 0;
+		    break;
+		}
+
+		buffer.resize(std::max(2 * buffer.size(), used + v_size));
+	    }
+
+	    entries.push_back(entry);
+	}
+
+	std::sort(entries.begin(), entries.end(), [this](const Entry& a, const Entry& b) {
+	    return strcmp(buffer.data() + a.name, buffer.data() + b.name) < 0;
+	});
+    }
+
+
+    bool
+    FlatXAttributes::isAcl(const Entry& entry) const
+    {
+	for (const string& acl_signature : _acl_signatures)
+	    if (acl_signature == buffer.data() + entry.name)
+		return true;
+
+	return false;
+    }
+
+
+    int
+    FlatXAttributes::compareNames(const Entry& a, const FlatXAttributes& fb, const Entry& b) const
+    {
+	return strcmp(buffer.data() + a.name, fb.buffer.data() + b.name);
+    }
+
+
+    bool
+    FlatXAttributes::equal(const FlatXAttributes& fb, bool acls_only) const
+    {
+	vector<Entry>::const_iterator it_a = entries.begin();
+	vector<Entry>::const_iterator it_b = fb.entries.begin();
+
+	while (true)
+	{
+	    if (acls_only)
+	    {
+		while (it_a != entries.end() && !isAcl(*it_a))
+		    ++it_a;
+		while (it_b != fb.entries.end() && !fb.isAcl(*it_b))
+		    ++it_b;
+	    }
+
+	    if (it_a == entries.end() || it_b == fb.entries.end())
+		return it_a == entries.end() && it_b == fb.entries.end();
+
+	    if (compareNames(*it_a, fb, *it_b) != 0 || it_a->size != it_b->size ||
+		memcmp(buffer.data() + it_a->value, fb.buffer.data() + it_b->value, it_a->size) != 0)
+		return false;
+
+	    ++it_a;
+	    ++it_b;
+	}
+    }
+
+
+    bool
+    FlatXAttributes::equal(const FlatXAttributes& fb) const
+    {
+	return equal(fb, false);
+    }
+
+
+    bool
+    FlatXAttributes::equalAcls(const FlatXAttributes& fb) const
+    {
+	return equal(fb, true);
+    }
+
+
     void
     XAModification::filterOutAcls()
     {
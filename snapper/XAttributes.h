@@ -103,6 +103,40 @@ namespace snapper
 
 	bool operator==(const CompareAcls&) const;
     };
+
+    /*
+     * Flat representation of the extended attributes of a file for
+     * comparisons. Names and values are kept in a single buffer and the
+     * entries are sorted by name. Reusing an object avoids allocations
+     * once the buffers are large enough. For undo and the diff report
+     * XAttributes and XAModification are still required.
+     */
+    class FlatXAttributes
+    {
+    public:
+	// Reads the extended attributes of the file, throws XAttributesException.
+	void read(const SFile& file);
+
+	bool equal(const FlatXAttributes&) const;
+	bool equalAcls(const FlatXAttributes&) const;
+
+    private:
+	struct Entry
+	{
+	    size_t name;	// offset of name in buffer
+	    size_t value;	// offset of value in buffer
+	    size_t size;	// size of value
+	};
+
+	bool equal(const FlatXAttributes&, bool acls_only) const;
+
+	bool isAcl(const Entry& entry) const;
+
+	int compareNames(const Entry& a, const FlatXAttributes& fb, const Entry& b) const;
+
+	vector<char> buffer;
+	vector<Entry> entries;
+    };
 }
 
 
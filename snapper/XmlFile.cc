@@ -87,6 +87,59 @@ namespace snapper
     }
 
 
+    XmlTextReader::XmlTextReader(int fd, const string& url)
+	: fd(fd), reader(xmlReaderForFd(fd, url.c_str(), NULL, XML_PARSE_NOBLANKS | XML_PARSE_NONET))
+    {
+	if (!reader)
+	{
+	    close(fd);
+	    throw IOErrorException("xmlReaderForFd failed");
+	}
+    }
+
+
+    XmlTextReader::~XmlTextReader()
+    {
+	xmlFreeTextReader(reader);
+	close(fd);
+    }
+
+
+    bool
+    XmlTextReader::nextElement(int& depth, string& name)
+    {
+	while (true)
+	{
+	    int r = xmlTextReaderRead(reader);
+	    if (r == 0)
+		return false;
+
+	    if (r < 0)
+		throw IOErrorException("xmlTextReaderRead failed");
+
+	    if (xmlTextReaderNodeType(reader) == XML_READER_TYPE_ELEMENT)
+	    {
+		depth = xmlTextReaderDepth(reader);
+		name = (const char*) xmlTextReaderConstName(reader);
+		return true;
+	    }
+	}
+    }
+
+
+    string
+    XmlTextReader::readString()
+    {
+	xmlChar* tmp = xmlTextReaderReadString(reader);
+	if (!tmp)
+	    return "";
+
+	string ret = (const char*) tmp;
+	xmlFree(tmp);
+	return ret;
+    }
+
+
     xmlNode*
     xmlNewNode(const char* name)
     {
@@ -25,6 +25,7 @@
 
 
 #include <libxml/tree.h>
+#include <libxml/xmlreader.h>
 #include <string>
 #include <list>
 #include <sstream>
@@ -65,6 +66,39 @@ namespace snapper
     };
 
 
+    /*
+     * Reads a XML file element by element without building a tree, see
+     * xmlTextReader. Faster than XmlFile if the file is only read once.
+     */
+    class XmlTextReader : private boost::noncopyable
+    {
+
+    public:
+
+	XmlTextReader(int fd, const string& url);
+
+	~XmlTextReader();
+
+	/*
+	 * Advances to the next element and returns its depth (0 for the
+	 * root element) and name. Returns false at the end of the file.
+	 */
+	bool nextElement(int& depth, string& name);
+
+	/*
+	 * Returns the text content of the current element.
+	 */
+	string readString();
+
+    private:
+
+	int fd;
+
+	xmlTextReader* reader;
+
+    };
+
+
     xmlNode* xmlNewNode(const char* name);
     xmlNode* xmlNewChild(xmlNode* node, const char* name);
 
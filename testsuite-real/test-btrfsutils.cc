@@ -109,5 +109,17 @@ main()
 	cout << endl;
     }
 
+    if (false)
+    {
+	cout << "get_snapshot_subvolumes" << endl;
+
+	int fd2 = open("/btrfs/.snapshots", O_NOATIME);
+	map<unsigned int, SnapshotSubvolume> snapshot_subvolumes = get_snapshot_subvolumes(fd2, "snapshot");
+	for (const map<unsigned int, SnapshotSubvolume>::value_type& value : snapshot_subvolumes)
+	    cout << value.first << " id:" << value.second.id << " read-only:" << value.second.read_only
+		 << " generation:" << value.second.generation << endl;
+	close(fd2);
+    }
+
     close(fd);
 }
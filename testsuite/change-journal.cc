@@ -0,0 +1,73 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE snapper
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <fstream>
+#include <boost/test/unit_test.hpp>
+
+#include <snapper/ChangeJournal.h>
+
+using namespace snapper;
+using namespace std;
+
+
+static void
+write_file(const string& path, const string& content)
+{
+    ofstream out(path);
+    out << content;
+}
+
+
+/*
+ * Needs root and a kernel with fanotify supporting FAN_REPORT_DFID_NAME,
+ * otherwise the test is skipped.
+ */
+BOOST_AUTO_TEST_CASE(hard_links)
+{
+    char tmp[] = "/tmp/change-journal-XXXXXX";
+    BOOST_REQUIRE(mkdtemp(tmp));
+    const string base = tmp;
+
+    write_file(base + "/a", "a");
+    write_file(base + "/b", "b");
+    link((base + "/b").c_str(), (base + "/c").c_str());
+
+    try
+    {
+	ChangeJournal change_journal(base);
+
+	change_journal.beginSnapshot();
+	change_journal.endSnapshot(1, 1000);
+
+	map<string, bool> paths;
+
+	write_file(base + "/a", "A");
+
+	BOOST_CHECK(change_journal.getPaths(1, 1000, paths));
+	BOOST_CHECK(paths.find("/a") != paths.end());
+
+	// .snapshots is ignored
+
+	mkdir((base + "/.snapshots").c_str(), 0755);
+	write_file(base + "/.snapshots/x", "x");
+
+	BOOST_CHECK(change_journal.getPaths(1, 1000, paths));
+	BOOST_CHECK(paths.find("/.snapshots") == paths.end());
+	BOOST_CHECK(paths.find("/.snapshots/x") == paths.end());
+
+	// /c also changes, so the journal cannot be used anymore
+
+	write_file(base + "/b", "B");
+
+	BOOST_CHECK(!change_journal.getPaths(1, 1000, paths));
+    }
+    catch (const ChangeJournalException& e)
+    {
+	BOOST_TEST_MESSAGE("skipped, " << e.what());
+    }
+
+    system(("rm -rf " + base).c_str());
+}
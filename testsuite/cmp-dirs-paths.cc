@@ -0,0 +1,84 @@
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE snapper
+
+#include <stdlib.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <fstream>
+#include <boost/test/unit_test.hpp>
+
+#include <snapper/Compare.h>
+#include <snapper/File.h>
+
+using namespace snapper;
+using namespace std;
+
+
+static void
+write_file(const string& path, const string& content)
+{
+    ofstream out(path);
+    out << content;
+}
+
+
+/*
+ * Builds two trees and checks that comparing only the changed paths gives
+ * the same result as comparing everything.
+ */
+BOOST_AUTO_TEST_CASE(same_as_full_comparison)
+{
+    char tmp[] = "/tmp/cmp-dirs-paths-XXXXXX";
+    BOOST_REQUIRE(mkdtemp(tmp));
+    const string base = tmp;
+
+    mkdir((base + "/1").c_str(), 0755);
+    write_file(base + "/1/a", "x");
+    mkdir((base + "/1/b").c_str(), 0755);
+    write_file(base + "/1/b/c", "same");
+    write_file(base + "/1/d", "deleted");
+    mkdir((base + "/1/e").c_str(), 0755);
+    write_file(base + "/1/e/f", "old");
+
+    mkdir((base + "/2").c_str(), 0755);
+    write_file(base + "/2/a", "yy");
+    // files with equal mtime count as unchanged
+    const struct timespec times[2] = { { 0, UTIME_OMIT }, { 1000000, 0 } };
+    utimensat(AT_FDCWD, (base + "/2/a").c_str(), times, 0);
+    mkdir((base + "/2/b").c_str(), 0755);
+    write_file(base + "/2/b/c", "same");
+    write_file(base + "/2/b/new", "new");
+    mkdir((base + "/2/e").c_str(), 0755);
+    write_file(base + "/2/e/g", "moved here");
+    mkdir((base + "/2/h").c_str(), 0700);
+    write_file(base + "/2/h/i", "new");
+
+    map<string, unsigned int> full;
+    map<string, unsigned int> partial;
+
+    SDir dir1(base + "/1");
+    SDir dir2(base + "/2");
+
+    cmpDirs(dir1, dir2, [&full](const string& name, unsigned int status) {
+	full[name] = status;
+    });
+
+    map<string, bool> paths = { { "/a", false }, { "/b/new", false }, { "/d", false },
+				{ "/e", true }, { "/h", true }, { "/h/i", false },
+				{ "/missing/x", false } };
+
+    cmpDirsPaths(dir1, dir2, paths, [&partial](const string& name, unsigned int status) {
+	BOOST_CHECK(partial.insert(make_pair(name, status)).second);
+    });
+
+    BOOST_CHECK_EQUAL(full.size(), 7);
+    BOOST_CHECK(full == partial);
+
+    BOOST_CHECK_EQUAL(partial["/a"], CONTENT);
+    BOOST_CHECK_EQUAL(partial["/d"], DELETED);
+    BOOST_CHECK_EQUAL(partial["/e/f"], DELETED);
+    BOOST_CHECK_EQUAL(partial["/e/g"], CREATED);
+
+    system(("rm -rf " + base).c_str());
+}
@@ -0,0 +1,70 @@
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE snapper
+
+#include <boost/test/unit_test.hpp>
+
+#include <string>
+
+#include "../client/utils/Diff.h"
+
+
+using namespace std;
+using namespace snapper;
+
+
+string
+test(const string& s1, const string& s2)
+{
+    string out;
+    unified_diff(s1.data(), s1.size(), s2.data(), s2.size(), "a", "b", out);
+    return out;
+}
+
+
+BOOST_AUTO_TEST_CASE(identical)
+{
+    BOOST_CHECK_EQUAL(test("", ""), "");
+    BOOST_CHECK_EQUAL(test("1\n2\n", "1\n2\n"), "");
+}
+
+
+BOOST_AUTO_TEST_CASE(new_file)
+{
+    BOOST_CHECK_EQUAL(test("", "1\n2\n"), "--- a\n+++ b\n@@ -0,0 +1,2 @@\n+1\n+2\n");
+    BOOST_CHECK_EQUAL(test("1\n", ""), "--- a\n+++ b\n@@ -1 +0,0 @@\n-1\n");
+}
+
+
+BOOST_AUTO_TEST_CASE(hunks)
+{
+    string s1 = "1\n2\n3\n4\n5\n6\n7\n8\n9\n10\n11\n12\n13\n14\n15\n16\n";
+    string s2 = "1\nx\n3\n4\n5\n6\n7\n8\n9\n10\n11\n12\n13\n14\n15\n";
+
+    BOOST_CHECK_EQUAL(test(s1, s2),
+		      "--- a\n+++ b\n"
+		      "@@ -1,5 +1,5 @@\n 1\n-2\n+x\n 3\n 4\n 5\n"
+		      "@@ -13,4 +13,3 @@\n 13\n 14\n 15\n-16\n");
+
+    // at most six unchanged lines between changes give one hunk
+
+    string s3 = "1\nx\n3\n4\n5\n6\n7\n8\ny\n10\n";
+
+    BOOST_CHECK_EQUAL(test(s1.substr(0, 21), s3),
+		      "--- a\n+++ b\n"
+		      "@@ -1,10 +1,10 @@\n 1\n-2\n+x\n 3\n 4\n 5\n 6\n 7\n 8\n-9\n+y\n 10\n");
+}
+
+
+BOOST_AUTO_TEST_CASE(no_newline)
+{
+    BOOST_CHECK_EQUAL(test("1\n2", "1\n2\n"),
+		      "--- a\n+++ b\n@@ -1,2 +1,2 @@\n 1\n-2\n\\ No newline at end of file\n+2\n");
+}
+
+
+BOOST_AUTO_TEST_CASE(binary)
+{
+    BOOST_CHECK_EQUAL(test(string("1\0", 2), string("2\0", 2)), "Binary files a and b differ\n");
+    BOOST_CHECK_EQUAL(test(string("1\0", 2), string("1\0", 2)), "");
+}
@@ -4,7 +4,9 @@
 
 #include <boost/test/unit_test.hpp>
 
-#include "../client/utils/equal-date.h"
+#include <snapper/EqualDate.h>
+
+using namespace snapper;
 
 
 bool
@@ -0,0 +1,70 @@
+
+// Measures log calls per second of the synchronous and the asynchronous
+// default logger. Not run by "make check", build it with "make log-bench".
+//
+// usage: log-bench [threads] [lines per thread]
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <iostream>
+#include <boost/thread.hpp>
+
+#include "snapper/Log.h"
+#include "snapper/Logger.h"
+#include "snapper/AppUtil.h"
+
+
+using namespace std;
+using namespace snapper;
+
+
+double
+run(unsigned int num_threads, unsigned int num_lines)
+{
+    StopWatch stopwatch;
+
+    boost::thread_group threads;
+    for (unsigned int i = 0; i < num_threads; ++i)
+	threads.create_thread([num_lines]() {
+	    for (unsigned int j = 0; j < num_lines; ++j)
+		y2mil("benchmark line " << j);
+	});
+
+    threads.join_all();
+
+    return num_threads * num_lines / stopwatch.read();
+}
+
+
+int
+main(int argc, char** argv)
+{
+    unsigned int num_threads = argc > 1 ? atoi(argv[1]) : 4;
+    unsigned int num_lines = argc > 2 ? atoi(argv[2]) : 200000;
+
+    char filename[] = "/tmp/log-bench-XXXXXX";
+    int fd = mkstemp(filename);
+    if (fd < 0)
+    {
+	cerr << "mkstemp failed" << endl;
+	return EXIT_FAILURE;
+    }
+
+    close(fd);
+
+    initDefaultLogger(filename);
+
+    double sync = run(num_threads, num_lines);
+
+    startAsyncLogger();
+    double async = run(num_threads, num_lines);
+    stopAsyncLogger();
+
+    cout << "threads " << num_threads << ", lines per thread " << num_lines << endl;
+    cout << "sync    " << (unsigned long) sync << " lines/s" << endl;
+    cout << "async   " << (unsigned long) async << " lines/s" << endl;
+
+    unlink(filename);
+
+    return EXIT_SUCCESS;
+}
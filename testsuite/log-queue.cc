@@ -0,0 +1,147 @@
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE snapper
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <fstream>
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+
+#include <snapper/Log.h>
+#include <snapper/LogQueue.h>
+
+using namespace snapper;
+
+
+BOOST_AUTO_TEST_CASE(order)
+{
+    LogQueue queue(4);
+
+    BOOST_CHECK(queue.empty());
+
+    BOOST_CHECK(queue.push(MILESTONE, 1, "a.cc", 1, "f", "one"));
+    BOOST_CHECK(queue.push(WARNING, 2, "b.cc", 2, "g", "two"));
+
+    LogEntry entry;
+
+    BOOST_CHECK(queue.pop(entry));
+    BOOST_CHECK_EQUAL(entry.level, MILESTONE);
+    BOOST_CHECK_EQUAL(entry.file, "a.cc");
+    BOOST_CHECK_EQUAL(entry.text, "one");
+
+    BOOST_CHECK(queue.pop(entry));
+    BOOST_CHECK_EQUAL(entry.level, WARNING);
+    BOOST_CHECK_EQUAL(entry.func, "g");
+    BOOST_CHECK_EQUAL(entry.text, "two");
+
+    BOOST_CHECK(!queue.pop(entry));
+    BOOST_CHECK(queue.empty());
+}
+
+
+BOOST_AUTO_TEST_CASE(drop)
+{
+    LogQueue queue(4);
+
+    for (int i = 0; i < 4; ++i)
+	BOOST_CHECK(queue.push(MILESTONE, 0, "a.cc", i, "f", "text"));
+
+    BOOST_CHECK(!queue.push(MILESTONE, 0, "a.cc", 4, "f", "text"));
+    BOOST_CHECK(!queue.push(MILESTONE, 0, "a.cc", 5, "f", "text"));
+
+    BOOST_CHECK_EQUAL(queue.take_dropped(), 2);
+    BOOST_CHECK_EQUAL(queue.take_dropped(), 0);
+
+    LogEntry entry;
+    BOOST_CHECK(queue.pop(entry));
+    BOOST_CHECK_EQUAL(entry.line, 0);
+
+    BOOST_CHECK(queue.push(MILESTONE, 0, "a.cc", 6, "f", "text"));
+
+    // try_push does not count
+
+    BOOST_CHECK(!queue.try_push(MILESTONE, 0, "a.cc", 7, "f", "text"));
+    BOOST_CHECK_EQUAL(queue.take_dropped(), 0);
+}
+
+
+BOOST_AUTO_TEST_CASE(fields)
+{
+    LogQueue queue(4);
+
+    const LogField fields[] = { { "name", "root" }, { "num", 42U }, { "diff", -1 }, { "ok", true } };
+
+    BOOST_CHECK(queue.push(DEBUG, 0, "a.cc", 1, "f", "message", fields, 4));
+
+    LogEntry entry;
+    BOOST_CHECK(queue.pop(entry));
+    BOOST_CHECK_EQUAL(entry.fields.size(), 4);
+
+    formatLogFields(entry.text, entry.fields.data(), entry.fields.size());
+    BOOST_CHECK_EQUAL(entry.text, "message name='root' num=42 diff=-1 ok=true");
+}
+
+
+BOOST_AUTO_TEST_CASE(threads)
+{
+    const int num_threads = 4;
+    const int num_entries = 10000;
+
+    LogQueue queue(256);
+
+    boost::thread_group threads;
+    for (int i = 0; i < num_threads; ++i)
+	threads.create_thread([&queue, i]() {
+	    for (int j = 0; j < num_entries; ++j)
+		while (!queue.push(MILESTONE, 0, "a.cc", j, "f", std::to_string(i)))
+		    boost::this_thread::yield();
+	});
+
+    // Entries of one producer must arrive in order.
+
+    std::vector<int> next(num_threads, 0);
+
+    LogEntry entry;
+    for (int n = 0; n < num_threads * num_entries; )
+    {
+	if (!queue.pop(entry))
+	    continue;
+
+	int i = std::stoi(entry.text);
+	BOOST_CHECK_EQUAL(entry.line, next[i]);
+	next[i] = entry.line + 1;
+	++n;
+    }
+
+    threads.join_all();
+
+    BOOST_CHECK(queue.empty());
+}
+
+
+BOOST_AUTO_TEST_CASE(warnings_not_dropped)
+{
+    char filename[] = "/tmp/log-queue-XXXXXX";
+    int fd = mkstemp(filename);
+    BOOST_REQUIRE(fd >= 0);
+    close(fd);
+
+    initDefaultLogger(filename);
+    startAsyncLogger(4);
+
+    for (int i = 0; i < 1000; ++i)
+	y2war("warning " << i);
+
+    stopAsyncLogger();
+
+    std::ifstream in(filename);
+    int lines = 0;
+    for (std::string line; getline(in, line); )
+	if (line.find(" WAR ") != std::string::npos)
+	    ++lines;
+
+    BOOST_CHECK_EQUAL(lines, 1000);
+
+    unlink(filename);
+}
@@ -0,0 +1,161 @@
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE snapper
+
+#include <stdlib.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <fstream>
+#include <boost/test/unit_test.hpp>
+
+#include <snapper/LvmShell.h>
+
+using namespace snapper;
+
+
+/*
+ * Stub for the lvm shell: shows a prompt, answers version and lvs with a
+ * report and every other command with a failure status on the report
+ * fd. The command close closes stdin but does not exit.
+ */
+static const char* stub =
+    "#!/bin/bash\n"
+    "log() { echo \"\\\"log\\\": [{\\\"log_type\\\":\\\"status\\\", \\\"log_object_type\\\":\\\"cmd\\\", \\\"log_ret_code\\\":\\\"$1\\\"}]\"; }\n"
+    "echo -n 'lvm> '\n"
+    "while read -r cmd args; do\n"
+    "  case \"$cmd\" in\n"
+    "    version) echo \"{$(log 1)}\" >&3 ;;\n"
+    "    close) exec 0<&-; echo \"{$(log 1)}\" >&3; echo -n 'lvm> '; sleep 5; exit ;;\n"
+    "    lvs) echo \"{\\\"report\\\": [{\\\"lv\\\": [{\\\"lv_name\\\":\\\"a\\\", \\\"lv_attr\\\":\\\"Vwi-a-tz--\\\"},\" >&3\n"
+    "         echo \" {\\\"lv_name\\\":\\\"b\\\", \\\"lv_attr\\\":\\\"Vwi---tz--\\\"}]}], $(log 1)}\" >&3 ;;\n"
+    "    *) echo \"some error\"; echo \"{$(log 5)}\" >&3 ;;\n"
+    "  esac\n"
+    "  echo -n 'lvm> '\n"
+    "done\n";
+
+
+struct Fixture
+{
+    Fixture(const char* script = stub)
+    {
+	char tmp[] = "/tmp/lvm-shell-stub-XXXXXX";
+	int fd = mkstemp(tmp);
+	close(fd);
+
+	path = tmp;
+
+	std::ofstream out(path);
+	out << script;
+	out.close();
+
+	chmod(path.c_str(), 0755);
+    }
+
+    ~Fixture()
+    {
+	unlink(path.c_str());
+    }
+
+    string path;
+};
+
+
+BOOST_FIXTURE_TEST_CASE(report, Fixture)
+{
+    LvmShell lvm_shell(path);
+
+    for (int i = 0; i < 2; ++i)
+    {
+	bool success = false;
+	vector<LvmShell::Row> rows;
+
+	BOOST_CHECK(lvm_shell.run({ "lvs", "-o", "lv_name,lv_attr", "vg" }, "lv", success, rows));
+	BOOST_CHECK(success);
+	BOOST_REQUIRE_EQUAL(rows.size(), 2);
+	BOOST_CHECK_EQUAL(rows[0]["lv_name"], "a");
+	BOOST_CHECK_EQUAL(rows[0]["lv_attr"], "Vwi-a-tz--");
+	BOOST_CHECK_EQUAL(rows[1]["lv_name"], "b");
+    }
+}
+
+
+BOOST_FIXTURE_TEST_CASE(failure, Fixture)
+{
+    LvmShell lvm_shell(path);
+
+    bool success = true;
+    vector<LvmShell::Row> rows;
+
+    BOOST_CHECK(lvm_shell.run({ "lvremove", "--force", "vg/lv" }, "lv", success, rows));
+    BOOST_CHECK(!success);
+    BOOST_CHECK(rows.empty());
+
+    // arguments needing quoting are refused
+    BOOST_CHECK(!lvm_shell.run({ "lvs", "vg/with space" }, "lv", success, rows));
+
+    // the shell is still usable
+    BOOST_CHECK(lvm_shell.run({ "lvs", "vg" }, "lv", success, rows));
+    BOOST_CHECK(success);
+}
+
+
+BOOST_AUTO_TEST_CASE(missing)
+{
+    LvmShell lvm_shell("/does/not/exist");
+
+    bool success;
+    vector<LvmShell::Row> rows;
+
+    BOOST_CHECK(!lvm_shell.run({ "lvs" }, "lv", success, rows));
+}
+
+
+/*
+ * Stub for an lvm shell not supporting JSON reports.
+ */
+static const char* old_stub =
+    "#!/bin/bash\n"
+    "echo -n 'lvm> '\n"
+    "while read -r cmd args; do\n"
+    "  echo \"unrecognised option\"\n"
+    "  echo -n 'lvm> '\n"
+    "done\n";
+
+
+struct OldFixture : public Fixture
+{
+    OldFixture() : Fixture(old_stub) {}
+};
+
+
+BOOST_FIXTURE_TEST_CASE(probe, OldFixture)
+{
+    LvmShell lvm_shell(path);
+
+    bool success;
+    vector<LvmShell::Row> rows;
+
+    BOOST_CHECK(!lvm_shell.run({ "lvs" }, "lv", success, rows));
+}
+
+
+BOOST_FIXTURE_TEST_CASE(sigpipe, Fixture)
+{
+    // SIGPIPE keeps its default action, writing to the shell after it
+    // closed its input must not kill the process.
+
+    LvmShell lvm_shell(path);
+
+    bool success;
+    vector<LvmShell::Row> rows;
+
+    BOOST_CHECK(lvm_shell.run({ "close" }, "lv", success, rows));
+    BOOST_CHECK(success);
+
+    BOOST_CHECK(!lvm_shell.run({ "lvs" }, "lv", success, rows));
+
+    struct sigaction action;
+    BOOST_CHECK_EQUAL(sigaction(SIGPIPE, nullptr, &action), 0);
+    BOOST_CHECK(action.sa_handler == SIG_DFL);
+}
@@ -0,0 +1,225 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE snapper
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/mount.h>
+#include <sys/xattr.h>
+#include <fstream>
+#include <boost/test/unit_test.hpp>
+
+#include <snapper/Reflink.h>
+#include <snapper/Compare.h>
+#include <snapper/File.h>
+
+using namespace snapper;
+using namespace std;
+
+
+static void
+write_file(const string& path, const string& content)
+{
+    ofstream out(path);
+    out << content;
+}
+
+
+/*
+ * Creates a snapshot of a small tree, compares it with the original and
+ * deletes it again. Since the filesystem of /tmp usually does not support
+ * reflinks the data is copied. Needs root since .snapshots must be owned
+ * by root.
+ */
+BOOST_AUTO_TEST_CASE(create_compare_delete)
+{
+    if (geteuid() != 0)
+    {
+	BOOST_TEST_MESSAGE("skipped, needs root");
+	return;
+    }
+
+    char tmp[] = "/tmp/reflink-XXXXXX";
+    BOOST_REQUIRE(mkdtemp(tmp));
+    const string base = tmp;
+
+    mkdir((base + "/a").c_str(), 0755);
+    write_file(base + "/a/b", "hello");
+    link((base + "/a/b").c_str(), (base + "/a/c").c_str());
+    mkdir((base + "/a/d").c_str(), 0500);
+    symlink("../x", (base + "/a/link").c_str());
+    mkfifo((base + "/a/fifo").c_str(), 0600);
+    chmod((base + "/a/b").c_str(), 04711);
+    setxattr((base + "/a/b").c_str(), "user.test", "value", 5, 0);
+
+    const struct timespec times[2] = { { 1000000, 0 }, { 1000000, 0 } };
+    utimensat(AT_FDCWD, (base + "/a").c_str(), times, 0);
+
+    Reflink reflink(base, "");
+    reflink.createConfig();
+
+    SDir infos_dir = reflink.openInfosDir();
+    BOOST_REQUIRE(infos_dir.mkdir("1", 0755) == 0);
+
+    reflink.createSnapshot(1, 0, true, false, false);
+
+    BOOST_CHECK(reflink.checkSnapshot(1));
+
+    SDir base_dir(base);
+    SDir snapshot_dir = reflink.openSnapshotDir(1);
+
+    map<string, unsigned int> differences;
+
+    cmpDirs(base_dir, snapshot_dir, [&differences](const string& name, unsigned int status) {
+	differences[name] = status;
+    });
+
+    BOOST_CHECK(differences.empty());
+
+    // The snapshot contains no hard links, neither within nor to the original.
+
+    struct stat stat1, stat2;
+    BOOST_CHECK_EQUAL(snapshot_dir.stat("a", &stat1, 0), 0);
+    BOOST_CHECK_EQUAL(stat1.st_mtim.tv_sec, 1000000);
+
+    SDir snapshot_a(snapshot_dir, "a");
+    BOOST_CHECK_EQUAL(snapshot_a.stat("b", &stat1, 0), 0);
+    BOOST_CHECK_EQUAL(snapshot_a.stat("c", &stat2, 0), 0);
+    BOOST_CHECK_EQUAL(stat1.st_nlink, 1);
+    BOOST_CHECK(stat1.st_ino != stat2.st_ino);
+    BOOST_CHECK_EQUAL(stat1.st_mode & 07777, 04711);
+
+    reflink.deleteSnapshot(1);
+
+    BOOST_CHECK(!reflink.checkSnapshot(1));
+
+    infos_dir.unlink("1", AT_REMOVEDIR);
+    reflink.deleteConfig();
+
+    system(("rm -rf " + base).c_str());
+}
+
+
+/*
+ * A file bind mounted from another filesystem is only an empty file in
+ * the snapshot. Skipped if mounting is not possible.
+ */
+BOOST_AUTO_TEST_CASE(bind_mounted_file)
+{
+    if (geteuid() != 0)
+    {
+	BOOST_TEST_MESSAGE("skipped, needs root");
+	return;
+    }
+
+    char tmp[] = "/tmp/reflink-XXXXXX";
+    BOOST_REQUIRE(mkdtemp(tmp));
+    const string base = tmp;
+
+    char other[] = "/dev/shm/reflink-XXXXXX";
+    BOOST_REQUIRE(mkdtemp(other));
+
+    write_file(base + "/resolv.conf", "");
+    write_file(string(other) + "/resolv.conf", "nameserver 127.0.0.1");
+
+    if (mount((string(other) + "/resolv.conf").c_str(), (base + "/resolv.conf").c_str(), nullptr,
+	      MS_BIND, nullptr) != 0)
+    {
+	BOOST_TEST_MESSAGE("skipped, bind mount failed");
+    }
+    else
+    {
+	Reflink reflink(base, "");
+	reflink.createConfig();
+
+	SDir infos_dir = reflink.openInfosDir();
+	BOOST_REQUIRE(infos_dir.mkdir("1", 0755) == 0);
+
+	reflink.createSnapshot(1, 0, true, false, false);
+
+	struct stat stat;
+	BOOST_CHECK_EQUAL(reflink.openSnapshotDir(1).stat("resolv.conf", &stat, 0), 0);
+	BOOST_CHECK(S_ISREG(stat.st_mode));
+	BOOST_CHECK_EQUAL(stat.st_size, 0);
+
+	umount((base + "/resolv.conf").c_str());
+
+	reflink.deleteSnapshot(1);
+	infos_dir.unlink("1", AT_REMOVEDIR);
+	reflink.deleteConfig();
+    }
+
+    system(("rm -rf " + base + " " + other).c_str());
+}
+
+
+/*
+ * Creates a snapshot on a loop mounted xfs, where the data is cloned,
+ * and compares it. Skipped if mkfs.xfs or loop devices are not
+ * available.
+ */
+BOOST_AUTO_TEST_CASE(xfs)
+{
+    if (geteuid() != 0)
+    {
+	BOOST_TEST_MESSAGE("skipped, needs root");
+	return;
+    }
+
+    char tmp[] = "/tmp/reflink-XXXXXX";
+    BOOST_REQUIRE(mkdtemp(tmp));
+    const string base = tmp;
+    const string image = base + "/image";
+    const string mnt = base + "/mnt";
+
+    mkdir(mnt.c_str(), 0755);
+
+    write_file(image, "");
+
+    if (truncate(image.c_str(), 512 * 1024 * 1024) != 0 ||
+	system(("mkfs.xfs -q -m reflink=1 " + image + " > /dev/null 2>&1").c_str()) != 0 ||
+	system(("mount -o loop " + image + " " + mnt + " > /dev/null 2>&1").c_str()) != 0)
+    {
+	BOOST_TEST_MESSAGE("skipped, no xfs image available");
+	system(("rm -rf " + base).c_str());
+	return;
+    }
+
+    write_file(mnt + "/a", string(1024 * 1024, 'a'));
+    write_file(mnt + "/b", string(1024 * 1024, 'b'));
+
+    Reflink reflink(mnt, "");
+    reflink.createConfig();
+
+    SDir infos_dir = reflink.openInfosDir();
+    BOOST_REQUIRE(infos_dir.mkdir("1", 0755) == 0);
+
+    reflink.createSnapshot(1, 0, true, false, false);
+
+    // Changing only the mtime does not change the content, which is
+    // found via the shared extents.
+
+    const struct timespec times[2] = { { 1000000, 0 }, { 1000000, 0 } };
+    utimensat(AT_FDCWD, (mnt + "/a").c_str(), times, 0);
+
+    write_file(mnt + "/b", string(1024 * 1024, 'c'));
+
+    map<string, unsigned int> differences;
+
+    cmpdirs_cb_t cb = [&differences](const string& name, unsigned int status) {
+	differences[name] = status;
+    };
+
+    reflink.cmpDirs(reflink.openSnapshotDir(1), SDir(mnt), cb);
+
+    BOOST_CHECK_EQUAL(differences.size(), 1);
+    BOOST_CHECK(differences["/b"] & CONTENT);
+
+    reflink.deleteSnapshot(1);
+    infos_dir.unlink("1", AT_REMOVEDIR);
+    reflink.deleteConfig();
+
+    system(("umount " + mnt).c_str());
+    system(("rm -rf " + base).c_str());
+}
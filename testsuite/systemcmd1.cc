@@ -0,0 +1,73 @@
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE snapper
+
+#include <boost/test/unit_test.hpp>
+
+#include <snapper/SystemCmd.h>
+
+using namespace snapper;
+
+
+BOOST_AUTO_TEST_CASE(output)
+{
+    SystemCmd cmd(SystemCmd::Args({ "/bin/sh", "-c", "echo 'hello world'; echo error >&2; echo -n last" }));
+
+    BOOST_CHECK_EQUAL(cmd.retcode(), 0);
+    BOOST_CHECK_EQUAL(cmd.stdout().size(), 2);
+    BOOST_CHECK_EQUAL(cmd.stdout()[0], "hello world");
+    BOOST_CHECK_EQUAL(cmd.stdout()[1], "last");
+    BOOST_CHECK_EQUAL(cmd.stderr().size(), 1);
+    BOOST_CHECK_EQUAL(cmd.stderr()[0], "error");
+}
+
+
+BOOST_AUTO_TEST_CASE(no_shell)
+{
+    SystemCmd cmd(SystemCmd::Args({ "/bin/echo", "$HOME 'quoted' `x`" }));
+
+    BOOST_CHECK_EQUAL(cmd.retcode(), 0);
+    BOOST_CHECK_EQUAL(cmd.stdout().size(), 1);
+    BOOST_CHECK_EQUAL(cmd.stdout()[0], "$HOME 'quoted' `x`");
+}
+
+
+BOOST_AUTO_TEST_CASE(retcode)
+{
+    SystemCmd cmd1(SystemCmd::Args({ "/bin/sh", "-c", "exit 3" }));
+    BOOST_CHECK_EQUAL(cmd1.retcode(), 3);
+
+    SystemCmd cmd2(SystemCmd::Args({ "/does/not/exist" }));
+    BOOST_CHECK_EQUAL(cmd2.retcode(), 127);
+}
+
+
+BOOST_AUTO_TEST_CASE(callback)
+{
+    vector<string> lines;
+
+    SystemCmd::Options options;
+    options.line_callback = [&lines](SystemCmd::OutputStream stream, const string& line) {
+	lines.push_back((stream == SystemCmd::IDX_STDOUT ? "out:" : "err:") + line);
+    };
+
+    SystemCmd cmd(SystemCmd::Args({ "/bin/sh", "-c", "echo a; echo b" }), options);
+
+    BOOST_CHECK_EQUAL(cmd.retcode(), 0);
+    BOOST_CHECK(cmd.stdout().empty());
+    BOOST_CHECK_EQUAL(lines.size(), 2);
+    BOOST_CHECK_EQUAL(lines[0], "out:a");
+    BOOST_CHECK_EQUAL(lines[1], "out:b");
+}
+
+
+BOOST_AUTO_TEST_CASE(timeout)
+{
+    SystemCmd::Options options;
+    options.timeout = std::chrono::milliseconds(200);
+
+    SystemCmd cmd(SystemCmd::Args({ "/bin/sleep", "10" }), options);
+
+    BOOST_CHECK(cmd.timedOut());
+    BOOST_CHECK_EQUAL(cmd.retcode(), -257);
+}
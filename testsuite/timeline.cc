@@ -0,0 +1,129 @@
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE snapper
+
+#include <stdlib.h>
+#include <chrono>
+#include <functional>
+#include <boost/test/unit_test.hpp>
+
+#include <snapper/Cleanup.h>
+#include <snapper/EqualDate.h>
+
+using namespace snapper;
+
+
+// Straightforward quadratic implementation of the timeline algorithm as
+// reference.
+
+bool
+is_first(const vector<time_t>& dates, size_t i,
+	 std::function<bool(const struct tm& tmp1, const struct tm& tmp2)> pred)
+{
+    struct tm tmp1;
+    localtime_r(&dates[i], &tmp1);
+
+    for (size_t j = i; j-- > 0;)
+    {
+	struct tm tmp2;
+	localtime_r(&dates[j], &tmp2);
+
+	if (!pred(tmp1, tmp2))
+	    return true;
+
+	if (dates[i] > dates[j])
+	    return false;
+    }
+
+    return true;
+}
+
+
+vector<bool>
+reference_keeps(const vector<time_t>& dates, size_t limit_hourly, size_t limit_daily,
+		size_t limit_weekly, size_t limit_monthly, size_t limit_yearly)
+{
+    size_t num_hourly = 0, num_daily = 0, num_weekly = 0, num_monthly = 0, num_yearly = 0;
+
+    vector<bool> ret(dates.size(), false);
+
+    for (size_t i = dates.size(); i-- > 0;)
+    {
+	if (num_hourly < limit_hourly && is_first(dates, i, equal_hour))
+	    ++num_hourly, ret[i] = true;
+	if (num_daily < limit_daily && is_first(dates, i, equal_day))
+	    ++num_daily, ret[i] = true;
+	if (num_weekly < limit_weekly && is_first(dates, i, equal_week))
+	    ++num_weekly, ret[i] = true;
+	if (num_monthly < limit_monthly && is_first(dates, i, equal_month))
+	    ++num_monthly, ret[i] = true;
+	if (num_yearly < limit_yearly && is_first(dates, i, equal_year))
+	    ++num_yearly, ret[i] = true;
+    }
+
+    return ret;
+}
+
+
+vector<TimelineDate>
+timeline_dates(const vector<time_t>& dates)
+{
+    return vector<TimelineDate>(dates.begin(), dates.end());
+}
+
+
+BOOST_AUTO_TEST_CASE(reference)
+{
+    setenv("TZ", "UTC", 1);
+    tzset();
+
+    // every 17 minutes with a few dates going backwards (e.g. clock changes)
+
+    vector<time_t> dates;
+    time_t t = 1262304000;
+    for (size_t i = 0; i < 5000; ++i)
+    {
+	dates.push_back(i % 97 == 0 ? t - 3600 : t);
+	t += i % 500 == 0 ? 20 * 86400 : 17 * 60;
+    }
+
+    BOOST_CHECK(timeline_keeps(timeline_dates(dates), 10, 10, 0, 10, 10) ==
+		reference_keeps(dates, 10, 10, 0, 10, 10));
+
+    BOOST_CHECK(timeline_keeps(timeline_dates(dates), 5, 30, 8, 12, 2) ==
+		reference_keeps(dates, 5, 30, 8, 12, 2));
+
+    BOOST_CHECK(timeline_keeps(timeline_dates(dates), 0, 0, 0, 0, 0) ==
+		reference_keeps(dates, 0, 0, 0, 0, 0));
+}
+
+
+BOOST_AUTO_TEST_CASE(benchmark)
+{
+    setenv("TZ", "UTC", 1);
+    tzset();
+
+    // hourly snapshots for more than five years
+
+    vector<time_t> dates;
+    for (size_t i = 0; i < 50000; ++i)
+	dates.push_back(1262304000 + i * 3600);
+
+    std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+
+    vector<bool> keeps = timeline_keeps(timeline_dates(dates), 10, 10, 0, 10, 10);
+
+    std::chrono::steady_clock::time_point t2 = std::chrono::steady_clock::now();
+
+    vector<bool> expected = reference_keeps(dates, 10, 10, 0, 10, 10);
+
+    std::chrono::steady_clock::time_point t3 = std::chrono::steady_clock::now();
+
+    BOOST_TEST_MESSAGE("50000 snapshots: " <<
+		       std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count() <<
+		       " ms, reference " <<
+		       std::chrono::duration_cast<std::chrono::milliseconds>(t3 - t2).count() << " ms");
+
+    BOOST_CHECK(keeps == expected);
+    BOOST_CHECK(keeps.back());
+}
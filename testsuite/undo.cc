@@ -0,0 +1,425 @@
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE snapper
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <chrono>
+#include <boost/test/unit_test.hpp>
+
+#include <string>
+#include <vector>
+
+#include <snapper/File.h>
+#include <snapper/UndoJournal.h>
+#include <snapper/Compare.h>
+
+
+using namespace std;
+using namespace snapper;
+
+
+struct Fixture
+{
+    Fixture()
+    {
+	char tmp[] = "/tmp/snapper-undo-XXXXXX";
+	base = mkdtemp(tmp);
+
+	file_paths.pre_path = base + "/pre";
+	file_paths.post_path = base + "/post";
+	file_paths.system_path = base + "/system";
+
+	mkdir(file_paths.pre_path.c_str(), 0755);
+	mkdir(file_paths.post_path.c_str(), 0755);
+	mkdir(file_paths.system_path.c_str(), 0755);
+    }
+
+    ~Fixture()
+    {
+	system(("rm -rf " + base).c_str());
+    }
+
+    void
+    make_file(const string& path, const string& content)
+    {
+	int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	BOOST_REQUIRE(fd >= 0);
+	BOOST_REQUIRE(write(fd, content.data(), content.size()) == (ssize_t) content.size());
+	close(fd);
+    }
+
+    bool
+    exists(const string& name) const
+    {
+	struct stat fs;
+	return lstat((file_paths.system_path + name).c_str(), &fs) == 0;
+    }
+
+    string base;
+    FilePaths file_paths;
+};
+
+
+BOOST_FIXTURE_TEST_CASE(tree, Fixture)
+{
+    // pre has a tree that was deleted in post, post has a tree that was
+    // created since pre
+
+    vector<File> entries;
+    unsigned long long bytes = 0;
+
+    mkdir((file_paths.pre_path + "/a").c_str(), 0755);
+    entries.push_back(File(&file_paths, "/a", DELETED));
+
+    for (int i = 0; i < 20; ++i)
+    {
+	string dir = "/a/d" + to_string(i);
+	mkdir((file_paths.pre_path + dir).c_str(), 0700);
+	entries.push_back(File(&file_paths, dir, DELETED));
+
+	for (int j = 0; j < 20; ++j)
+	{
+	    string file = dir + "/f" + to_string(j);
+	    make_file(file_paths.pre_path + file, file);
+	    entries.push_back(File(&file_paths, file, DELETED));
+	    bytes += file.size();
+	}
+
+	symlink("f0", (file_paths.pre_path + dir + "/l").c_str());
+	entries.push_back(File(&file_paths, dir + "/l", DELETED));
+    }
+
+    mkdir((file_paths.system_path + "/b").c_str(), 0755);
+    entries.push_back(File(&file_paths, "/b", CREATED));
+
+    for (int i = 0; i < 20; ++i)
+    {
+	string dir = "/b/d" + to_string(i);
+	mkdir((file_paths.system_path + dir).c_str(), 0755);
+	entries.push_back(File(&file_paths, dir, CREATED));
+
+	for (int j = 0; j < 20; ++j)
+	{
+	    string file = dir + "/f" + to_string(j);
+	    make_file(file_paths.system_path + file, file);
+	    entries.push_back(File(&file_paths, file, CREATED));
+	}
+    }
+
+    sort(entries.begin(), entries.end(), [](const File& lhs, const File& rhs) {
+	return File::cmp_lt(lhs.getName(), rhs.getName());
+    });
+
+    for (File& file : entries)
+	file.setUndo(true);
+
+    Files files(&file_paths, entries);
+
+    vector<UndoStep> undo_steps = files.getUndoSteps();
+
+    size_t num_ok = 0;
+    size_t last_done = 0;
+
+    bool ret = files.doUndoSteps(undo_steps, [&](const UndoStep& undo_step, bool ok, size_t done,
+						 size_t total) {
+	BOOST_CHECK_EQUAL(done, last_done + 1);
+	BOOST_CHECK_EQUAL(total, undo_steps.size());
+	last_done = done;
+	if (ok)
+	    ++num_ok;
+    }, 8);
+
+    BOOST_CHECK(ret);
+    BOOST_CHECK_EQUAL(num_ok, undo_steps.size());
+
+    BOOST_CHECK(!exists("/b"));
+
+    // depending on the filesystem the content is cloned or copied
+
+    UndoStatistic undo_statistic = files.getUndoStatistic();
+    BOOST_CHECK_EQUAL(undo_statistic.bytesCloned + undo_statistic.bytesCopied, bytes);
+
+    for (int i = 0; i < 20; ++i)
+    {
+	struct stat fs;
+	BOOST_CHECK(lstat((file_paths.system_path + "/a/d" + to_string(i)).c_str(), &fs) == 0);
+	BOOST_CHECK(S_ISDIR(fs.st_mode) && (fs.st_mode & 0777) == 0700);
+
+	BOOST_CHECK(lstat((file_paths.system_path + "/a/d" + to_string(i) + "/l").c_str(), &fs) == 0);
+	BOOST_CHECK(S_ISLNK(fs.st_mode));
+
+	for (int j = 0; j < 20; ++j)
+	{
+	    string file = "/a/d" + to_string(i) + "/f" + to_string(j);
+	    BOOST_CHECK(lstat((file_paths.system_path + file).c_str(), &fs) == 0);
+	    BOOST_CHECK_EQUAL(fs.st_size, (off_t) file.size());
+	}
+    }
+}
+
+
+BOOST_FIXTURE_TEST_CASE(type_change, Fixture)
+{
+    // in pre /x is a file, in post /x is a directory with entries
+
+    make_file(file_paths.pre_path + "/x", "x");
+
+    mkdir((file_paths.system_path + "/x").c_str(), 0755);
+    make_file(file_paths.system_path + "/x/y", "y");
+
+    vector<File> entries = { File(&file_paths, "/x", TYPE), File(&file_paths, "/x/y", CREATED) };
+
+    for (File& file : entries)
+	file.setUndo(true);
+
+    Files files(&file_paths, entries);
+
+    // steps deliberately in the wrong order
+
+    vector<UndoStep> undo_steps = { UndoStep("/x", MODIFY), UndoStep("/x/y", DELETE) };
+
+    BOOST_CHECK(files.doUndoSteps(undo_steps, nullptr, 2));
+
+    struct stat fs;
+    BOOST_CHECK(lstat((file_paths.system_path + "/x").c_str(), &fs) == 0);
+    BOOST_CHECK(S_ISREG(fs.st_mode));
+}
+
+
+BOOST_FIXTURE_TEST_CASE(journal, Fixture)
+{
+    mkdir((base + "/info").c_str(), 0755);
+
+    vector<File> entries;
+
+    for (int i = 0; i < 2000; ++i)
+    {
+	string file = "/f" + to_string(i);
+	make_file(file_paths.pre_path + file, file);
+	entries.push_back(File(&file_paths, file, DELETED));
+    }
+
+    sort(entries.begin(), entries.end(), [](const File& lhs, const File& rhs) {
+	return File::cmp_lt(lhs.getName(), rhs.getName());
+    });
+
+    for (File& file : entries)
+	file.setUndo(true);
+
+    Files files(&file_paths, entries);
+
+    vector<UndoStep> undo_steps = files.getUndoSteps();
+
+    // compare the time without and with journal
+
+    std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+
+    BOOST_CHECK(files.doUndoSteps(undo_steps, nullptr));
+
+    std::chrono::steady_clock::time_point t2 = std::chrono::steady_clock::now();
+
+    system(("rm -rf " + file_paths.system_path + "/*").c_str());
+
+    std::chrono::steady_clock::time_point t3 = std::chrono::steady_clock::now();
+
+    // interrupted after 500 steps
+
+    {
+	UndoJournal journal(SDir(base + "/info"), SDir(file_paths.system_path), 0);
+	journal.create(files, undo_steps);
+
+	BOOST_CHECK(files.doUndoSteps(undo_steps, [&journal](const UndoStep& undo_step, bool ok,
+							     size_t done, size_t total) {
+	    if (done <= 500)
+		journal.completed(undo_step);
+	}));
+    }
+
+    std::chrono::steady_clock::time_point t4 = std::chrono::steady_clock::now();
+
+    BOOST_TEST_MESSAGE("2000 files: " <<
+		       std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count() <<
+		       " us without journal, " <<
+		       std::chrono::duration_cast<std::chrono::microseconds>(t4 - t3).count() <<
+		       " us with journal");
+
+    UndoJournal journal(SDir(base + "/info"), SDir(file_paths.system_path), 0);
+
+    vector<File> resume_entries;
+    vector<UndoStep> resume_undo_steps;
+
+    BOOST_REQUIRE(journal.load(&file_paths, resume_entries, resume_undo_steps));
+    BOOST_CHECK_EQUAL(resume_entries.size(), 2000);
+    BOOST_CHECK_EQUAL(resume_undo_steps.size(), 1500);
+
+    Files resume_files(&file_paths, resume_entries);
+    BOOST_CHECK(resume_files.doUndoSteps(resume_undo_steps, nullptr));
+
+    journal.remove();
+
+    BOOST_CHECK(!journal.load(&file_paths, resume_entries, resume_undo_steps));
+}
+
+
+BOOST_FIXTURE_TEST_CASE(interrupted, Fixture)
+{
+    // A child process is killed in the middle of the undo. Steps done
+    // after the last batch written to the journal are done again when
+    // resuming, e.g. symlinks that already exist.
+
+    mkdir((base + "/info").c_str(), 0755);
+
+    vector<File> entries;
+
+    for (int i = 0; i < 20; ++i)
+    {
+	string dir = "/d" + to_string(i);
+	mkdir((file_paths.pre_path + dir).c_str(), 0755);
+	entries.push_back(File(&file_paths, dir, DELETED));
+
+	for (int j = 0; j < 10; ++j)
+	{
+	    string file = dir + "/f" + to_string(j);
+	    make_file(file_paths.pre_path + file, file);
+	    entries.push_back(File(&file_paths, file, DELETED));
+	}
+
+	symlink("f0", (file_paths.pre_path + dir + "/l").c_str());
+	entries.push_back(File(&file_paths, dir + "/l", DELETED));
+    }
+
+    symlink("d0", (file_paths.pre_path + "/x").c_str());
+    make_file(file_paths.system_path + "/x", "x");
+    entries.push_back(File(&file_paths, "/x", TYPE));
+
+    mkdir((file_paths.system_path + "/y").c_str(), 0755);
+    make_file(file_paths.system_path + "/y/z", "z");
+    entries.push_back(File(&file_paths, "/y", CREATED));
+    entries.push_back(File(&file_paths, "/y/z", CREATED));
+
+    sort(entries.begin(), entries.end(), [](const File& lhs, const File& rhs) {
+	return File::cmp_lt(lhs.getName(), rhs.getName());
+    });
+
+    for (File& file : entries)
+	file.setUndo(true);
+
+    Files files(&file_paths, entries);
+
+    vector<UndoStep> undo_steps = files.getUndoSteps();
+
+    pid_t pid = fork();
+    BOOST_REQUIRE(pid >= 0);
+
+    if (pid == 0)
+    {
+	UndoJournal journal(SDir(base + "/info"), SDir(file_paths.system_path), 0);
+	journal.create(files, undo_steps);
+
+	files.doUndoSteps(undo_steps, [&journal](const UndoStep& undo_step, bool ok, size_t done,
+						 size_t total) {
+	    journal.completed(undo_step);
+
+	    if (done == 50)
+		journal.sync();
+
+	    if (done == 150)
+		_exit(0);
+	}, 4);
+
+	_exit(1);
+    }
+
+    int status;
+    BOOST_REQUIRE(waitpid(pid, &status, 0) == pid);
+    BOOST_REQUIRE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+    UndoJournal journal(SDir(base + "/info"), SDir(file_paths.system_path), 0);
+
+    vector<File> resume_entries;
+    vector<UndoStep> resume_undo_steps;
+
+    BOOST_REQUIRE(journal.load(&file_paths, resume_entries, resume_undo_steps));
+    BOOST_CHECK(resume_undo_steps.size() > undo_steps.size() - 150);
+    BOOST_CHECK(resume_undo_steps.size() < undo_steps.size());
+
+    Files resume_files(&file_paths, resume_entries);
+    BOOST_CHECK(resume_files.doUndoSteps(resume_undo_steps, nullptr));
+
+    journal.remove();
+
+    // now the system must be equal to pre
+
+    vector<string> differences;
+
+    cmpDirs(SDir(file_paths.pre_path), SDir(file_paths.system_path),
+	    [&differences](const string& name, unsigned int status) {
+		differences.push_back(name);
+	    });
+
+    BOOST_CHECK(differences.empty());
+}
+
+
+BOOST_FIXTURE_TEST_CASE(statuses, Fixture)
+{
+    vector<File> entries;
+
+    for (int i = 0; i < 10; ++i)
+    {
+	string dir = "/d" + to_string(i);
+	mkdir((file_paths.pre_path + dir).c_str(), 0755);
+	mkdir((file_paths.system_path + dir).c_str(), 0755);
+	entries.push_back(File(&file_paths, dir, 0));
+
+	for (int j = 0; j < 300; ++j)
+	{
+	    string file = dir + "/f" + to_string(j);
+	    make_file(file_paths.pre_path + file, file);
+	    make_file(file_paths.system_path + file, j % 3 == 0 ? "changed" : file);
+	    entries.push_back(File(&file_paths, file, 0));
+
+	    // the mtime may be equal due to the timestamp granularity
+
+	    if (j % 3 == 0)
+	    {
+		const struct timespec times[2] = { { 0, UTIME_OMIT }, { 1000, 0 } };
+		utimensat(AT_FDCWD, (file_paths.system_path + file).c_str(), times, 0);
+	    }
+	}
+    }
+
+    // only in pre, only in the system, both in a missing directory
+
+    make_file(file_paths.pre_path + "/d0/deleted", "x");
+    entries.push_back(File(&file_paths, "/d0/deleted", 0));
+
+    make_file(file_paths.system_path + "/d0/created", "x");
+    entries.push_back(File(&file_paths, "/d0/created", 0));
+
+    mkdir((file_paths.system_path + "/new").c_str(), 0755);
+    make_file(file_paths.system_path + "/new/created", "x");
+    entries.push_back(File(&file_paths, "/new/created", 0));
+
+    sort(entries.begin(), entries.end(), [](const File& lhs, const File& rhs) {
+	return File::cmp_lt(lhs.getName(), rhs.getName());
+    });
+
+    Files files1(&file_paths, entries);
+    files1.computeStatuses(CMP_PRE_TO_SYSTEM, 4);
+
+    Files files2(&file_paths, entries);
+
+    for (Files::iterator it1 = files1.begin(), it2 = files2.begin(); it1 != files1.end(); ++it1, ++it2)
+	BOOST_CHECK_EQUAL(it1->getPreToSystemStatus(), it2->getPreToSystemStatus());
+
+    BOOST_CHECK_EQUAL(files1.find("/d0/f0")->getPreToSystemStatus(), CONTENT);
+    BOOST_CHECK_EQUAL(files1.find("/d0/f1")->getPreToSystemStatus(), 0);
+    BOOST_CHECK_EQUAL(files1.find("/d0/deleted")->getPreToSystemStatus(), DELETED);
+    BOOST_CHECK_EQUAL(files1.find("/d0/created")->getPreToSystemStatus(), CREATED);
+    BOOST_CHECK_EQUAL(files1.find("/new/created")->getPreToSystemStatus(), CREATED);
+}